@@ -0,0 +1,244 @@
+#include "shortest_paths.h"
+#include "../11-helpers/thread_pool.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define ROWS_PER_CHUNK 16
+// Logs with at least a quarter as many entries as the graph has arcs
+// recompute every row without being sorted or tested
+#define MAX_LOGGED_SHARE 4
+
+typedef struct {
+	int u;
+	int v;
+	size_t seq;
+	float old_weight;
+	float new_weight;
+} logged_arc;
+
+static int compare_logged_arcs(const void *a, const void *b)
+{
+	const logged_arc *x = a;
+	const logged_arc *y = b;
+	if (x->u != y->u)
+		return (x->u > y->u) - (x->u < y->u);
+	if (x->v != y->v)
+		return (x->v > y->v) - (x->v < y->v);
+	return (x->seq > y->seq) - (x->seq < y->seq);
+}
+
+// Collapses the log to one net change per arc, the weight before the
+// first entry to the weight after the last, and drops arcs that ended
+// where they started. Returns the number of net changes, or -1.
+static long net_changes(const graph_change_log *log, graph_arc_change *out)
+{
+	logged_arc *arcs = malloc((log->count ? log->count : 1)
+				  * sizeof(logged_arc));
+	if (!arcs)
+		return -1;
+	for (size_t k = 0; k < log->count; k++) {
+		const graph_arc_change *c = &log->changes[k];
+		arcs[k] = (logged_arc) {
+		c->u, c->v, k, c->old_weight, c->new_weight};
+	}
+	qsort(arcs, log->count, sizeof(logged_arc), compare_logged_arcs);
+
+	long count = 0;
+	for (size_t k = 0; k < log->count;) {
+		size_t last = k;
+		while (last + 1 < log->count && arcs[last + 1].u == arcs[k].u
+		       && arcs[last + 1].v == arcs[k].v)
+			last++;
+		if (arcs[k].old_weight != arcs[last].new_weight)
+			out[count++] = (graph_arc_change) {
+			arcs[k].u, arcs[k].v, arcs[k].old_weight,
+				    arcs[last].new_weight};
+		k = last + 1;
+	}
+	free(arcs);
+	return count;
+}
+
+typedef struct {
+	const sp_graph *sg;
+	float *dist;
+	const graph_arc_change *increases;
+	size_t num_increases;
+	const graph_arc_change *decreases;
+	size_t num_decreases;
+	sp_workspace *workspaces;	// one per pool worker
+	int **seeds;		// one buffer of num_decreases per worker
+	unsigned char *invalid;	// rows a shortest path of may use an increase
+	unsigned char *changed;	// optional, see apsp_repair_rows
+} repair_job;
+
+// A row is invalid when a dearer arc may lie on one of its shortest
+// paths: d[s][u] + w_old <= d[s][v]
+static void classify_chunk(void *ctx, size_t begin, size_t end, int worker)
+{
+	(void)worker;
+	repair_job *job = ctx;
+	size_t n = (size_t)job->sg->num_nodes;
+	for (size_t s = begin; s < end; s++) {
+		const float *row = job->dist + s * n;
+		job->invalid[s] = 0;
+		for (size_t k = 0; k < job->num_increases; k++) {
+			const graph_arc_change *c = &job->increases[k];
+			float du = row[c->u];
+			if (du < SP_INF && du + c->old_weight <= row[c->v]) {
+				job->invalid[s] = 1;
+				break;
+			}
+		}
+	}
+}
+
+static void repair_row(repair_job *job, int s, int worker)
+{
+	size_t n = (size_t)job->sg->num_nodes;
+	float *row = job->dist + s * n;
+
+	if (job->invalid[s]) {
+		sp_single_source(job->sg, s, row, &job->workspaces[worker]);
+		if (job->changed)
+			job->changed[s] = 1;
+		return;
+	}
+
+	// No shortest path used a dearer arc, so row is still exact for
+	// the graph without the decreases; apply them incrementally.
+	int *seeds = job->seeds[worker];
+	size_t num_seeds = 0;
+	for (size_t k = 0; k < job->num_decreases; k++) {
+		const graph_arc_change *c = &job->decreases[k];
+		float du = row[c->u];
+		if (du >= SP_INF)
+			continue;
+		float alt = du + c->new_weight;
+		if (alt < row[c->v]) {
+			row[c->v] = alt;
+			seeds[num_seeds++] = c->v;
+		}
+	}
+	if (num_seeds)
+		sp_propagate(job->sg, row, seeds, num_seeds,
+			     &job->workspaces[worker]);
+	if (job->changed)
+		job->changed[s] = num_seeds > 0;
+}
+
+static void repair_chunk(void *ctx, size_t begin, size_t end, int worker)
+{
+	repair_job *job = ctx;
+	for (size_t s = begin; s < end; s++)
+		repair_row(job, (int)s, worker);
+}
+
+static int recompute(graph *g, float *dist, unsigned char *changed)
+{
+	float *fresh = compute_all_pairs_distances(g);
+	if (!fresh)
+		return 0;
+	if (changed)
+		memset(changed, 1, (size_t)g->num_nodes);
+	memcpy(dist, fresh,
+	       (size_t)g->num_nodes * g->num_nodes * sizeof(float));
+	free(fresh);
+	return 1;
+}
+
+int apsp_repair_rows(graph *g, float *dist, const graph_change_log *log,
+		     unsigned char *changed)
+{
+	if (log->overflowed)
+		return recompute(g, dist, changed);
+	if (changed)
+		memset(changed, 0, (size_t)g->num_nodes);
+	if (log->count == 0)
+		return 1;
+
+	// A log this long is a global change: sorting it and testing every
+	// row against it costs more than the rows it could spare
+	int every_row = log->count * MAX_LOGGED_SHARE >= graph_num_arcs(g);
+	graph_arc_change *changes = NULL;
+	long count = 0;
+	size_t num_increases = 0;
+	if (!every_row) {
+		changes = malloc(log->count * sizeof(graph_arc_change));
+		if (!changes)
+			return 0;
+		count = net_changes(log, changes);
+		if (count <= 0) {
+			free(changes);
+			return count == 0;
+		}
+		// Increases first, decreases after, in place
+		for (long k = 0; k < count; k++) {
+			if (changes[k].new_weight > changes[k].old_weight) {
+				graph_arc_change tmp = changes[num_increases];
+				changes[num_increases++] = changes[k];
+				changes[k] = tmp;
+			}
+		}
+	}
+	size_t num_decreases = (size_t)count - num_increases;
+
+	sp_graph sg;
+	if (!sp_graph_init(&sg, g)) {
+		free(changes);
+		return 0;
+	}
+	if (sg.negative_weights) {
+		sp_graph_free(&sg);
+		free(changes);
+		return recompute(g, dist, changed);
+	}
+
+	int n = g->num_nodes;
+	repair_job job = { &sg, dist, changes, num_increases,
+		changes + num_increases, num_decreases, NULL, NULL, NULL,
+		changed
+	};
+	int workers = thread_pool_size();
+	sp_workspace *workspaces = calloc((size_t)workers,
+					  sizeof(sp_workspace));
+	int **seeds = calloc((size_t)workers, sizeof(int *));
+	job.invalid = malloc(n > 0 ? (size_t)n : 1);
+	int ok = workspaces && seeds && job.invalid;
+	for (int w = 0; ok && w < workers; w++) {
+		ok &= sp_workspace_init(&workspaces[w], n);
+		seeds[w] = malloc((num_decreases ? num_decreases : 1)
+				  * sizeof(int));
+		ok &= seeds[w] != NULL;
+	}
+	if (ok) {
+		// Rows are recomputed in place, which spares the n x n
+		// buffer and copy of recompute()
+		if (every_row)
+			memset(job.invalid, 1, (size_t)n);
+		else
+			parallel_for((size_t)n, ROWS_PER_CHUNK,
+				     classify_chunk, &job);
+		job.workspaces = workspaces;
+		job.seeds = seeds;
+		parallel_for((size_t)n, ROWS_PER_CHUNK, repair_chunk, &job);
+	}
+
+	for (int w = 0; w < workers; w++) {
+		if (workspaces)
+			sp_workspace_free(&workspaces[w]);
+		if (seeds)
+			free(seeds[w]);
+	}
+	free(workspaces);
+	free(seeds);
+	free(job.invalid);
+	sp_graph_free(&sg);
+	free(changes);
+	return ok;
+}
+
+int apsp_repair(graph *g, float *dist, const graph_change_log *log)
+{
+	return apsp_repair_rows(g, dist, log, NULL);
+}
@@ -0,0 +1,240 @@
+#include "bit_matrix.h"
+#include "../11-helpers/thread_pool.h"
+#include "../11-helpers/cpu_features.h"
+#include <stdlib.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_KERNELS 1
+#endif
+
+#define NODES_PER_TASK 64
+// Shorter rows are not worth the AVX2 setup
+#define AVX2_MIN_WORDS 8
+
+static size_t popcount_scalar(const uint64_t *row, size_t words)
+{
+	size_t count = 0;
+	for (size_t k = 0; k < words; k++)
+		count += (size_t)__builtin_popcountll(row[k]);
+	return count;
+}
+
+static size_t and_popcount_scalar(const uint64_t *a, const uint64_t *b,
+				  size_t words)
+{
+	size_t count = 0;
+	for (size_t k = 0; k < words; k++)
+		count += (size_t)__builtin_popcountll(a[k] & b[k]);
+	return count;
+}
+
+#ifdef HAVE_X86_KERNELS
+// Bytewise popcount by two 4-bit table lookups, summed per 64-bit lane
+__attribute__((target("avx2")))
+static inline __m256i lane_popcounts(__m256i x)
+{
+	const __m256i table = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3,
+					       1, 2, 2, 3, 2, 3, 3, 4,
+					       0, 1, 1, 2, 1, 2, 2, 3,
+					       1, 2, 2, 3, 2, 3, 3, 4);
+	const __m256i low = _mm256_set1_epi8(0x0f);
+	__m256i lo = _mm256_and_si256(x, low);
+	__m256i hi = _mm256_and_si256(_mm256_srli_epi16(x, 4), low);
+	__m256i bytes = _mm256_add_epi8(_mm256_shuffle_epi8(table, lo),
+					_mm256_shuffle_epi8(table, hi));
+	return _mm256_sad_epu8(bytes, _mm256_setzero_si256());
+}
+
+__attribute__((target("avx2")))
+static size_t sum_lanes(__m256i acc)
+{
+	uint64_t lanes[4];
+	_mm256_storeu_si256((__m256i *) lanes, acc);
+	return (size_t)(lanes[0] + lanes[1] + lanes[2] + lanes[3]);
+}
+
+__attribute__((target("avx2,popcnt")))
+static size_t popcount_avx2(const uint64_t *row, size_t words)
+{
+	__m256i acc = _mm256_setzero_si256();
+	size_t k = 0;
+	for (; k + 4 <= words; k += 4)
+		acc = _mm256_add_epi64(acc, lane_popcounts(_mm256_loadu_si256
+							   ((const __m256i *)
+							    (row + k))));
+	size_t count = sum_lanes(acc);
+	for (; k < words; k++)
+		count += (size_t)__builtin_popcountll(row[k]);
+	return count;
+}
+
+__attribute__((target("avx2,popcnt")))
+static size_t and_popcount_avx2(const uint64_t *a, const uint64_t *b,
+				size_t words)
+{
+	__m256i acc = _mm256_setzero_si256();
+	size_t k = 0;
+	for (; k + 4 <= words; k += 4) {
+		__m256i x = _mm256_and_si256(_mm256_loadu_si256
+					     ((const __m256i *)(a + k)),
+					     _mm256_loadu_si256((const __m256i *)
+								(b + k)));
+		acc = _mm256_add_epi64(acc, lane_popcounts(x));
+	}
+	size_t count = sum_lanes(acc);
+	for (; k < words; k++)
+		count += (size_t)__builtin_popcountll(a[k] & b[k]);
+	return count;
+}
+#endif
+
+size_t bit_row_popcount(const uint64_t *row, size_t words)
+{
+#ifdef HAVE_X86_KERNELS
+	if (words >= AVX2_MIN_WORDS && cpu_simd_isa() >= SIMD_AVX2)
+		return popcount_avx2(row, words);
+#endif
+	return popcount_scalar(row, words);
+}
+
+size_t bit_row_and_popcount(const uint64_t *a, const uint64_t *b,
+			    size_t words)
+{
+#ifdef HAVE_X86_KERNELS
+	if (words >= AVX2_MIN_WORDS && cpu_simd_isa() >= SIMD_AVX2)
+		return and_popcount_avx2(a, b, words);
+#endif
+	return and_popcount_scalar(a, b, words);
+}
+
+void bit_row_and(uint64_t *dst, const uint64_t *a, const uint64_t *b,
+		 size_t words)
+{
+	for (size_t k = 0; k < words; k++)
+		dst[k] = a[k] & b[k];
+}
+
+void bit_row_or(uint64_t *dst, const uint64_t *a, const uint64_t *b,
+		size_t words)
+{
+	for (size_t k = 0; k < words; k++)
+		dst[k] = a[k] | b[k];
+}
+
+void bit_row_andnot(uint64_t *dst, const uint64_t *a, const uint64_t *b,
+		    size_t words)
+{
+	for (size_t k = 0; k < words; k++)
+		dst[k] = a[k] & ~b[k];
+}
+
+const uint64_t *graph_bit_row(graph *g, int u)
+{
+	if (g->storage != GRAPH_BITMATRIX)
+		return NULL;
+	return g->bits + (size_t)u * g->row_words;
+}
+
+int graph_common_neighbors(graph *g, int u, int v)
+{
+	if (g->storage == GRAPH_BITMATRIX)
+		return (int)bit_row_and_popcount(graph_bit_row(g, u),
+						 graph_bit_row(g, v),
+						 g->row_words);
+	int count = 0;
+	for (neighbor_iter it = graph_neighbors(g, u); neighbor_next(&it);)
+		count += is_connected(g, v, it.v) != 0;
+	return count;
+}
+
+typedef struct {
+	graph *g;
+	size_t *counts;		// one per worker
+	char **marks;		// one n-entry array per worker, all clear
+} triangle_job;
+
+// Nodes w > v present in both rows
+static size_t common_above(const uint64_t *a, const uint64_t *b,
+			   size_t words, int v)
+{
+	size_t k = (size_t)(v + 1) >> 6;
+	if (k >= words)
+		return 0;
+	uint64_t mask = ~(uint64_t)0 << ((v + 1) & 63);
+	return (size_t)__builtin_popcountll(a[k] & b[k] & mask)
+	    + bit_row_and_popcount(a + k + 1, b + k + 1, words - k - 1);
+}
+
+// Every triangle u < v < w is counted once, at its smallest node u
+static void triangles_chunk(void *ctx, size_t begin, size_t end, int worker)
+{
+	triangle_job *job = ctx;
+	graph *g = job->g;
+	size_t count = 0;
+
+	for (size_t s = begin; s < end; s++) {
+		int u = (int)s;
+		if (g->storage == GRAPH_BITMATRIX) {
+			const uint64_t *row = graph_bit_row(g, u);
+			for (neighbor_iter it = graph_neighbors(g, u);
+			     neighbor_next(&it);)
+				if (it.v > u)
+					count += common_above(row,
+							      graph_bit_row(g,
+									    it.v),
+							      g->row_words,
+							      it.v);
+			continue;
+		}
+
+		char *mark = job->marks[worker];
+		for (neighbor_iter it = graph_neighbors(g, u);
+		     neighbor_next(&it);)
+			mark[it.v] = 1;
+		for (neighbor_iter it = graph_neighbors(g, u);
+		     neighbor_next(&it);) {
+			if (it.v <= u)
+				continue;
+			for (neighbor_iter jt = graph_neighbors(g, it.v);
+			     neighbor_next(&jt);)
+				if (jt.v > it.v && mark[jt.v])
+					count++;
+		}
+		for (neighbor_iter it = graph_neighbors(g, u);
+		     neighbor_next(&it);)
+			mark[it.v] = 0;
+	}
+	job->counts[worker] += count;
+}
+
+size_t graph_count_triangles(graph *g)
+{
+	if (g->is_directed || g->num_nodes <= 0)
+		return 0;
+	// Pending CSR arcs are merged by the first query, not concurrently
+	graph_compact(g);
+
+	int workers = thread_pool_size();
+	triangle_job job = { g, calloc((size_t)workers, sizeof(size_t)),
+		calloc((size_t)workers, sizeof(char *))
+	};
+	size_t total = 0;
+	int ok = job.counts && job.marks;
+	for (int w = 0; ok && w < workers; w++)
+		if (g->storage != GRAPH_BITMATRIX) {
+			job.marks[w] = calloc((size_t)g->num_nodes, 1);
+			ok = job.marks[w] != NULL;
+		}
+	if (ok) {
+		parallel_for((size_t)g->num_nodes, NODES_PER_TASK,
+			     triangles_chunk, &job);
+		for (int w = 0; w < workers; w++)
+			total += job.counts[w];
+	}
+
+	for (int w = 0; job.marks && w < workers; w++)
+		free(job.marks[w]);
+	free(job.marks);
+	free(job.counts);
+	return total;
+}
@@ -0,0 +1,60 @@
+#ifndef BIT_MATRIX_H
+#define BIT_MATRIX_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "graph.h"
+
+// Rows of the GRAPH_BITMATRIX storage: bit v of row u (word v / 64, bit
+// v % 64) is set when the arc (u, v) exists. Rows are row_words words
+// long, the bits past num_nodes are always clear.
+
+static inline size_t bit_row_words(int n)
+{
+	return n > 0 ? ((size_t)n + 63) / 64 : 0;
+}
+
+static inline int bit_test(const uint64_t *row, int v)
+{
+	return (int)((row[v >> 6] >> (v & 63)) & 1);
+}
+
+static inline void bit_set(uint64_t *row, int v)
+{
+	row[v >> 6] |= (uint64_t)1 << (v & 63);
+}
+
+static inline void bit_clear(uint64_t *row, int v)
+{
+	row[v >> 6] &= ~((uint64_t)1 << (v & 63));
+}
+
+// Set bits of row[0 .. words), and of a[k] & b[k]. Use AVX2 when the CPU
+// has it (see cpu_features.h).
+size_t bit_row_popcount(const uint64_t *row, size_t words);
+size_t bit_row_and_popcount(const uint64_t *a, const uint64_t *b,
+			    size_t words);
+
+// dst[k] = a[k] op b[k]; dst may be a or b
+void bit_row_and(uint64_t *dst, const uint64_t *a, const uint64_t *b,
+		 size_t words);
+void bit_row_or(uint64_t *dst, const uint64_t *a, const uint64_t *b,
+		size_t words);
+void bit_row_andnot(uint64_t *dst, const uint64_t *a, const uint64_t *b,
+		    size_t words);
+
+// Out-neighbors of u as a bit row of g->row_words words, NULL unless g
+// has bit matrix storage. Read-only: changes must go through add_edge
+// and friends so that change logs and weights stay consistent.
+const uint64_t *graph_bit_row(graph * g, int u);
+
+// Nodes w with arcs (u, w) and (v, w). One AND and popcount per 64
+// nodes on bit matrix storage, a lookup per neighbor of u otherwise.
+int graph_common_neighbors(graph * g, int u, int v);
+
+// Triangles of an undirected graph, in parallel. Bit matrix storage
+// intersects rows word by word; the others walk the 2-hop paths.
+// Directed graphs are not supported and give 0.
+size_t graph_count_triangles(graph * g);
+
+#endif				// BIT_MATRIX_H
@@ -0,0 +1,314 @@
+#include "distance_ball.h"
+#include "shortest_paths.h"
+#include "graph_reorder.h"
+#include "../11-helpers/thread_pool.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define SOURCES_PER_CHUNK 8
+
+typedef struct {
+	size_t count;
+	int *nodes;
+	float *dists;
+} ball_row;
+
+// Per-thread scratch for one search
+typedef struct {
+	sp_workspace ws;
+	float *row;		// all SP_INF between searches
+	int *nodes;
+	float *dists;
+	int *local;		// hop search: position in the ball or -1
+	float *next;		// hop search: next Bellman-Ford round
+} ball_scratch;
+
+typedef struct {
+	const sp_graph *sg;
+	float radius;
+	int max_hops;		// > 0 selects the hop search
+	float min_weight;	// lightest arc, for the hop cutoff
+	ball_row *rows;
+	float *cutoff;
+	ball_scratch *scratch;
+	int failed;
+} ball_job;
+
+static int scratch_init(ball_scratch *sc, int n, int hops)
+{
+	memset(sc, 0, sizeof(*sc));
+	size_t len = n > 0 ? (size_t)n : 1;
+	int ok = sp_workspace_init(&sc->ws, n);
+	sc->row = malloc(len * sizeof(float));
+	sc->nodes = malloc(len * sizeof(int));
+	sc->dists = malloc(len * sizeof(float));
+	if (hops) {
+		sc->local = malloc(len * sizeof(int));
+		sc->next = malloc(len * sizeof(float));
+	}
+	if (!ok || !sc->row || !sc->nodes || !sc->dists
+	    || (hops && (!sc->local || !sc->next)))
+		return 0;
+	for (size_t v = 0; v < len; v++) {
+		sc->row[v] = SP_INF;
+		if (hops)
+			sc->local[v] = -1;
+	}
+	return 1;
+}
+
+static void scratch_free(ball_scratch *sc)
+{
+	sp_workspace_free(&sc->ws);
+	free(sc->row);
+	free(sc->nodes);
+	free(sc->dists);
+	free(sc->local);
+	free(sc->next);
+}
+
+// BFS to max_hops collects the ball, then max_hops Bellman-Ford rounds
+// over its arcs give the shortest paths of at most max_hops arcs: such
+// a path never leaves the ball.
+static size_t hop_ball(const ball_job *job, int source, ball_scratch *sc,
+		       float *cutoff)
+{
+	const sp_graph *sg = job->sg;
+	int *nodes = sc->nodes;
+	float *cur = sc->dists, *next = sc->next;
+	size_t count = 0, level_end;
+	int beyond = 0;
+
+	nodes[count] = source;
+	sc->local[source] = (int)count++;
+	level_end = count;
+	for (int hop = 0, front = 0; hop < job->max_hops; hop++) {
+		for (; (size_t)front < level_end; front++) {
+			int u = nodes[front];
+			for (size_t p = sg->offsets[u]; p < sg->offsets[u + 1];
+			     p++) {
+				int v = sg->neighbors[p];
+				if (sc->local[v] >= 0)
+					continue;
+				sc->local[v] = (int)count;
+				nodes[count++] = v;
+			}
+		}
+		level_end = count;
+	}
+	// Is anything reachable past the last level?
+	for (size_t k = 0; k < count && !beyond; k++) {
+		int u = nodes[k];
+		for (size_t p = sg->offsets[u]; p < sg->offsets[u + 1]; p++)
+			if (sc->local[sg->neighbors[p]] < 0) {
+				beyond = 1;
+				break;
+			}
+	}
+	*cutoff = beyond ? (job->max_hops + 1) * job->min_weight : SP_INF;
+
+	for (size_t k = 0; k < count; k++)
+		cur[k] = SP_INF;
+	cur[0] = 0.0f;
+	for (int round = 0; round < job->max_hops; round++) {
+		memcpy(next, cur, count * sizeof(float));
+		for (size_t k = 0; k < count; k++) {
+			if (cur[k] >= SP_INF)
+				continue;
+			int u = nodes[k];
+			for (size_t p = sg->offsets[u]; p < sg->offsets[u + 1];
+			     p++) {
+				int lv = sc->local[sg->neighbors[p]];
+				float alt = cur[k] + sg->weights[p];
+				if (lv >= 0 && alt < next[lv])
+					next[lv] = alt;
+			}
+		}
+		float *tmp = cur;
+		cur = next;
+		next = tmp;
+	}
+	if (cur != sc->dists)
+		memcpy(sc->dists, cur, count * sizeof(float));
+
+	for (size_t k = 0; k < count; k++)
+		sc->local[nodes[k]] = -1;
+	return count;
+}
+
+static void ball_chunk(void *ctx, size_t begin, size_t end, int worker)
+{
+	ball_job *job = ctx;
+	ball_scratch *sc = &job->scratch[worker];
+	for (size_t s = begin; s < end; s++) {
+		size_t count;
+		if (job->max_hops > 0)
+			count = hop_ball(job, (int)s, sc, &job->cutoff[s]);
+		else
+			count = sp_ball(job->sg, (int)s, job->radius, sc->row,
+					sc->nodes, sc->dists, &job->cutoff[s],
+					&sc->ws);
+
+		// Both searches put the source first; drop it.
+		ball_row *r = &job->rows[s];
+		r->count = count - 1;
+		r->nodes = malloc((count > 1 ? count - 1 : 1) * sizeof(int));
+		r->dists = malloc((count > 1 ? count - 1 : 1) * sizeof(float));
+		if (!r->nodes || !r->dists) {
+			job->failed = 1;
+			continue;
+		}
+		memcpy(r->nodes, sc->nodes + 1, (count - 1) * sizeof(int));
+		memcpy(r->dists, sc->dists + 1, (count - 1) * sizeof(float));
+	}
+}
+
+static distance_ball *build(graph *g, float radius, int max_hops)
+{
+	sp_graph sg;
+	if (!sp_graph_init(&sg, g))
+		return NULL;
+	if (sg.negative_weights) {
+		sp_graph_free(&sg);
+		return NULL;
+	}
+
+	int n = g->num_nodes;
+	int workers = thread_pool_size();
+	distance_ball *b = calloc(1, sizeof(distance_ball));
+	ball_row *rows = calloc((size_t)n + 1, sizeof(ball_row));
+	ball_scratch *scratch = calloc((size_t)workers, sizeof(ball_scratch));
+	int ok = b && rows && scratch;
+	if (b) {
+		b->num_nodes = n;
+		b->offsets = malloc(((size_t)n + 1) * sizeof(size_t));
+		b->cutoff = malloc(((size_t)n + 1) * sizeof(float));
+		ok = ok && b->offsets && b->cutoff;
+	}
+	for (int w = 0; ok && w < workers; w++)
+		ok = scratch_init(&scratch[w], n, max_hops > 0);
+
+	if (ok) {
+		float min_weight = SP_INF;
+		for (size_t p = 0; p < sg.offsets[n]; p++)
+			if (sg.weights[p] < min_weight)
+				min_weight = sg.weights[p];
+		ball_job job = { &sg, radius, max_hops, min_weight, rows,
+			b->cutoff, scratch, 0
+		};
+		parallel_for((size_t)n, SOURCES_PER_CHUNK, ball_chunk, &job);
+		ok = !job.failed;
+	}
+
+	if (ok) {
+		size_t total = 0;
+		for (int i = 0; i < n; i++) {
+			b->offsets[i] = total;
+			total += rows[i].count;
+		}
+		b->offsets[n] = total;
+		b->nodes = malloc((total ? total : 1) * sizeof(int));
+		b->dists = malloc((total ? total : 1) * sizeof(float));
+		ok = b->nodes && b->dists;
+		for (int i = 0; ok && i < n; i++) {
+			memcpy(b->nodes + b->offsets[i], rows[i].nodes,
+			       rows[i].count * sizeof(int));
+			memcpy(b->dists + b->offsets[i], rows[i].dists,
+			       rows[i].count * sizeof(float));
+		}
+	}
+
+	for (int i = 0; rows && i < n; i++) {
+		free(rows[i].nodes);
+		free(rows[i].dists);
+	}
+	for (int w = 0; scratch && w < workers; w++)
+		scratch_free(&scratch[w]);
+	free(rows);
+	free(scratch);
+	sp_graph_free(&sg);
+	if (!ok) {
+		free_distance_ball(b);
+		return NULL;
+	}
+	return b;
+}
+
+distance_ball *distance_ball_within(graph *g, float radius)
+{
+	return build(g, radius, 0);
+}
+
+distance_ball *distance_ball_hops(graph *g, int max_hops)
+{
+	if (max_hops < 1)
+		max_hops = 1;
+	return build(g, 0.0f, max_hops);
+}
+
+void free_distance_ball(distance_ball *b)
+{
+	if (!b)
+		return;
+	free(b->offsets);
+	free(b->nodes);
+	free(b->dists);
+	free(b->cutoff);
+	free(b);
+}
+
+int distance_ball_permute(distance_ball *b, const int *new_id)
+{
+	int n = b->num_nodes;
+	size_t len = n > 0 ? (size_t)n : 1;
+	size_t total = b->offsets[n];
+	size_t *offsets = malloc((len + 1) * sizeof(size_t));
+	int *nodes = malloc((total ? total : 1) * sizeof(int));
+	float *dists = malloc((total ? total : 1) * sizeof(float));
+	float *cutoff = malloc(len * sizeof(float));
+	int *old_id = invert_permutation(new_id, n);
+	if (!offsets || !nodes || !dists || !cutoff || !old_id) {
+		free(offsets);
+		free(nodes);
+		free(dists);
+		free(cutoff);
+		free(old_id);
+		return 0;
+	}
+
+	size_t p = 0;
+	for (int a = 0; a < n; a++) {
+		int i = old_id[a];
+		offsets[a] = p;
+		cutoff[a] = b->cutoff[i];
+		for (size_t q = b->offsets[i]; q < b->offsets[i + 1]; q++, p++) {
+			nodes[p] = new_id[b->nodes[q]];
+			dists[p] = b->dists[q];
+		}
+	}
+	offsets[n] = p;
+	free(old_id);
+
+	free(b->offsets);
+	free(b->nodes);
+	free(b->dists);
+	free(b->cutoff);
+	b->offsets = offsets;
+	b->nodes = nodes;
+	b->dists = dists;
+	b->cutoff = cutoff;
+	return 1;
+}
+
+float distance_ball_tail_bound(const distance_ball *b, int i, float alpha,
+			       float max_weight, float min_dist)
+{
+	float r = b->cutoff[i];
+	if (r >= SP_INF)
+		return 0.0f;
+	if (r < min_dist)
+		r = min_dist;
+	size_t dropped = (size_t)b->num_nodes - 1
+	    - (b->offsets[i + 1] - b->offsets[i]);
+	return (float)dropped * max_weight / powf(r, alpha);
+}
@@ -0,0 +1,43 @@
+#ifndef DISTANCE_BALL_H
+#define DISTANCE_BALL_H
+
+#include "graph.h"
+
+// Sparse replacement for the n x n distance matrix when only nearby
+// nodes matter: for every node i the nodes of its ball (i excluded) and
+// their distances, stored CSR-style in nodes[offsets[i] .. offsets[i+1])
+// and dists[...]. Memory is O(n + sum of ball sizes).
+typedef struct {
+	int num_nodes;
+	size_t *offsets;	// n + 1 entries
+	int *nodes;
+	float *dists;
+	// Lower bound on the distance from i of every reachable node left
+	// out of its ball, SP_INF when the ball holds them all.
+	float *cutoff;
+} distance_ball;
+
+// Balls of every node at shortest-path distance <= radius. On unit-weight
+// graphs radius k is the k-hop neighbourhood. NULL if out of memory or
+// the graph has negative weights.
+distance_ball *distance_ball_within(graph * g, float radius);
+
+// Balls of every node within max_hops arcs. The stored distance is the
+// shortest path using at most max_hops arcs, which is the true distance
+// on unit-weight graphs and an upper bound on it otherwise.
+distance_ball *distance_ball_hops(graph * g, int max_hops);
+
+void free_distance_ball(distance_ball * b);
+
+// Renumbers the nodes, node i becoming new_id[i]. Returns 0 (b
+// unchanged) if out of memory.
+int distance_ball_permute(distance_ball * b, const int *new_id);
+
+// Upper bound on sum over nodes j outside the ball of i of
+// weight_j / d(i, j)^alpha, for alpha >= 0 and |weight_j| <= max_weight.
+// Distances below min_dist count as min_dist, as in mult_impact_i.
+float distance_ball_tail_bound(const distance_ball * b, int i,
+			       float alpha, float max_weight,
+			       float min_dist);
+
+#endif				// DISTANCE_BALL_H
@@ -0,0 +1,297 @@
+#include "distance_matrix.h"
+#include "../11-helpers/thread_pool.h"
+#include <stdlib.h>
+#include <math.h>
+
+#define SOURCES_PER_CHUNK 8
+#define F16_MAX 65504.0f
+
+static size_t entry_size(dist_format format)
+{
+	switch (format) {
+	case DIST_F16:
+	case DIST_U16:
+		return 2;
+	case DIST_U8:
+		return 1;
+	case DIST_F32:
+		break;
+	}
+	return 4;
+}
+
+static size_t num_entries(int n, int packed)
+{
+	size_t len = n > 0 ? (size_t)n : 0;
+	return packed ? len * (len - (len > 0)) / 2 : len * len;
+}
+
+// Round to nearest even; the caller handles values above F16_MAX.
+static uint16_t float_to_half(float f)
+{
+	uint32_t x;
+	memcpy(&x, &f, sizeof(x));
+	uint32_t sign = (x >> 16) & 0x8000;
+	uint32_t abs_x = x & 0x7fffffff;
+	if (abs_x >= 0x7f800000)
+		return (uint16_t)(sign | DIST_F16_INF);
+	if (abs_x < 0x38800000)	// below 2^-14: half subnormal
+		return (uint16_t)(sign | (uint32_t)rintf(fabsf(f) * 16777216.0f));
+	uint32_t h = (abs_x >> 13) - (112u << 10);
+	uint32_t rest = abs_x & 0x1fff;
+	if (rest > 0x1000 || (rest == 0x1000 && (h & 1)))
+		h++;
+	return (uint16_t)(sign | h);
+}
+
+// Stores d at position p; returns 1 if it did not fit exactly.
+static int encode(distance_matrix *m, size_t p, float d)
+{
+	int inf = d >= SP_INF;
+	switch (m->format) {
+	case DIST_F16:{
+			uint16_t *data = m->data;
+			if (inf) {
+				data[p] = DIST_F16_INF;
+				return 0;
+			}
+			if (d > F16_MAX) {
+				data[p] = float_to_half(F16_MAX);
+				return 1;
+			}
+			data[p] = float_to_half(d);
+			return half_to_float(data[p]) != d;
+		}
+	case DIST_U16:
+	case DIST_U8:{
+			unsigned max = m->format == DIST_U8 ? DIST_U8_INF
+			    : DIST_U16_INF;
+			unsigned q = max;
+			float r = rintf(d);
+			int lossy = 0;
+			if (!inf) {
+				lossy = r != d;
+				if (r < 0.0f) {
+					r = 0.0f;
+					lossy = 1;
+				}
+				if (r >= (float)max) {
+					r = (float)(max - 1);
+					lossy = 1;
+				}
+				q = (unsigned)r;
+			}
+			if (m->format == DIST_U8)
+				((uint8_t *) m->data)[p] = (uint8_t) q;
+			else
+				((uint16_t *) m->data)[p] = (uint16_t) q;
+			return lossy;
+		}
+	case DIST_F32:
+		break;
+	}
+	((float *)m->data)[p] = d;
+	return 0;
+}
+
+static distance_matrix *alloc_matrix(int n, int packed, dist_format format)
+{
+	distance_matrix *m = calloc(1, sizeof(distance_matrix));
+	if (!m)
+		return NULL;
+	size_t count = num_entries(n, packed);
+	m->num_nodes = n;
+	m->packed = packed;
+	m->format = format;
+	m->data = malloc((count ? count : 1) * entry_size(format));
+	if (!m->data) {
+		free(m);
+		return NULL;
+	}
+	return m;
+}
+
+distance_matrix *create_distance_matrix(int n, int packed,
+					dist_format format)
+{
+	distance_matrix *m = alloc_matrix(n, packed, format);
+	if (!m)
+		return NULL;
+	size_t count = num_entries(n, packed);
+	for (size_t p = 0; p < count; p++)
+		encode(m, p, SP_INF);
+	if (!packed)
+		for (int i = 0; i < n; i++)
+			encode(m, (size_t)i * n + i, 0.0f);
+	return m;
+}
+
+distance_matrix *distance_matrix_wrap(float *dist, int n)
+{
+	if (!dist)
+		return NULL;
+	distance_matrix *m = calloc(1, sizeof(distance_matrix));
+	if (!m) {
+		free(dist);
+		return NULL;
+	}
+	m->num_nodes = n;
+	m->format = DIST_F32;
+	m->data = dist;
+	return m;
+}
+
+distance_matrix *distance_matrix_from_floats(const float *dist, int n,
+					     int packed, dist_format format)
+{
+	distance_matrix *m = alloc_matrix(n, packed, format);
+	if (!m)
+		return NULL;
+	for (int i = 0; i < n; i++)
+		for (int j = packed ? i + 1 : 0; j < n; j++)
+			m->lossy |= encode(m, distance_index(m, i, j),
+					   dist[(size_t)i * n + j]);
+	return m;
+}
+
+void free_distance_matrix(distance_matrix *m)
+{
+	if (!m)
+		return;
+	free(m->data);
+	free(m);
+}
+
+size_t distance_matrix_bytes(const distance_matrix *m)
+{
+	return num_entries(m->num_nodes, m->packed) * entry_size(m->format);
+}
+
+float *distance_matrix_floats(distance_matrix *m)
+{
+	if (m->format != DIST_F32 || m->packed)
+		return NULL;
+	return m->data;
+}
+
+void distance_set(distance_matrix *m, int i, int j, float d)
+{
+	if (i == j && m->packed)
+		return;
+	m->lossy |= encode(m, distance_index(m, i, j), d);
+}
+
+void distance_row(const distance_matrix *m, int i, float *row)
+{
+	int n = m->num_nodes;
+	if (m->format == DIST_F32 && !m->packed) {
+		memcpy(row, (const float *)m->data + (size_t)i * n,
+		       (size_t)n * sizeof(float));
+		return;
+	}
+	for (int j = 0; j < n; j++)
+		row[j] = distance_get(m, i, j);
+}
+
+int distance_matrix_permute(distance_matrix *m, const int *new_id)
+{
+	int n = m->num_nodes;
+	size_t size = entry_size(m->format);
+	size_t count = num_entries(n, m->packed);
+	char *data = malloc((count ? count : 1) * size);
+	if (!data)
+		return 0;
+
+	distance_matrix moved = *m;
+	moved.data = data;
+	for (int i = 0; i < n; i++)
+		for (int j = m->packed ? i + 1 : 0; j < n; j++)
+			memcpy(data + distance_index(&moved, new_id[i],
+						     new_id[j]) * size,
+			       (const char *)m->data
+			       + distance_index(m, i, j) * size, size);
+	free(m->data);
+	m->data = data;
+	return 1;
+}
+
+typedef struct {
+	const sp_graph *sg;
+	distance_matrix *m;
+	float **rows;		// one scratch row per worker
+	sp_workspace *workspaces;
+	int *lossy;		// per worker
+} fill_job;
+
+static void fill_chunk(void *ctx, size_t begin, size_t end, int worker)
+{
+	fill_job *job = ctx;
+	distance_matrix *m = job->m;
+	float *row = job->rows[worker];
+	int n = m->num_nodes;
+	for (size_t s = begin; s < end; s++) {
+		int i = (int)s;
+		sp_single_source(job->sg, i, row, &job->workspaces[worker]);
+		for (int j = m->packed ? i + 1 : 0; j < n; j++)
+			job->lossy[worker] |=
+			    encode(m, distance_index(m, i, j), row[j]);
+	}
+}
+
+distance_matrix *compute_distance_matrix(graph *g, dist_format format,
+					 int packed)
+{
+	sp_graph sg;
+	if (!sp_graph_init(&sg, g))
+		return NULL;
+	if (sg.negative_weights) {
+		// Dijkstra does not apply: go through the float matrix.
+		sp_graph_free(&sg);
+		float *dist = compute_all_pairs_distances(g);
+		if (!dist)
+			return NULL;
+		distance_matrix *m = distance_matrix_from_floats(dist,
+								 g->num_nodes,
+								 packed
+								 && !g->
+								 is_directed,
+								 format);
+		free(dist);
+		return m;
+	}
+
+	int n = g->num_nodes;
+	int workers = thread_pool_size();
+	distance_matrix *m = alloc_matrix(n, packed && !g->is_directed, format);
+	float **rows = calloc((size_t)workers, sizeof(float *));
+	sp_workspace *workspaces = calloc((size_t)workers,
+					  sizeof(sp_workspace));
+	int *lossy = calloc((size_t)workers, sizeof(int));
+	int ok = m && rows && workspaces && lossy;
+	for (int w = 0; ok && w < workers; w++) {
+		rows[w] = malloc((n > 0 ? (size_t)n : 1) * sizeof(float));
+		ok = rows[w] && sp_workspace_init(&workspaces[w], n);
+	}
+	if (ok) {
+		fill_job job = { &sg, m, rows, workspaces, lossy };
+		parallel_for((size_t)n, SOURCES_PER_CHUNK, fill_chunk, &job);
+		for (int w = 0; w < workers; w++)
+			m->lossy |= lossy[w];
+	}
+
+	for (int w = 0; w < workers; w++) {
+		if (rows)
+			free(rows[w]);
+		if (workspaces)
+			sp_workspace_free(&workspaces[w]);
+	}
+	free(rows);
+	free(workspaces);
+	free(lossy);
+	sp_graph_free(&sg);
+	if (!ok) {
+		free_distance_matrix(m);
+		return NULL;
+	}
+	return m;
+}
@@ -0,0 +1,115 @@
+#ifndef DISTANCE_MATRIX_H
+#define DISTANCE_MATRIX_H
+
+#include <stdint.h>
+#include <string.h>
+#include "graph.h"
+#include "shortest_paths.h"
+
+// Encodings of one stored distance. Unreachable pairs read back as
+// SP_INF in every format.
+typedef enum {
+	DIST_F32 = 0,		// exact
+	DIST_F16,		// IEEE half, ~3 significant digits, max 65504
+	DIST_U16,		// integer distances (hop counts) below 65535
+	DIST_U8			// integer distances (hop counts) below 255
+} dist_format;
+
+// n x n shortest-path distances. Packed matrices keep only the pairs
+// i < j of a symmetric matrix (undirected graphs); the diagonal is 0.
+struct distance_matrix {
+	int num_nodes;
+	int packed;
+	dist_format format;
+	int lossy;		// a value was rounded or saturated when stored
+	void *data;
+};
+
+// Every pair SP_INF. Returns NULL if out of memory.
+distance_matrix *create_distance_matrix(int n, int packed,
+					dist_format format);
+// Takes ownership of an n x n float matrix (free()-able) without copying;
+// the matrix is freed if the wrapper cannot be allocated.
+distance_matrix *distance_matrix_wrap(float *dist, int n);
+// Copies an n x n float matrix into the given layout and format
+distance_matrix *distance_matrix_from_floats(const float *dist, int n,
+					     int packed, dist_format format);
+// All-pairs distances of g written straight into the given format, one
+// source row at a time: no n x n float matrix is ever allocated. The
+// result is packed for undirected graphs when packed is set.
+distance_matrix *compute_distance_matrix(graph * g, dist_format format,
+					 int packed);
+void free_distance_matrix(distance_matrix * m);
+
+size_t distance_matrix_bytes(const distance_matrix * m);
+// The n x n float array behind an unpacked DIST_F32 matrix, else NULL
+float *distance_matrix_floats(distance_matrix * m);
+
+// Renumbers the nodes, node i becoming new_id[i]: the distance of the
+// pair (i, j) moves to (new_id[i], new_id[j]) without being re-encoded.
+// Returns 0 (m unchanged) if out of memory.
+int distance_matrix_permute(distance_matrix * m, const int *new_id);
+
+void distance_set(distance_matrix * m, int i, int j, float d);
+// Decodes row i into row[0 .. n)
+void distance_row(const distance_matrix * m, int i, float *row);
+
+#define DIST_U8_INF 0xffu
+#define DIST_U16_INF 0xffffu
+#define DIST_F16_INF 0x7c00u
+
+static inline float half_to_float(uint16_t h)
+{
+	uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+	uint32_t exponent = (h >> 10) & 0x1f;
+	uint32_t mantissa = h & 0x3ff;
+	if (exponent == 0) {
+		float f = (float)mantissa * (1.0f / 16777216.0f);
+		return sign ? -f : f;
+	}
+	uint32_t bits = sign | (exponent == 31 ? 0x7f800000u | (mantissa << 13)
+				: ((exponent + 112) << 23) | (mantissa << 13));
+	float f;
+	memcpy(&f, &bits, sizeof(f));
+	return f;
+}
+
+// Position of the pair (i, j), i != j, in the data array
+static inline size_t distance_index(const distance_matrix * m, int i, int j)
+{
+	size_t n = (size_t)m->num_nodes;
+	if (!m->packed)
+		return (size_t)i * n + j;
+	if (i > j) {
+		int t = i;
+		i = j;
+		j = t;
+	}
+	return (size_t)i * (2 * n - i - 1) / 2 + (size_t)(j - i - 1);
+}
+
+static inline float distance_get(const distance_matrix * m, int i, int j)
+{
+	if (i == j && m->packed)
+		return 0.0f;
+	size_t p = distance_index(m, i, j);
+	switch (m->format) {
+	case DIST_F16:{
+			uint16_t h = ((const uint16_t *)m->data)[p];
+			return h == DIST_F16_INF ? SP_INF : half_to_float(h);
+		}
+	case DIST_U16:{
+			uint16_t q = ((const uint16_t *)m->data)[p];
+			return q == DIST_U16_INF ? SP_INF : (float)q;
+		}
+	case DIST_U8:{
+			uint8_t q = ((const uint8_t *)m->data)[p];
+			return q == DIST_U8_INF ? SP_INF : (float)q;
+		}
+	case DIST_F32:
+		break;
+	}
+	return ((const float *)m->data)[p];
+}
+
+#endif				// DISTANCE_MATRIX_H
@@ -0,0 +1,272 @@
+#include "edge_sink.h"
+#include "../11-helpers/thread_pool.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define ROWS_PER_TASK 1024
+
+static int count_begin(edge_sink *sink, int num_nodes, int is_directed)
+{
+	count_sink *s = (count_sink *) sink;
+	free(s->degree);
+	s->num_nodes = num_nodes;
+	s->is_directed = is_directed;
+	s->num_edges = 0;
+	s->degree = calloc(num_nodes > 0 ? (size_t)num_nodes : 1,
+			   sizeof(size_t));
+	return s->degree != NULL;
+}
+
+static int count_add(edge_sink *sink, const int *src, const int *dst,
+		     size_t count)
+{
+	count_sink *s = (count_sink *) sink;
+	for (size_t e = 0; e < count; e++) {
+		s->degree[src[e]]++;
+		if (!s->is_directed && src[e] != dst[e])
+			s->degree[dst[e]]++;
+	}
+	s->num_edges += count;
+	return 1;
+}
+
+static int end_nothing(edge_sink *sink)
+{
+	(void)sink;
+	return 1;
+}
+
+void count_sink_init(count_sink *s)
+{
+	memset(s, 0, sizeof(*s));
+	s->sink.begin = count_begin;
+	s->sink.add = count_add;
+	s->sink.end = end_nothing;
+}
+
+void count_sink_free(count_sink *s)
+{
+	free(s->degree);
+	s->degree = NULL;
+}
+
+static int csr_begin(edge_sink *sink, int num_nodes, int is_directed)
+{
+	csr_sink *s = (csr_sink *) sink;
+	s->num_nodes = num_nodes;
+	s->is_directed = is_directed;
+	if (!s->counts)
+		return 1;
+	if (s->counts->num_nodes != num_nodes
+	    || s->counts->is_directed != is_directed || !s->counts->degree)
+		return 0;
+
+	size_t n = (size_t)num_nodes;
+	s->offsets = malloc((n + 1) * sizeof(size_t));
+	s->cursor = malloc((n ? n : 1) * sizeof(size_t));
+	if (!s->offsets || !s->cursor)
+		return 0;
+	size_t arcs = 0;
+	for (size_t u = 0; u < n; u++) {
+		s->offsets[u] = s->cursor[u] = arcs;
+		arcs += s->counts->degree[u];
+	}
+	s->offsets[n] = arcs;
+	s->neighbors = malloc((arcs ? arcs : 1) * sizeof(int));
+	return s->neighbors != NULL;
+}
+
+// Appends arc u -> v to its counted row; 0 if the stream differs from
+// the counted one.
+static int csr_scatter(csr_sink *s, int u, int v)
+{
+	if (s->cursor[u] == s->offsets[u + 1])
+		return 0;
+	s->neighbors[s->cursor[u]++] = v;
+	return 1;
+}
+
+static int csr_add(edge_sink *sink, const int *src, const int *dst,
+		   size_t count)
+{
+	csr_sink *s = (csr_sink *) sink;
+	for (size_t e = 0; e < count; e++)
+		if (src[e] < 0 || src[e] >= s->num_nodes
+		    || dst[e] < 0 || dst[e] >= s->num_nodes)
+			return 0;
+
+	if (s->counts) {
+		for (size_t e = 0; e < count; e++) {
+			if (!csr_scatter(s, src[e], dst[e]))
+				return 0;
+			if (!s->is_directed && src[e] != dst[e]
+			    && !csr_scatter(s, dst[e], src[e]))
+				return 0;
+		}
+		return 1;
+	}
+
+	if (s->num_edges + count > s->capacity) {
+		size_t cap = s->capacity ? 2 * s->capacity : 4096;
+		while (cap < s->num_edges + count)
+			cap *= 2;
+		int *grown = realloc(s->src, cap * sizeof(int));
+		if (!grown)
+			return 0;
+		s->src = grown;
+		grown = realloc(s->dst, cap * sizeof(int));
+		if (!grown)
+			return 0;
+		s->dst = grown;
+		s->capacity = cap;
+	}
+	memcpy(s->src + s->num_edges, src, count * sizeof(int));
+	memcpy(s->dst + s->num_edges, dst, count * sizeof(int));
+	s->num_edges += count;
+	return 1;
+}
+
+static int compare_ints(const void *a, const void *b)
+{
+	int x = *(const int *)a, y = *(const int *)b;
+	return (x > y) - (x < y);
+}
+
+// Sorts every row and drops repeated neighbors; the new length of row u
+// goes to cursor[u].
+static void sort_rows_chunk(void *ctx, size_t begin, size_t end, int worker)
+{
+	(void)worker;
+	csr_sink *s = ctx;
+	for (size_t u = begin; u < end; u++) {
+		int *row = s->neighbors + s->offsets[u];
+		size_t len = s->offsets[u + 1] - s->offsets[u], kept = 0;
+		qsort(row, len, sizeof(int), compare_ints);
+		for (size_t k = 0; k < len; k++)
+			if (kept == 0 || row[k] != row[kept - 1])
+				row[kept++] = row[k];
+		s->cursor[u] = kept;
+	}
+}
+
+// Sorts and deduplicates the filled rows and moves them together.
+static int csr_finish_rows(csr_sink *s)
+{
+	size_t n = (size_t)s->num_nodes;
+	for (size_t u = 0; u < n; u++)
+		if (s->cursor[u] != s->offsets[u + 1])
+			return 0;	// fewer arcs than counted
+	parallel_for(n, ROWS_PER_TASK, sort_rows_chunk, s);
+
+	size_t arcs = 0;
+	for (size_t u = 0; u < n; u++) {
+		size_t len = s->cursor[u];
+		memmove(s->neighbors + arcs, s->neighbors + s->offsets[u],
+			len * sizeof(int));
+		s->offsets[u] = arcs;
+		arcs += len;
+	}
+	s->offsets[n] = arcs;
+
+	int *neighbors = realloc(s->neighbors, (arcs ? arcs : 1) * sizeof(int));
+	float *weights = malloc((arcs ? arcs : 1) * sizeof(float));
+	if (neighbors)
+		s->neighbors = neighbors;
+	s->g = create_graph_with_storage(s->num_nodes, s->is_directed,
+					 GRAPH_CSR);
+	if (!weights || !s->g) {
+		free(weights);
+		free_graph(s->g);
+		s->g = NULL;
+		return 0;
+	}
+	for (size_t p = 0; p < arcs; p++)
+		weights[p] = 1.0f;
+	free(s->g->offsets);
+	s->g->offsets = s->offsets;
+	s->g->neighbors = s->neighbors;
+	s->g->weights = weights;
+	s->offsets = NULL;
+	s->neighbors = NULL;
+	return 1;
+}
+
+static int csr_end(edge_sink *sink)
+{
+	csr_sink *s = (csr_sink *) sink;
+	if (s->counts)
+		return csr_finish_rows(s);
+
+	s->g = create_graph_from_edges(s->num_nodes, s->is_directed, s->src,
+				       s->dst, NULL, s->num_edges);
+	free(s->src);
+	free(s->dst);
+	s->src = s->dst = NULL;
+	s->num_edges = s->capacity = 0;
+	return s->g != NULL;
+}
+
+void csr_sink_init(csr_sink *s, const count_sink *counts)
+{
+	memset(s, 0, sizeof(*s));
+	s->sink.begin = csr_begin;
+	s->sink.add = csr_add;
+	s->sink.end = csr_end;
+	s->counts = counts;
+}
+
+graph *csr_sink_take(csr_sink *s)
+{
+	graph *g = s->g;
+	s->g = NULL;
+	return g;
+}
+
+void csr_sink_free(csr_sink *s)
+{
+	free_graph(s->g);
+	free(s->src);
+	free(s->dst);
+	free(s->offsets);
+	free(s->cursor);
+	free(s->neighbors);
+	csr_sink_init(s, s->counts);
+}
+
+static int file_begin(edge_sink *sink, int num_nodes, int is_directed)
+{
+	file_sink *s = (file_sink *) sink;
+	return s->csr.sink.begin(&s->csr.sink, num_nodes, is_directed);
+}
+
+static int file_add(edge_sink *sink, const int *src, const int *dst,
+		    size_t count)
+{
+	file_sink *s = (file_sink *) sink;
+	return s->csr.sink.add(&s->csr.sink, src, dst, count);
+}
+
+static int file_end(edge_sink *sink)
+{
+	file_sink *s = (file_sink *) sink;
+	if (!s->csr.sink.end(&s->csr.sink))
+		return 0;
+	int ok = save_graph_binary(s->csr.g, s->filename);
+	csr_sink_free(&s->csr);
+	return ok;
+}
+
+void file_sink_init(file_sink *s, const count_sink *counts,
+		    const char *filename)
+{
+	s->sink.begin = file_begin;
+	s->sink.add = file_add;
+	s->sink.end = file_end;
+	csr_sink_init(&s->csr, counts);
+	s->filename = filename;
+}
+
+void file_sink_free(file_sink *s)
+{
+	csr_sink_free(&s->csr);
+}
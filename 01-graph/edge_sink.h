@@ -0,0 +1,72 @@
+#ifndef EDGE_SINK_H
+#define EDGE_SINK_H
+
+#include "graph.h"
+
+// Receiver of a generated edge stream. A generator calls begin once, add
+// for every batch of edges (src[i], dst[i]) and end once, all from one
+// thread and in an order fixed by its seed. Undirected edges are passed
+// once and mirrored by the sink. Each callback returns 0 on failure,
+// which makes the generator stop and return 0 too.
+//
+// A generator run is repeatable, which the sinks use to build a graph
+// without holding it twice: one run into a count_sink gives the exact
+// row sizes, a second run with the same seed into a csr_sink or
+// file_sink built on those counts scatters every arc straight into its
+// row. Without counts those sinks buffer the edge list instead.
+typedef struct edge_sink edge_sink;
+struct edge_sink {
+	int (*begin)(edge_sink * sink, int num_nodes, int is_directed);
+	int (*add)(edge_sink * sink, const int *src, const int *dst,
+		   size_t count);
+	int (*end)(edge_sink * sink);
+};
+
+// Counts edges and the arcs of every node, duplicates included
+typedef struct {
+	edge_sink sink;
+	int num_nodes;
+	int is_directed;
+	size_t num_edges;
+	size_t *degree;		// num_nodes entries after begin
+} count_sink;
+
+void count_sink_init(count_sink * s);
+void count_sink_free(count_sink * s);
+
+// Builds CSR storage with unit weights. Duplicate edges are merged.
+typedef struct {
+	edge_sink sink;
+	const count_sink *counts;	// optional, from an identical run
+	int num_nodes;
+	int is_directed;
+	graph *g;		// result after end
+	// Without counts: the buffered edge list
+	int *src;
+	int *dst;
+	size_t num_edges;
+	size_t capacity;
+	// With counts: rows being filled
+	size_t *offsets;
+	size_t *cursor;
+	int *neighbors;
+} csr_sink;
+
+void csr_sink_init(csr_sink * s, const count_sink * counts);
+// Hands the graph over to the caller; NULL if the stream failed
+graph *csr_sink_take(csr_sink * s);
+void csr_sink_free(csr_sink * s);
+
+// Writes the stream to a binary graph file (save_graph_binary format).
+// The CSR arrays are held once while the file is written.
+typedef struct {
+	edge_sink sink;
+	csr_sink csr;
+	const char *filename;
+} file_sink;
+
+void file_sink_init(file_sink * s, const count_sink * counts,
+		    const char *filename);
+void file_sink_free(file_sink * s);
+
+#endif				// EDGE_SINK_H
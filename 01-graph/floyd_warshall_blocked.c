@@ -0,0 +1,278 @@
+#include "shortest_paths.h"
+#include "../11-helpers/thread_pool.h"
+#include "../11-helpers/cpu_features.h"
+#include <stdlib.h>
+#include <string.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_KERNELS 1
+#endif
+
+// Three-phase blocked Floyd-Warshall. For every pivot block kb:
+//   1. the diagonal block (kb, kb) runs plain Floyd-Warshall,
+//   2. the blocks in row kb and column kb relax through the diagonal one,
+//   3. every other block (i, j) takes min(C, A (+) B) with A = (i, kb) and
+//      B = (kb, j), independently of the others, in parallel.
+// Blocks of FW_BLOCK x FW_BLOCK floats stay in L1/L2 and the min-plus
+// inner loops run on 8 (AVX2) or 16 (AVX-512) lanes.
+//
+// There is no "< INF" test in the kernels: with non-negative weights
+// INF + x >= INF, so unreachable entries stay exactly SP_INF.
+
+#define FW_BLOCK 64
+
+// C = min(C, A (+) B) with the pivot loop outermost, which keeps the
+// result correct when A or B alias C (phases 1 and 2).
+typedef void (*fw_pivot_kernel)(float *c, const float *a, const float *b,
+				size_t stride);
+// Same product for non-aliased blocks, with a row of C kept in registers
+typedef void (*fw_product_kernel)(float *c, const float *a,
+				  const float *b, size_t stride);
+
+static void pivot_scalar(float *c, const float *a, const float *b,
+			 size_t stride)
+{
+	for (int k = 0; k < FW_BLOCK; k++) {
+		const float *bk = b + k * stride;
+		for (int i = 0; i < FW_BLOCK; i++) {
+			float aik = a[i * stride + k];
+			float *ci = c + i * stride;
+			for (int j = 0; j < FW_BLOCK; j++) {
+				float alt = aik + bk[j];
+				if (alt < ci[j])
+					ci[j] = alt;
+			}
+		}
+	}
+}
+
+static void product_scalar(float *c, const float *a, const float *b,
+			   size_t stride)
+{
+	for (int i = 0; i < FW_BLOCK; i++) {
+		float *ci = c + i * stride;
+		for (int k = 0; k < FW_BLOCK; k++) {
+			float aik = a[i * stride + k];
+			const float *bk = b + k * stride;
+			for (int j = 0; j < FW_BLOCK; j++) {
+				float alt = aik + bk[j];
+				if (alt < ci[j])
+					ci[j] = alt;
+			}
+		}
+	}
+}
+
+#ifdef HAVE_X86_KERNELS
+__attribute__((target("avx2")))
+static void pivot_avx2(float *c, const float *a, const float *b,
+		       size_t stride)
+{
+	for (int k = 0; k < FW_BLOCK; k++) {
+		const float *bk = b + k * stride;
+		for (int i = 0; i < FW_BLOCK; i++) {
+			__m256 aik = _mm256_set1_ps(a[i * stride + k]);
+			float *ci = c + i * stride;
+			for (int j = 0; j < FW_BLOCK; j += 8) {
+				__m256 alt =
+				    _mm256_add_ps(aik, _mm256_loadu_ps(bk + j));
+				_mm256_storeu_ps(ci + j,
+						 _mm256_min_ps(_mm256_loadu_ps
+							       (ci + j), alt));
+			}
+		}
+	}
+}
+
+__attribute__((target("avx2")))
+static void product_avx2(float *c, const float *a, const float *b,
+			 size_t stride)
+{
+	for (int i = 0; i < FW_BLOCK; i++) {
+		float *ci = c + i * stride;
+		const float *ai = a + i * stride;
+		__m256 acc[FW_BLOCK / 8];
+		for (int t = 0; t < FW_BLOCK / 8; t++)
+			acc[t] = _mm256_loadu_ps(ci + 8 * t);
+		for (int k = 0; k < FW_BLOCK; k++) {
+			const float *bk = b + k * stride;
+			__m256 aik = _mm256_set1_ps(ai[k]);
+			for (int t = 0; t < FW_BLOCK / 8; t++)
+				acc[t] = _mm256_min_ps(acc[t],
+						       _mm256_add_ps(aik,
+								     _mm256_loadu_ps
+								     (bk + 8 * t)));
+		}
+		for (int t = 0; t < FW_BLOCK / 8; t++)
+			_mm256_storeu_ps(ci + 8 * t, acc[t]);
+	}
+}
+
+__attribute__((target("avx512f")))
+static void pivot_avx512(float *c, const float *a, const float *b,
+			 size_t stride)
+{
+	for (int k = 0; k < FW_BLOCK; k++) {
+		const float *bk = b + k * stride;
+		for (int i = 0; i < FW_BLOCK; i++) {
+			__m512 aik = _mm512_set1_ps(a[i * stride + k]);
+			float *ci = c + i * stride;
+			for (int j = 0; j < FW_BLOCK; j += 16) {
+				__m512 alt =
+				    _mm512_add_ps(aik, _mm512_loadu_ps(bk + j));
+				_mm512_storeu_ps(ci + j,
+						 _mm512_min_ps(_mm512_loadu_ps
+							       (ci + j), alt));
+			}
+		}
+	}
+}
+
+__attribute__((target("avx512f")))
+static void product_avx512(float *c, const float *a, const float *b,
+			   size_t stride)
+{
+	for (int i = 0; i < FW_BLOCK; i++) {
+		float *ci = c + i * stride;
+		const float *ai = a + i * stride;
+		__m512 acc[FW_BLOCK / 16];
+		for (int t = 0; t < FW_BLOCK / 16; t++)
+			acc[t] = _mm512_loadu_ps(ci + 16 * t);
+		for (int k = 0; k < FW_BLOCK; k++) {
+			const float *bk = b + k * stride;
+			__m512 aik = _mm512_set1_ps(ai[k]);
+			for (int t = 0; t < FW_BLOCK / 16; t++)
+				acc[t] = _mm512_min_ps(acc[t],
+						       _mm512_add_ps(aik,
+								     _mm512_loadu_ps
+								     (bk + 16 * t)));
+		}
+		for (int t = 0; t < FW_BLOCK / 16; t++)
+			_mm512_storeu_ps(ci + 16 * t, acc[t]);
+	}
+}
+#endif
+
+typedef struct {
+	float *dist;
+	size_t stride;		// padded row length
+	int num_blocks;
+	int kb;			// current pivot block
+	fw_pivot_kernel pivot;
+	fw_product_kernel product;
+} fw_job;
+
+#define BLOCK(job, bi, bj) \
+	((job)->dist + (size_t)(bi) * FW_BLOCK * (job)->stride \
+	 + (size_t)(bj) * FW_BLOCK)
+
+// Phase 2: items [0, nb) are the row blocks, [nb, 2nb) the column blocks
+static void phase2_chunk(void *ctx, size_t begin, size_t end, int worker)
+{
+	(void)worker;
+	fw_job *job = ctx;
+	int nb = job->num_blocks, kb = job->kb;
+	const float *diag = BLOCK(job, kb, kb);
+	for (size_t item = begin; item < end; item++) {
+		int b = (int)(item % nb);
+		if (b == kb)
+			continue;
+		if (item < (size_t)nb) {
+			float *row = BLOCK(job, kb, b);
+			job->pivot(row, diag, row, job->stride);
+		} else {
+			float *col = BLOCK(job, b, kb);
+			job->pivot(col, col, diag, job->stride);
+		}
+	}
+}
+
+// Phase 3: item = bi * nb + bj
+static void phase3_chunk(void *ctx, size_t begin, size_t end, int worker)
+{
+	(void)worker;
+	fw_job *job = ctx;
+	int nb = job->num_blocks, kb = job->kb;
+	for (size_t item = begin; item < end; item++) {
+		int bi = (int)(item / nb), bj = (int)(item % nb);
+		if (bi == kb || bj == kb)
+			continue;
+		job->product(BLOCK(job, bi, bj), BLOCK(job, bi, kb),
+			     BLOCK(job, kb, bj), job->stride);
+	}
+}
+
+static void select_kernels(fw_job *job)
+{
+	job->pivot = pivot_scalar;
+	job->product = product_scalar;
+#ifdef HAVE_X86_KERNELS
+	switch (cpu_simd_isa()) {
+	case SIMD_AVX512:
+		job->pivot = pivot_avx512;
+		job->product = product_avx512;
+		break;
+	case SIMD_AVX2:
+		job->pivot = pivot_avx2;
+		job->product = product_avx2;
+		break;
+	default:
+		break;
+	}
+#endif
+}
+
+int floyd_warshall_blocked(float *dist, int n)
+{
+	if (n <= 0)
+		return 1;
+
+	// Pad to whole blocks with isolated nodes unless n already fits.
+	int num_blocks = (n + FW_BLOCK - 1) / FW_BLOCK;
+	size_t padded = (size_t)num_blocks * FW_BLOCK;
+	float *work = dist;
+	if (padded != (size_t)n) {
+		work = malloc(padded * padded * sizeof(float));
+		if (!work)
+			return 0;
+		for (size_t i = 0; i < padded; i++) {
+			float *row = work + i * padded;
+			if (i < (size_t)n)
+				memcpy(row, dist + i * n, n * sizeof(float));
+			for (size_t j = i < (size_t)n ? (size_t)n : 0;
+			     j < padded; j++)
+				row[j] = (i == j) ? 0.0f : SP_INF;
+		}
+	}
+
+	fw_job job = { work, padded, num_blocks, 0, NULL, NULL };
+	select_kernels(&job);
+
+	size_t grain = 4;
+	for (int kb = 0; kb < num_blocks; kb++) {
+		job.kb = kb;
+		float *diag = BLOCK(&job, kb, kb);
+		job.pivot(diag, diag, diag, job.stride);
+		parallel_for(2 * (size_t)num_blocks, 1, phase2_chunk, &job);
+		parallel_for((size_t)num_blocks * num_blocks, grain,
+			     phase3_chunk, &job);
+	}
+
+	if (work != dist) {
+		for (int i = 0; i < n; i++)
+			memcpy(dist + (size_t)i * n, work + (size_t)i * padded,
+			       n * sizeof(float));
+		free(work);
+	}
+	return 1;
+}
+
+const char *floyd_warshall_blocked_kernel(void)
+{
+#ifdef HAVE_X86_KERNELS
+	simd_isa isa = cpu_simd_isa();
+	if (isa >= SIMD_AVX2)
+		return simd_isa_name(isa);
+#endif
+	return simd_isa_name(SIMD_SCALAR);
+}
@@ -1,103 +1,849 @@
 #include "graph.h"
+#include "bit_matrix.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include<math.h>
-#define INF 1e9f
-#define DIST(i,j) dist[(i)*n + (j)]
+#include <sys/mman.h>
 
-float *compute_all_pairs_distances(graph *g)
+// Encoding of a removed CSR arc; keeps the row sorted by neighbor id.
+#define CSR_DEAD(v) (~(v))
+#define CSR_ID(x) ((x) < 0 ? ~(x) : (x))
+
+static int alloc_dense(graph *g)
 {
-	int n = g->num_nodes;
-	float *dist = malloc(n * n * sizeof(float));
-	if (!dist)
-		return NULL;
+	size_t cells = (size_t)g->num_nodes * g->num_nodes;
+	g->edges = calloc(cells, sizeof(int));
+	g->edge_weights = calloc(cells, sizeof(float));
+	if (!g->edges || !g->edge_weights) {
+		free(g->edges);
+		free(g->edge_weights);
+		g->edges = NULL;
+		g->edge_weights = NULL;
+		return 0;
+	}
+	return 1;
+}
 
-#define DIST(i,j) dist[(i)*n + (j)]
+// Weight of every arc of a bit matrix without a weight matrix
+static float unit_weight = 1.0f;
 
-	for (int i = 0; i < n; i++) {
-		for (int j = 0; j < n; j++) {
-			if (i == j) {
-				DIST(i, j) = 0.0f;
-			} else if (g->edges[i * n + j] == 1) {
-				DIST(i, j) = g->edge_weights[i * n + j];
-			} else {
-				DIST(i, j) = INF;
-			}
-		}
-	}
+static int alloc_bits(graph *g)
+{
+	g->row_words = bit_row_words(g->num_nodes);
+	size_t words = (size_t)g->num_nodes * g->row_words;
+	g->bits = calloc(words ? words : 1, sizeof(uint64_t));
+	return g->bits != NULL;
+}
 
-	for (int k = 0; k < n; k++) {
-		for (int i = 0; i < n; i++) {
-			for (int j = 0; j < n; j++) {
-				if (DIST(i, k) < INF && DIST(k, j) < INF) {
-					float alt =
-					    DIST(i, k) + DIST(k, j);
-					if (alt < DIST(i, j)) {
-						DIST(i, j) = alt;
-					}
-				}
-			}
-		}
-	}
+// Gives a bit matrix its weight matrix, with every arc at weight 1
+static int alloc_bit_weights(graph *g)
+{
+	if (g->edge_weights)
+		return 1;
+	size_t cells = (size_t)g->num_nodes * g->num_nodes;
+	g->edge_weights = malloc((cells ? cells : 1) * sizeof(float));
+	if (!g->edge_weights)
+		return 0;
+	for (size_t c = 0; c < cells; c++)
+		g->edge_weights[c] = 1.0f;
+	return 1;
+}
 
-	return dist;
+static int alloc_sets(graph *g)
+{
+	g->sets = calloc((size_t)g->num_nodes, sizeof(neighbor_set));
+	return g->sets != NULL;
 }
 
-graph *create_graph(int n, int is_directed)
+static void free_sets(graph *g)
+{
+	if (!g->sets)
+		return;
+	for (int u = 0; u < g->num_nodes; u++)
+		neighbor_set_free(&g->sets[u]);
+	free(g->sets);
+	g->sets = NULL;
+}
+
+graph *create_graph_with_storage(int n, int is_directed,
+				 graph_storage storage)
 {
-	graph *g = malloc(sizeof(graph));
+	graph *g = calloc(1, sizeof(graph));
 	if (!g)
 		return NULL;
 
 	g->num_nodes = n;
 	g->is_directed = is_directed;
-	g->edges = malloc(n * n * sizeof(int));
-	g->edge_weights = malloc(n * n * sizeof(float));
-	if (!g->edges || !g->edge_weights) {
-		free(g->edges);
-		free(g->edge_weights);
+	g->storage = storage;
+	if (storage == GRAPH_CSR) {
+		// An empty CSR graph is all-zero offsets and no arcs.
+		g->offsets = calloc((size_t)n + 1, sizeof(size_t));
+		if (!g->offsets) {
+			free(g);
+			return NULL;
+		}
+		return g;
+	}
+	if (storage == GRAPH_DYNAMIC) {
+		if (!alloc_sets(g)) {
+			free(g);
+			return NULL;
+		}
+		return g;
+	}
+	if (storage == GRAPH_BITMATRIX) {
+		if (!alloc_bits(g)) {
+			free(g);
+			return NULL;
+		}
+		return g;
+	}
+	if (!alloc_dense(g)) {
 		free(g);
 		return NULL;
 	}
-	memset(g->edges, 0, n * n * sizeof(int));
-	memset(g->edge_weights, 0, n * n * sizeof(float));
 	return g;
 }
 
+graph *create_graph(int n, int is_directed)
+{
+	return create_graph_with_storage(n, is_directed, GRAPH_DENSE);
+}
+
+static void free_csr(graph *g)
+{
+	if (g->mapping) {
+		munmap(g->mapping, g->mapping_size);
+		g->mapping = NULL;
+		g->mapping_size = 0;
+	} else {
+		free(g->offsets);
+		free(g->neighbors);
+		free(g->weights);
+	}
+	free(g->pending);
+	g->offsets = NULL;
+	g->neighbors = NULL;
+	g->weights = NULL;
+	g->pending = NULL;
+	g->num_dead = 0;
+	g->num_pending = 0;
+	g->pending_capacity = 0;
+}
+
 void free_graph(graph *g)
 {
 	if (!g)
 		return;
 	free(g->edges);
 	free(g->edge_weights);
+	free(g->bits);
+	free_csr(g);
+	free_sets(g);
 	free(g);
 }
 
+typedef struct {
+	int v;
+	int seq;
+	float weight;
+} row_entry;
+
+static int compare_row_entries(const void *a, const void *b)
+{
+	const row_entry *x = a;
+	const row_entry *y = b;
+	if (x->v != y->v)
+		return (x->v > y->v) - (x->v < y->v);
+	return (x->seq > y->seq) - (x->seq < y->seq);
+}
+
+// Merges the pending arcs into the rows and drops removed arcs. When the
+// same arc was added more than once the last weight wins, as it does for
+// repeated add_edge calls on the dense matrix. O(n + m) plus the cost of
+// sorting the rows that received new arcs. Dynamic storage instead gets
+// its hash sets shrunk to fit.
+void graph_compact(graph *g)
+{
+	if (g->storage == GRAPH_DYNAMIC) {
+		for (int u = 0; u < g->num_nodes; u++)
+			neighbor_set_shrink(&g->sets[u]);
+		return;
+	}
+	if (g->storage != GRAPH_CSR
+	    || (g->num_pending == 0 && g->num_dead == 0))
+		return;
+
+	int n = g->num_nodes;
+	size_t *offsets = calloc((size_t)n + 1, sizeof(size_t));
+	if (!offsets)
+		return;
+
+	for (int u = 0; u < n; u++) {
+		for (size_t p = g->offsets[u]; p < g->offsets[u + 1]; p++)
+			if (g->neighbors[p] >= 0)
+				offsets[u + 1]++;
+	}
+	for (size_t p = 0; p < g->num_pending; p++)
+		offsets[g->pending[p].u + 1]++;
+	for (int u = 0; u < n; u++)
+		offsets[u + 1] += offsets[u];
+
+	size_t total = offsets[n];
+	int *neighbors = malloc((total ? total : 1) * sizeof(int));
+	float *weights = malloc((total ? total : 1) * sizeof(float));
+	size_t *fill = malloc(((size_t)n + 1) * sizeof(size_t));
+	int *grown = calloc((size_t)n, sizeof(int));
+	if (!neighbors || !weights || !fill || !grown) {
+		free(offsets);
+		free(neighbors);
+		free(weights);
+		free(fill);
+		free(grown);
+		return;
+	}
+
+	// Stable scatter: existing arcs first, then pending ones in the
+	// order they were added.
+	size_t max_row = 0;
+	for (int u = 0; u < n; u++) {
+		fill[u] = offsets[u];
+		for (size_t p = g->offsets[u]; p < g->offsets[u + 1]; p++) {
+			if (g->neighbors[p] < 0)
+				continue;
+			neighbors[fill[u]] = g->neighbors[p];
+			weights[fill[u]++] = g->weights[p];
+		}
+		if (offsets[u + 1] - offsets[u] > max_row)
+			max_row = offsets[u + 1] - offsets[u];
+	}
+	for (size_t p = 0; p < g->num_pending; p++) {
+		graph_edge *e = &g->pending[p];
+		neighbors[fill[e->u]] = e->v;
+		weights[fill[e->u]++] = e->weight;
+		grown[e->u] = 1;
+	}
+	free(fill);
+
+	row_entry *row = malloc((max_row ? max_row : 1) * sizeof(row_entry));
+	if (!row) {
+		free(offsets);
+		free(neighbors);
+		free(weights);
+		free(grown);
+		return;
+	}
+
+	// Sort and deduplicate the rows that got new arcs, writing the
+	// result back compacted towards the front of the arrays.
+	size_t out = 0;
+	for (int u = 0; u < n; u++) {
+		size_t begin = offsets[u];
+		size_t len = offsets[u + 1] - begin;
+		offsets[u] = out;
+		if (!grown[u]) {
+			memmove(neighbors + out, neighbors + begin,
+				len * sizeof(int));
+			memmove(weights + out, weights + begin,
+				len * sizeof(float));
+			out += len;
+			continue;
+		}
+		for (size_t k = 0; k < len; k++) {
+			row[k].v = neighbors[begin + k];
+			row[k].seq = (int)k;
+			row[k].weight = weights[begin + k];
+		}
+		qsort(row, len, sizeof(row_entry), compare_row_entries);
+		for (size_t k = 0; k < len; k++) {
+			if (k + 1 < len && row[k + 1].v == row[k].v)
+				continue;
+			neighbors[out] = row[k].v;
+			weights[out++] = row[k].weight;
+		}
+	}
+	offsets[n] = out;
+	free(row);
+	free(grown);
+
+	free_csr(g);
+	g->offsets = offsets;
+	g->neighbors = neighbors;
+	g->weights = weights;
+}
+
+static void log_change(graph *g, int u, int v, float old_weight,
+		       float new_weight)
+{
+	graph_change_log *log = g->change_log;
+	if (!log || old_weight == new_weight)
+		return;
+	if (log->count == log->capacity) {
+		size_t cap = log->capacity ? 2 * log->capacity : 256;
+		graph_arc_change *grown =
+		    realloc(log->changes, cap * sizeof(graph_arc_change));
+		if (!grown) {
+			log->overflowed = 1;
+			return;
+		}
+		log->changes = grown;
+		log->capacity = cap;
+	}
+	log->changes[log->count++] = (graph_arc_change) {
+	u, v, old_weight, new_weight};
+}
+
+void graph_change_log_clear(graph_change_log *log)
+{
+	log->count = 0;
+	log->overflowed = 0;
+}
+
+void graph_change_log_free(graph_change_log *log)
+{
+	free(log->changes);
+	log->changes = NULL;
+	log->count = 0;
+	log->capacity = 0;
+	log->overflowed = 0;
+}
+
+static void flush_pending(graph *g)
+{
+	if (g->storage == GRAPH_CSR && g->num_pending)
+		graph_compact(g);
+}
+
+// Position of the arc (u, v) in the CSR arrays, live or removed, or -1.
+static long csr_find(graph *g, int u, int v)
+{
+	size_t lo = g->offsets[u];
+	size_t hi = g->offsets[u + 1];
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		int x = CSR_ID(g->neighbors[mid]);
+		if (x == v)
+			return (long)mid;
+		if (x < v)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return -1;
+}
+
+static void csr_add_arc(graph *g, int u, int v, float weight)
+{
+	long p = csr_find(g, u, v);
+	if (p >= 0) {
+		if (g->neighbors[p] < 0) {
+			log_change(g, u, v, GRAPH_NO_ARC, weight);
+			g->neighbors[p] = v;
+			g->num_dead--;
+		} else {
+			log_change(g, u, v, g->weights[p], weight);
+		}
+		g->weights[p] = weight;
+		return;
+	}
+
+	if (g->num_pending == g->pending_capacity) {
+		size_t cap = g->pending_capacity ? 2 * g->pending_capacity : 64;
+		graph_edge *grown = realloc(g->pending, cap * sizeof(graph_edge));
+		if (!grown)
+			return;
+		g->pending = grown;
+		g->pending_capacity = cap;
+	}
+	// A second pending add of the same arc logs GRAPH_NO_ARC as its old
+	// weight; the first entry of the pair still holds the true one.
+	log_change(g, u, v, GRAPH_NO_ARC, weight);
+	g->pending[g->num_pending++] = (graph_edge) {
+	u, v, weight};
+}
+
+static void csr_remove_arc(graph *g, int u, int v)
+{
+	long p = csr_find(g, u, v);
+	if (p >= 0 && g->neighbors[p] >= 0) {
+		log_change(g, u, v, g->weights[p], GRAPH_NO_ARC);
+		g->neighbors[p] = CSR_DEAD(v);
+		g->num_dead++;
+	}
+}
+
+static void dynamic_add_arc(graph *g, int u, int v, float weight)
+{
+	if (g->change_log) {
+		int p = neighbor_set_find(&g->sets[u], v);
+		log_change(g, u, v,
+			   p < 0 ? GRAPH_NO_ARC : g->sets[u].slots[p].weight,
+			   weight);
+	}
+	neighbor_set_insert(&g->sets[u], v, weight);
+}
+
+static void dynamic_remove_arc(graph *g, int u, int v)
+{
+	if (g->change_log) {
+		int p = neighbor_set_find(&g->sets[u], v);
+		if (p >= 0)
+			log_change(g, u, v, g->sets[u].slots[p].weight,
+				   GRAPH_NO_ARC);
+	}
+	neighbor_set_remove(&g->sets[u], v);
+}
+
+static void dense_set_arc(graph *g, int u, int v, int present,
+			  float weight)
+{
+	size_t cell = (size_t)g->num_nodes * u + v;
+	log_change(g, u, v, g->edges[cell] ? g->edge_weights[cell]
+		   : GRAPH_NO_ARC, present ? weight : GRAPH_NO_ARC);
+	g->edges[cell] = present;
+	g->edge_weights[cell] = weight;
+}
+
+static void bits_set_arc(graph *g, int u, int v, int present, float weight)
+{
+	uint64_t *row = g->bits + (size_t)u * g->row_words;
+	size_t cell = (size_t)g->num_nodes * u + v;
+	float old_weight = !bit_test(row, v) ? GRAPH_NO_ARC
+	    : g->edge_weights ? g->edge_weights[cell] : 1.0f;
+	if (present && weight != 1.0f && !alloc_bit_weights(g))
+		return;
+	log_change(g, u, v, old_weight, present ? weight : GRAPH_NO_ARC);
+	if (!present) {
+		bit_clear(row, v);
+		return;
+	}
+	bit_set(row, v);
+	if (g->edge_weights)
+		g->edge_weights[cell] = weight;
+}
+
 void add_edge(graph *g, int u, int v, float weight)
 {
 	if (u < 0 || v < 0 || u >= g->num_nodes || v >= g->num_nodes)
 		return;
 
-	g->edges[g->num_nodes * u + v] = 1;
-	g->edge_weights[g->num_nodes * u + v] = weight;
-	if (!g->is_directed) {
-		g->edges[g->num_nodes * v + u] = 1;
-		g->edge_weights[g->num_nodes * v + u] = weight;
+	switch (g->storage) {
+	case GRAPH_CSR:
+		csr_add_arc(g, u, v, weight);
+		if (!g->is_directed && u != v)
+			csr_add_arc(g, v, u, weight);
+		return;
+	case GRAPH_DYNAMIC:
+		dynamic_add_arc(g, u, v, weight);
+		if (!g->is_directed && u != v)
+			dynamic_add_arc(g, v, u, weight);
+		return;
+	case GRAPH_BITMATRIX:
+		bits_set_arc(g, u, v, 1, weight);
+		if (!g->is_directed && u != v)
+			bits_set_arc(g, v, u, 1, weight);
+		return;
+	case GRAPH_DENSE:
+		break;
+	}
+
+	dense_set_arc(g, u, v, 1, weight);
+	if (!g->is_directed)
+		dense_set_arc(g, v, u, 1, weight);
+}
+
+void remove_edge(graph *g, int u, int v)
+{
+	if (u < 0 || v < 0 || u >= g->num_nodes || v >= g->num_nodes)
+		return;
+
+	switch (g->storage) {
+	case GRAPH_CSR:
+		flush_pending(g);
+		csr_remove_arc(g, u, v);
+		if (!g->is_directed)
+			csr_remove_arc(g, v, u);
+		return;
+	case GRAPH_DYNAMIC:
+		dynamic_remove_arc(g, u, v);
+		if (!g->is_directed)
+			dynamic_remove_arc(g, v, u);
+		return;
+	case GRAPH_BITMATRIX:
+		bits_set_arc(g, u, v, 0, 0.0f);
+		if (!g->is_directed)
+			bits_set_arc(g, v, u, 0, 0.0f);
+		return;
+	case GRAPH_DENSE:
+		break;
 	}
+
+	dense_set_arc(g, u, v, 0, 0.0f);
+	if (!g->is_directed)
+		dense_set_arc(g, v, u, 0, 0.0f);
+}
+
+// Location of the live arc (u, v): its weight, or NULL if absent. For a
+// bit matrix without weights that is the shared, read-only unit_weight.
+static float *find_weight(graph *g, int u, int v)
+{
+	switch (g->storage) {
+	case GRAPH_CSR:{
+			flush_pending(g);
+			long p = csr_find(g, u, v);
+			if (p < 0 || g->neighbors[p] < 0)
+				return NULL;
+			return &g->weights[p];
+		}
+	case GRAPH_DYNAMIC:{
+			int p = neighbor_set_find(&g->sets[u], v);
+			return p < 0 ? NULL : &g->sets[u].slots[p].weight;
+		}
+	case GRAPH_BITMATRIX:
+		if (!bit_test(g->bits + (size_t)u * g->row_words, v))
+			return NULL;
+		return g->edge_weights
+		    ? &g->edge_weights[(size_t)g->num_nodes * u + v]
+		    : &unit_weight;
+	case GRAPH_DENSE:
+		break;
+	}
+	if (!g->edges[g->num_nodes * u + v])
+		return NULL;
+	return &g->edge_weights[g->num_nodes * u + v];
 }
 
 int is_connected(graph *g, int u, int v)
 {
-	return g->edges[g->num_nodes * u + v];
+	if (g->storage == GRAPH_DENSE)
+		return g->edges[g->num_nodes * u + v];
+	if (g->storage == GRAPH_BITMATRIX)
+		return bit_test(g->bits + (size_t)u * g->row_words, v);
+	return find_weight(g, u, v) != NULL;
 }
 
+// Weight of the arc (u, v), 0 when there is no such arc
 float get_weight(graph *g, int u, int v)
 {
-	return g->edge_weights[g->num_nodes * u + v];
+	float *w = find_weight(g, u, v);
+	return w ? *w : 0.0f;
 }
 
-graph *read_graph(char *filename)
+// Writable weight of a bit matrix arc found as unit_weight, NULL if the
+// weight matrix cannot be allocated
+static float *bit_weight_slot(graph *g, int u, int v)
+{
+	if (!alloc_bit_weights(g))
+		return NULL;
+	return &g->edge_weights[(size_t)g->num_nodes * u + v];
+}
+
+// Updates the weight of an existing arc; absent arcs are left absent.
+void set_weight(graph *g, int u, int v, float weight)
+{
+	float *w = find_weight(g, u, v);
+	if (w == &unit_weight)
+		w = weight == 1.0f ? NULL : bit_weight_slot(g, u, v);
+	if (w) {
+		log_change(g, u, v, *w, weight);
+		*w = weight;
+	}
+}
+
+// Out-degree for directed graphs, degree otherwise
+int get_degree(graph *g, int u)
+{
+	int degree = 0;
+	switch (g->storage) {
+	case GRAPH_CSR:
+		flush_pending(g);
+		if (g->num_dead == 0)
+			return (int)(g->offsets[u + 1] - g->offsets[u]);
+		for (size_t p = g->offsets[u]; p < g->offsets[u + 1]; p++)
+			if (g->neighbors[p] >= 0)
+				degree++;
+		return degree;
+	case GRAPH_DYNAMIC:
+		return g->sets[u].size;
+	case GRAPH_BITMATRIX:
+		return (int)bit_row_popcount(g->bits + (size_t)u * g->row_words,
+					     g->row_words);
+	case GRAPH_DENSE:
+		break;
+	}
+	for (int v = 0; v < g->num_nodes; v++) {
+		if (g->edges[g->num_nodes * u + v])
+			degree++;
+	}
+	return degree;
+}
+
+// Number of stored arcs; an undirected edge counts once per direction.
+size_t graph_num_arcs(graph *g)
+{
+	size_t arcs = 0;
+	switch (g->storage) {
+	case GRAPH_CSR:
+		flush_pending(g);
+		return g->offsets[g->num_nodes] - g->num_dead;
+	case GRAPH_DYNAMIC:
+		for (int u = 0; u < g->num_nodes; u++)
+			arcs += (size_t)g->sets[u].size;
+		return arcs;
+	case GRAPH_BITMATRIX:
+		return bit_row_popcount(g->bits,
+					(size_t)g->num_nodes * g->row_words);
+	case GRAPH_DENSE:
+		break;
+	}
+	size_t cells = (size_t)g->num_nodes * g->num_nodes;
+	for (size_t c = 0; c < cells; c++)
+		arcs += g->edges[c] != 0;
+	return arcs;
+}
+
+neighbor_iter graph_neighbors(graph *g, int u)
+{
+	neighbor_iter it = { 0 };
+	it.g = g;
+	it.u = u;
+	switch (g->storage) {
+	case GRAPH_CSR:
+		flush_pending(g);
+		it.pos = g->offsets[u];
+		it.end = g->offsets[u + 1];
+		break;
+	case GRAPH_DYNAMIC:
+		it.pos = 0;
+		it.end = (size_t)g->sets[u].capacity;
+		break;
+	case GRAPH_BITMATRIX:
+		it.pos = 0;
+		it.end = g->row_words;
+		break;
+	case GRAPH_DENSE:
+		it.pos = 0;
+		it.end = (size_t)g->num_nodes;
+		break;
+	}
+	return it;
+}
+
+// Weight slot of the arc the iterator points at, NULL once it is removed
+static float *iter_weight(neighbor_iter *it)
+{
+	graph *g = it->g;
+	size_t p = it->pos - 1;
+	switch (g->storage) {
+	case GRAPH_CSR:
+		return g->neighbors[p] < 0 ? NULL : &g->weights[p];
+	case GRAPH_DYNAMIC:
+		return g->sets[it->u].slots[p].v < 0 ? NULL
+		    : &g->sets[it->u].slots[p].weight;
+	case GRAPH_BITMATRIX:
+		return find_weight(g, it->u, it->v);
+	case GRAPH_DENSE:
+		break;
+	}
+	size_t cell = (size_t)it->u * g->num_nodes + it->v;
+	return g->edges[cell] ? &g->edge_weights[cell] : NULL;
+}
+
+// Setting the weight of an arc removed through the same iterator is a
+// no-op.
+void neighbor_set_weight(neighbor_iter *it, float weight)
+{
+	float *w = iter_weight(it);
+	if (w == &unit_weight)
+		w = weight == 1.0f ? NULL : bit_weight_slot(it->g, it->u, it->v);
+	if (!w)
+		return;
+	log_change(it->g, it->u, it->v, *w, weight);
+	*w = weight;
+}
+
+void neighbor_remove(neighbor_iter *it)
+{
+	graph *g = it->g;
+	float *w = iter_weight(it);
+	if (!w)
+		return;
+	log_change(g, it->u, it->v, *w, GRAPH_NO_ARC);
+	switch (g->storage) {
+	case GRAPH_CSR:
+		g->neighbors[it->pos - 1] = CSR_DEAD(it->v);
+		g->num_dead++;
+		break;
+	case GRAPH_DYNAMIC:
+		g->sets[it->u].slots[it->pos - 1].v = NEIGHBOR_DELETED;
+		g->sets[it->u].size--;
+		break;
+	case GRAPH_BITMATRIX:
+		bit_clear(g->bits + (size_t)it->u * g->row_words, it->v);
+		break;
+	case GRAPH_DENSE:
+		g->edges[(size_t)it->u * g->num_nodes + it->v] = 0;
+		break;
+	}
+}
+
+static int compare_ints(const void *a, const void *b)
+{
+	int x = *(const int *)a;
+	int y = *(const int *)b;
+	return (x > y) - (x < y);
+}
+
+static int build_csr(graph *g, graph *out)
+{
+	int n = g->num_nodes;
+	size_t arcs = graph_num_arcs(g);
+	size_t *offsets = malloc(((size_t)n + 1) * sizeof(size_t));
+	int *neighbors = malloc((arcs ? arcs : 1) * sizeof(int));
+	float *weights = malloc((arcs ? arcs : 1) * sizeof(float));
+	if (!offsets || !neighbors || !weights) {
+		free(offsets);
+		free(neighbors);
+		free(weights);
+		return 0;
+	}
+
+	size_t p = 0;
+	for (int u = 0; u < n; u++) {
+		offsets[u] = p;
+		if (g->storage == GRAPH_DYNAMIC) {
+			// Hash order: collect the ids sorted, then look up
+			// the weights.
+			neighbor_set *set = &g->sets[u];
+			size_t begin = p;
+			for (int k = 0; k < set->capacity; k++)
+				if (set->slots[k].v >= 0)
+					neighbors[p++] = set->slots[k].v;
+			qsort(neighbors + begin, p - begin, sizeof(int),
+			      compare_ints);
+			for (size_t k = begin; k < p; k++)
+				weights[k] = set->slots[neighbor_set_find
+							(set,
+							 neighbors[k])].weight;
+			continue;
+		}
+		for (neighbor_iter it = graph_neighbors(g, u);
+		     neighbor_next(&it);) {
+			neighbors[p] = it.v;
+			weights[p++] = it.weight;
+		}
+	}
+	offsets[n] = p;
+
+	out->offsets = offsets;
+	out->neighbors = neighbors;
+	out->weights = weights;
+	return 1;
+}
+
+static int build_dense(graph *g, graph *out)
+{
+	if (!alloc_dense(out))
+		return 0;
+
+	size_t n = (size_t)g->num_nodes;
+	for (int u = 0; u < g->num_nodes; u++) {
+		for (neighbor_iter it = graph_neighbors(g, u);
+		     neighbor_next(&it);) {
+			out->edges[u * n + it.v] = 1;
+			out->edge_weights[u * n + it.v] = it.weight;
+		}
+	}
+	return 1;
+}
+
+static int build_bits(graph *g, graph *out)
+{
+	if (!alloc_bits(out))
+		return 0;
+
+	size_t n = (size_t)g->num_nodes;
+	for (int u = 0; u < g->num_nodes; u++) {
+		uint64_t *row = out->bits + (size_t)u * out->row_words;
+		for (neighbor_iter it = graph_neighbors(g, u);
+		     neighbor_next(&it);) {
+			bit_set(row, it.v);
+			if (it.weight != 1.0f && !alloc_bit_weights(out)) {
+				free(out->bits);
+				out->bits = NULL;
+				return 0;
+			}
+			if (out->edge_weights)
+				out->edge_weights[u * n + it.v] = it.weight;
+		}
+	}
+	return 1;
+}
+
+static int build_dynamic(graph *g, graph *out)
+{
+	if (!alloc_sets(out))
+		return 0;
+
+	for (int u = 0; u < g->num_nodes; u++) {
+		for (neighbor_iter it = graph_neighbors(g, u);
+		     neighbor_next(&it);) {
+			if (!neighbor_set_insert(&out->sets[u], it.v,
+						 it.weight)) {
+				free_sets(out);
+				return 0;
+			}
+		}
+	}
+	return 1;
+}
+
+// Switches the storage of g in place. Returns 0 (g unchanged) when the
+// new representation cannot be allocated.
+int graph_convert(graph *g, graph_storage storage)
+{
+	if (g->storage == storage)
+		return 1;
+
+	graph out = { 0 };
+	out.num_nodes = g->num_nodes;
+	int ok = 0;
+	switch (storage) {
+	case GRAPH_CSR:
+		ok = build_csr(g, &out);
+		break;
+	case GRAPH_DYNAMIC:
+		ok = build_dynamic(g, &out);
+		break;
+	case GRAPH_DENSE:
+		ok = build_dense(g, &out);
+		break;
+	case GRAPH_BITMATRIX:
+		ok = build_bits(g, &out);
+		break;
+	}
+	if (!ok)
+		return 0;
+
+	free(g->edges);
+	free(g->edge_weights);
+	free(g->bits);
+	free_csr(g);
+	free_sets(g);
+	g->edges = out.edges;
+	g->edge_weights = out.edge_weights;
+	g->offsets = out.offsets;
+	g->neighbors = out.neighbors;
+	g->weights = out.weights;
+	g->sets = out.sets;
+	g->bits = out.bits;
+	g->row_words = out.row_words;
+	g->storage = storage;
+	return 1;
+}
+
+graph *read_graph_with_storage(char *filename, graph_storage storage)
 {
 	FILE *file = fopen(filename, "r");
 	if (!file) {
@@ -106,7 +852,11 @@ graph *read_graph(char *filename)
 	}
 	int size, is_directed = 0;
 	fscanf(file, "%d,%d\n", &size, &is_directed);
-	graph *g = create_graph(size, is_directed);
+	graph *g = create_graph_with_storage(size, is_directed, storage);
+	if (!g) {
+		fclose(file);
+		return NULL;
+	}
 	int u, v;
 	float weight;
 	while (fscanf(file, " (%d,%d,%f) ", &u, &v, &weight) == 3) {
@@ -114,72 +864,36 @@ graph *read_graph(char *filename)
 		add_edge(g, u, v, weight);
 	}
 	fclose(file);
+	graph_compact(g);
 	return g;
 }
 
-void save_graph(graph *g, char *filename)
+graph *read_graph(char *filename)
 {
-	FILE *file = fopen(filename, "w");
-	if (file == NULL) {
-		perror("Error");
-		return;
-	}
-	fprintf(file, "%d, %d\n", g->num_nodes, g->is_directed);
-	for (int i = 0; i < g->num_nodes; i++) {
-		for (int j = 0; j < g->num_nodes; j++) {
-			if (g->edges[g->num_nodes * i + j] == 1) {
-				fprintf(file, "(%d,%d,%f)\n", i, j,
-					g->edge_weights[g->num_nodes * i +
-							j]);
-			}
-		}
-	}
-	fclose(file);
+	return read_graph_with_storage(filename, GRAPH_DENSE);
 }
 
-int *bfs_cluster(int start, int n, float *distances, float *opinions,
-		 int *visited, float dist_thresh, float op_thresh)
+int save_graph(graph *g, char *filename)
 {
-	int *cluster = malloc(n * sizeof(int));
-	int front = 0, back = 0;
-	cluster[back++] = start;
-	visited[start] = 1;
-
-	while (front < back) {
-		int u = cluster[front++];
-		for (int v = 0; v < n; v++) {
-			if (visited[v])
-				continue;
-			float d = distances[u * n + v];
-			float o_diff = fabsf(opinions[u] - opinions[v]);
-			if (d < dist_thresh && o_diff < op_thresh) {
-				visited[v] = 1;
-				cluster[back++] = v;
-			}
-		}
-	}
-
-	// Resize and return
-	cluster[back] = -1;	// sentinel
-	return cluster;
+	return save_graph_with_ids(g, filename, NULL);
 }
 
-int count_opinion_clusters(float *distances, float *opinions, int n,
-			   float dist_thresh, float op_thresh)
+int save_graph_with_ids(graph *g, const char *filename, const int *ids)
 {
-	int *visited = calloc(n, sizeof(int));
-	int num_clusters = 0;
-
-	for (int i = 0; i < n; i++) {
-		if (!visited[i]) {
-			int *cluster =
-			    bfs_cluster(i, n, distances, opinions, visited,
-					dist_thresh, op_thresh);
-			free(cluster);
-			num_clusters++;
+	FILE *file = fopen(filename, "w");
+	if (file == NULL) {
+		perror("Error");
+		return 0;
+	}
+	fprintf(file, "%d, %d\n", g->num_nodes, g->is_directed);
+	for (int i = 0; i < g->num_nodes; i++) {
+		for (neighbor_iter it = graph_neighbors(g, i);
+		     neighbor_next(&it);) {
+			fprintf(file, "(%d,%d,%f)\n", ids ? ids[i] : i,
+				ids ? ids[it.v] : it.v, it.weight);
 		}
 	}
-
-	free(visited);
-	return num_clusters;
+	// A full disk shows up in the stream's error flag or on close
+	int ok = !ferror(file);
+	return fclose(file) == 0 && ok;
 }
@@ -1,24 +1,218 @@
 #ifndef GRAPH_H
 #define GRAPH_H
 
+#include <stddef.h>
+#include <stdint.h>
+#include <math.h>
+#include "neighbor_set.h"
+
+typedef enum {
+	GRAPH_DENSE = 0,	// n x n adjacency and weight matrices
+	GRAPH_CSR,		// compressed sparse rows, O(n + m) memory
+	GRAPH_DYNAMIC,		// per-node hash sets, O(1) edge insert/delete
+	GRAPH_BITMATRIX		// n x n bits, weights only once one is not 1
+} graph_storage;
+
+typedef struct {
+	int u;
+	int v;
+	float weight;
+} graph_edge;
+
+// Shortest-path distance storage, see distance_matrix.h
+typedef struct distance_matrix distance_matrix;
+
+// Weight recorded in a change log for an arc that does not exist: an
+// insertion is a change from GRAPH_NO_ARC, a removal a change to it.
+#define GRAPH_NO_ARC INFINITY
+
+typedef struct {
+	int u;
+	int v;
+	float old_weight;	// GRAPH_NO_ARC if the arc was absent
+	float new_weight;	// GRAPH_NO_ARC if the arc was removed
+} graph_arc_change;
+
+// Arc-level changes recorded while a log is attached to a graph. An
+// undirected edge logs both of its arcs. When an allocation fails the
+// log is marked overflowed and its contents must not be trusted.
+typedef struct {
+	graph_arc_change *changes;
+	size_t count;
+	size_t capacity;
+	int overflowed;
+} graph_change_log;
+
 typedef struct {
 	int num_nodes;
 	int *edges;		// n x n adjacency matrix in row-major order
-	int is_directed;
-	float *edge_weights;	// 1 if directed graph, 0 if undirected
+	int is_directed;	// 1 if directed graph, 0 if undirected
+	float *edge_weights;	// n x n weights, dense storage only
+	graph_storage storage;
+
+	// CSR storage: the arcs of node u are neighbors[offsets[u]] ..
+	// neighbors[offsets[u + 1] - 1], sorted by neighbor id. A removed
+	// arc stays in place as ~v until the next compaction.
+	size_t *offsets;	// n + 1 entries
+	int *neighbors;
+	float *weights;
+	size_t num_dead;	// removed arcs still stored in the rows
+
+	// Arcs added to a CSR graph since the last compaction. They are
+	// merged into the rows by the first query that needs them.
+	graph_edge *pending;
+	size_t num_pending;
+	size_t pending_capacity;
+
+	// Dynamic storage: one hash set of out-neighbors per node
+	neighbor_set *sets;
+
+	// Bit matrix storage: row u is bits[u * row_words ..], see
+	// bit_matrix.h. Its weights live in edge_weights, which stays NULL
+	// while every arc has weight 1.
+	uint64_t *bits;
+	size_t row_words;
+
+	// Set when offsets/neighbors/weights point into a private file
+	// mapping (read_graph_binary) instead of malloc'd arrays. Updates
+	// are copy-on-write and never reach the file.
+	void *mapping;
+	size_t mapping_size;
+
+	// Optional, not owned: every insert, removal and weight update made
+	// through the functions below is appended here while it is set.
+	graph_change_log *change_log;
 } graph;
 
+// Iterates the out-neighbors of one node, in increasing id order for
+// dense, bit matrix and CSR storage and in hash order for dynamic storage:
+//
+//	for (neighbor_iter it = graph_neighbors(g, u); neighbor_next(&it);)
+//		use(it.v, it.weight);
+//
+// Adding edges while iterating is not supported; the updates below are.
+typedef struct {
+	graph *g;
+	int u;
+	size_t pos;
+	size_t end;
+	int v;			// current neighbor
+	float weight;		// weight of the arc (u, v)
+	uint64_t word;		// bit matrix: bits of the word left to visit
+} neighbor_iter;
+
 graph *create_graph(int n, int is_directed);
+graph *create_graph_with_storage(int n, int is_directed,
+				 graph_storage storage);
 void free_graph(graph * g);
 void add_edge(graph * g, int u, int v, float weight);
+void remove_edge(graph * g, int u, int v);
 int is_connected(graph * g, int u, int v);
 float get_weight(graph * g, int u, int v);
-void save_graph(graph * g, char *filename);
+void set_weight(graph * g, int u, int v, float weight);
+int get_degree(graph * g, int u);
+size_t graph_num_arcs(graph * g);
+void graph_compact(graph * g);
+int graph_convert(graph * g, graph_storage storage);
+// Text format: returns 0 on I/O failure
+int save_graph(graph * g, char *filename);
+// Same with node u written as ids[u]; ids may be NULL
+int save_graph_with_ids(graph * g, const char *filename, const int *ids);
+// Binary format, see graph_io.c: returns 0 on I/O or allocation failure
+int save_graph_binary(graph * g, const char *filename);
+// Maps a binary graph file as CSR storage without parsing or copying.
+// verify also checks the checksum and the structure of the arrays.
+// NULL if the file is missing, truncated, or from another version.
+graph *read_graph_binary(const char *filename, int verify);
+// Reads either format, picked by the file's magic bytes, into storage
+graph *load_graph(const char *filename, graph_storage storage);
+// Parallel importers for large real-world files, see graph_import.c.
+// Both return CSR storage, or NULL on a malformed line or I/O failure.
+// SNAP edge lists hold "u v [weight]" lines with '#' comments; the ids
+// are relabelled to 0 .. n - 1 in increasing order and, when
+// original_ids is not NULL, the n raw ids are returned there.
+graph *import_edge_list(const char *filename, int is_directed,
+			long long **original_ids);
+// Matrix Market coordinate files: 1-based indices, "pattern" entries get
+// weight 1 and "symmetric" files give an undirected graph. NULL for
+// skew-symmetric, hermitian and complex matrices, and when the number of
+// entries read differs from the count in the size line.
+graph *import_matrix_market(const char *filename);
+// Builds CSR storage from edges (src[e], dst[e]) in parallel, mirrored if
+// undirected. weight may be NULL for weight 1. Duplicates keep the last
+// weight, as repeated add_edge calls would. NULL if out of memory.
+graph *create_graph_from_edges(int n, int is_directed, const int *src,
+			       const int *dst, const float *weight,
+			       size_t num_edges);
+// n x n shortest path distances, see shortest_paths.h
 float *compute_all_pairs_distances(graph * g);
 graph *read_graph(char *filename);
-int *bfs_cluster(int start, int n, float *distances, float *opinions,
-		 int *visited, float dist_thresh, float op_thresh);
-int count_opinion_clusters(float *distances, float *opinions, int n,
-			   float dist_thresh, float op_thresh);
+graph *read_graph_with_storage(char *filename, graph_storage storage);
+
+void graph_change_log_clear(graph_change_log * log);
+void graph_change_log_free(graph_change_log * log);
+
+neighbor_iter graph_neighbors(graph * g, int u);
+
+// Arc-level updates of the arc the iterator currently points at. Unlike
+// remove_edge they never touch the reverse arc of an undirected graph.
+void neighbor_set_weight(neighbor_iter * it, float weight);
+void neighbor_remove(neighbor_iter * it);
+
+static inline int neighbor_next(neighbor_iter * it)
+{
+	graph *g = it->g;
+
+	if (g->storage == GRAPH_DYNAMIC) {
+		const neighbor_slot *slots = g->sets[it->u].slots;
+		while (it->pos < it->end) {
+			size_t p = it->pos++;
+			if (slots[p].v < 0)
+				continue;
+			it->v = slots[p].v;
+			it->weight = slots[p].weight;
+			return 1;
+		}
+		return 0;
+	}
+
+	if (g->storage == GRAPH_CSR) {
+		while (it->pos < it->end) {
+			size_t p = it->pos++;
+			if (g->neighbors[p] < 0)
+				continue;
+			it->v = g->neighbors[p];
+			it->weight = g->weights[p];
+			return 1;
+		}
+		return 0;
+	}
+
+	if (g->storage == GRAPH_BITMATRIX) {
+		const uint64_t *row = g->bits + (size_t)it->u * g->row_words;
+		while (!it->word) {
+			if (it->pos >= it->end)
+				return 0;
+			it->word = row[it->pos++];
+		}
+		it->v = (int)((it->pos - 1) * 64) + __builtin_ctzll(it->word);
+		it->word &= it->word - 1;
+		it->weight = g->edge_weights
+		    ? g->edge_weights[(size_t)it->u * g->num_nodes + it->v]
+		    : 1.0f;
+		return 1;
+	}
+
+	size_t row = (size_t)it->u * (size_t)g->num_nodes;
+	while (it->pos < it->end) {
+		size_t p = it->pos++;
+		if (!g->edges[row + p])
+			continue;
+		it->v = (int)p;
+		it->weight = g->edge_weights[row + p];
+		return 1;
+	}
+	return 0;
+}
 
 #endif				// GRAPH_H
@@ -0,0 +1,885 @@
+#include "graph.h"
+#include "../11-helpers/thread_pool.h"
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Parallel importer for SNAP edge lists and Matrix Market files. The file
+// is mapped and cut into chunks of whole lines that the pool parses
+// independently. The edges are then relabelled and turned into sorted
+// CSR rows with a parallel radix partition. The result does not depend on
+// the number of threads: duplicate arcs keep the weight of their last
+// occurrence in the file, as repeated add_edge calls would.
+
+#define CHUNK_BYTES ((size_t)8 << 20)
+#define EDGES_PER_TASK 65536
+#define ROWS_PER_TASK 1024
+#define MAX_ID ((long long)1 << 62)
+
+typedef struct {
+	const char *begin;	// whole lines
+	const char *end;
+	long long *src;
+	long long *dst;
+	float *weight;
+	size_t count;
+	size_t capacity;
+	size_t first;		// index of the chunk's first edge overall
+	long long max_id;
+	int failed;		// malformed line or out of memory
+} chunk;
+
+static int is_blank(char c)
+{
+	return c == ' ' || c == '\t' || c == ',' || c == '\r';
+}
+
+static const char *skip_blanks(const char *p, const char *end)
+{
+	while (p < end && is_blank(*p))
+		p++;
+	return p;
+}
+
+static int parse_id(const char **pp, const char *end, long long *out)
+{
+	const char *p = *pp;
+	long long x = 0;
+	if (p == end || *p < '0' || *p > '9')
+		return 0;
+	while (p < end && *p >= '0' && *p <= '9') {
+		x = 10 * x + (*p++ - '0');
+		if (x > MAX_ID)
+			return 0;
+	}
+	*pp = p;
+	*out = x;
+	return 1;
+}
+
+static const double exact_powers_of_ten[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Plain decimals with up to 19 significant digits and |exponent| <= 22
+// are converted exactly in double; anything else goes through strtof.
+static int parse_float(const char **pp, const char *end, float *out)
+{
+	const char *p = *pp, *start = *pp;
+	int negative = 0, digits = 0, exponent = 0;
+	uint64_t mantissa = 0;
+
+	if (p < end && (*p == '-' || *p == '+'))
+		negative = *p++ == '-';
+	for (; p < end && *p >= '0' && *p <= '9'; p++, digits++)
+		mantissa = 10 * mantissa + (uint64_t)(*p - '0');
+	if (p < end && *p == '.') {
+		for (p++; p < end && *p >= '0' && *p <= '9'; p++, digits++) {
+			mantissa = 10 * mantissa + (uint64_t)(*p - '0');
+			exponent--;
+		}
+	}
+	if (digits > 0 && p < end && (*p == 'e' || *p == 'E')) {
+		const char *q = p + 1;
+		int sign = 1, e = 0, e_digits = 0;
+		if (q < end && (*q == '-' || *q == '+'))
+			sign = *q++ == '-' ? -1 : 1;
+		for (; q < end && *q >= '0' && *q <= '9' && e < 10000; q++)
+			e = 10 * e + (*q - '0'), e_digits++;
+		if (e_digits) {
+			exponent += sign * e;
+			p = q;
+		}
+	}
+
+	if (digits > 0 && digits <= 19 && (p == end || is_blank(*p)
+					   || *p == '\n')
+	    && mantissa < ((uint64_t)1 << 53)
+	    && exponent >= -22 && exponent <= 22) {
+		double x = (double)mantissa;
+		x = exponent < 0 ? x / exact_powers_of_ten[-exponent]
+		    : x * exact_powers_of_ten[exponent];
+		*out = (float)(negative ? -x : x);
+		*pp = p;
+		return 1;
+	}
+
+	// Slow path: NUL-terminated copy of the token for strtof
+	char token[64];
+	size_t len = 0;
+	for (p = start; p < end && !is_blank(*p) && *p != '\n'; p++)
+		if (len + 1 < sizeof(token))
+			token[len++] = *p;
+	token[len] = '\0';
+	char *stop;
+	*out = strtof(token, &stop);
+	if (len == 0 || *stop != '\0')
+		return 0;
+	*pp = p;
+	return 1;
+}
+
+static int push_edge(chunk *c, long long u, long long v, float w)
+{
+	if (c->count == c->capacity) {
+		size_t cap = c->capacity ? 2 * c->capacity : 4096;
+		long long *src = realloc(c->src, cap * sizeof(long long));
+		if (!src)
+			return 0;
+		c->src = src;
+		long long *dst = realloc(c->dst, cap * sizeof(long long));
+		if (!dst)
+			return 0;
+		c->dst = dst;
+		float *weight = realloc(c->weight, cap * sizeof(float));
+		if (!weight)
+			return 0;
+		c->weight = weight;
+		c->capacity = cap;
+	}
+	c->src[c->count] = u;
+	c->dst[c->count] = v;
+	c->weight[c->count++] = w;
+	if (u > c->max_id)
+		c->max_id = u;
+	if (v > c->max_id)
+		c->max_id = v;
+	return 1;
+}
+
+// "u v [w ...]" per line; blank lines and lines starting with '#' or
+// '%' are skipped, columns after the weight are ignored.
+static void parse_chunk(void *ctx, size_t begin, size_t end, int worker)
+{
+	(void)worker;
+	chunk *chunks = ctx;
+	for (size_t k = begin; k < end; k++) {
+		chunk *c = &chunks[k];
+		const char *p = c->begin;
+		c->max_id = -1;
+		while (p < c->end && !c->failed) {
+			const char *eol = memchr(p, '\n', (size_t)(c->end - p));
+			if (!eol)
+				eol = c->end;
+			p = skip_blanks(p, eol);
+			if (p < eol && *p != '#' && *p != '%') {
+				long long u, v;
+				float w = 1.0f;
+				int ok = parse_id(&p, eol, &u);
+				ok = ok && p < eol && is_blank(*p);
+				p = skip_blanks(p, eol);
+				ok = ok && parse_id(&p, eol, &v);
+				p = skip_blanks(p, eol);
+				if (ok && p < eol)
+					ok = parse_float(&p, eol, &w);
+				if (!ok || !push_edge(c, u, v, w))
+					c->failed = 1;
+			}
+			p = eol + 1;
+		}
+	}
+}
+
+typedef struct {
+	const char *data;	// whole mapping
+	size_t size;
+	chunk *chunks;
+	size_t num_chunks;
+	size_t num_edges;
+} parsed_file;
+
+static void free_parsed(parsed_file *pf)
+{
+	for (size_t k = 0; pf->chunks && k < pf->num_chunks; k++) {
+		free(pf->chunks[k].src);
+		free(pf->chunks[k].dst);
+		free(pf->chunks[k].weight);
+	}
+	free(pf->chunks);
+	if (pf->data)
+		munmap((void *)pf->data, pf->size);
+	memset(pf, 0, sizeof(*pf));
+}
+
+static int map_file(const char *filename, parsed_file *pf)
+{
+	memset(pf, 0, sizeof(*pf));
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0) {
+		perror("Failed to open file");
+		return 0;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		close(fd);
+		return 0;
+	}
+	pf->size = (size_t)st.st_size;
+	void *data = mmap(NULL, pf->size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+		return 0;
+	madvise(data, pf->size, MADV_SEQUENTIAL);
+	pf->data = data;
+	return 1;
+}
+
+// Cuts [body, end of file) into chunks of whole lines and parses them.
+static int parse_body(parsed_file *pf, const char *body)
+{
+	const char *end = pf->data + pf->size;
+	size_t bytes = (size_t)(end - body);
+	size_t want = bytes / CHUNK_BYTES + 1;
+	size_t min_chunks = 4 * (size_t)thread_pool_size();
+	if (want < min_chunks && bytes > min_chunks * 4096)
+		want = min_chunks;
+
+	pf->chunks = calloc(want, sizeof(chunk));
+	if (!pf->chunks)
+		return 0;
+	const char *p = body;
+	for (size_t k = 0; k < want && p < end; k++) {
+		const char *stop = k + 1 == want ? end
+		    : body + (bytes / want) * (k + 1);
+		if (stop < p)
+			stop = p;
+		const char *eol = memchr(stop, '\n', (size_t)(end - stop));
+		stop = eol ? eol + 1 : end;
+		pf->chunks[pf->num_chunks].begin = p;
+		pf->chunks[pf->num_chunks++].end = stop;
+		p = stop;
+	}
+
+	parallel_for(pf->num_chunks, 1, parse_chunk, pf->chunks);
+	for (size_t k = 0; k < pf->num_chunks; k++) {
+		if (pf->chunks[k].failed)
+			return 0;
+		pf->chunks[k].first = pf->num_edges;
+		pf->num_edges += pf->chunks[k].count;
+	}
+	return 1;
+}
+
+typedef struct {
+	const parsed_file *pf;
+	const int *rank;	// raw id -> node, NULL for an offset-only map
+	const long long *sorted_ids;	// or binary search in these
+	size_t num_ids;
+	long long id_offset;	// subtracted when rank and sorted_ids are NULL
+	int *src;
+	int *dst;
+	float *weight;
+} relabel_job;
+
+static int lookup(const relabel_job *job, long long id)
+{
+	if (job->rank)
+		return job->rank[id];
+	if (!job->sorted_ids)
+		return (int)(id - job->id_offset);
+	size_t lo = 0, hi = job->num_ids;
+	while (hi - lo > 1) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (job->sorted_ids[mid] <= id)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	return (int)lo;
+}
+
+static void relabel_chunk(void *ctx, size_t begin, size_t end, int worker)
+{
+	(void)worker;
+	relabel_job *job = ctx;
+	for (size_t k = begin; k < end; k++) {
+		const chunk *c = &job->pf->chunks[k];
+		for (size_t e = 0; e < c->count; e++) {
+			job->src[c->first + e] = lookup(job, c->src[e]);
+			job->dst[c->first + e] = lookup(job, c->dst[e]);
+			job->weight[c->first + e] = c->weight[e];
+		}
+	}
+}
+
+typedef struct {
+	const parsed_file *pf;
+	_Atomic unsigned char *seen;
+} mark_job;
+
+static void mark_chunk(void *ctx, size_t begin, size_t end, int worker)
+{
+	(void)worker;
+	mark_job *job = ctx;
+	for (size_t k = begin; k < end; k++) {
+		const chunk *c = &job->pf->chunks[k];
+		for (size_t e = 0; e < c->count; e++) {
+			atomic_store_explicit(&job->seen[c->src[e]], 1,
+					      memory_order_relaxed);
+			atomic_store_explicit(&job->seen[c->dst[e]], 1,
+					      memory_order_relaxed);
+		}
+	}
+}
+
+static int compare_ids(const void *a, const void *b)
+{
+	long long x = *(const long long *)a;
+	long long y = *(const long long *)b;
+	return (x > y) - (x < y);
+}
+
+// Maps the raw ids that occur in the file onto 0 .. n - 1 in increasing
+// order. Dense id ranges use a lookup table, sparse ones a sorted array.
+static int relabel_compact(parsed_file *pf, relabel_job *job, int *n,
+			   long long **original_ids)
+{
+	long long max_id = -1;
+	for (size_t k = 0; k < pf->num_chunks; k++)
+		if (pf->chunks[k].max_id > max_id)
+			max_id = pf->chunks[k].max_id;
+
+	int *rank = NULL;
+	long long *ids = NULL;
+	size_t num_ids = 0;
+	size_t endpoints = 2 * pf->num_edges;
+	if (max_id < INT32_MAX && (size_t)max_id <= 4 * endpoints + 1024) {
+		size_t range = (size_t)max_id + 1;
+		_Atomic unsigned char *seen = calloc(range, 1);
+		rank = malloc(range * sizeof(int));
+		if (!seen || !rank) {
+			free((void *)seen);
+			free(rank);
+			return 0;
+		}
+		mark_job mj = { pf, seen };
+		parallel_for(pf->num_chunks, 1, mark_chunk, &mj);
+		for (size_t id = 0; id < range; id++) {
+			rank[id] = (int)num_ids;
+			if (atomic_load_explicit(&seen[id],
+						 memory_order_relaxed))
+				num_ids++;
+		}
+		if (original_ids) {
+			ids = malloc((num_ids ? num_ids : 1) *
+				     sizeof(long long));
+			if (!ids) {
+				free((void *)seen);
+				free(rank);
+				return 0;
+			}
+			for (size_t id = 0, r = 0; id < range; id++)
+				if (atomic_load_explicit(&seen[id],
+							 memory_order_relaxed))
+					ids[r++] = (long long)id;
+		}
+		free((void *)seen);
+	} else {
+		ids = malloc((endpoints ? endpoints : 1) * sizeof(long long));
+		if (!ids)
+			return 0;
+		for (size_t k = 0; k < pf->num_chunks; k++) {
+			const chunk *c = &pf->chunks[k];
+			if (c->count == 0)
+				continue;
+			memcpy(ids + 2 * c->first, c->src,
+			       c->count * sizeof(long long));
+			memcpy(ids + 2 * c->first + c->count, c->dst,
+			       c->count * sizeof(long long));
+		}
+		qsort(ids, endpoints, sizeof(long long), compare_ids);
+		for (size_t p = 0; p < endpoints; p++)
+			if (num_ids == 0 || ids[p] != ids[num_ids - 1])
+				ids[num_ids++] = ids[p];
+		if (num_ids > INT32_MAX) {
+			free(ids);
+			return 0;
+		}
+	}
+
+	job->rank = rank;
+	job->sorted_ids = rank ? NULL : ids;
+	job->num_ids = num_ids;
+	parallel_for(pf->num_chunks, 1, relabel_chunk, job);
+	free(rank);
+	*n = (int)num_ids;
+	if (original_ids)
+		*original_ids = ids;
+	else
+		free(ids);
+	return 1;
+}
+
+// The CSR rows are built by a two-pass radix partition instead of one
+// scatter over the whole arc array, which would miss the cache on
+// nearly every write. Pass one splits the arcs into buckets of 2^shift
+// consecutive source nodes; pass two sorts each bucket, whose rows and
+// counters fit in cache, by source and then by neighbor. Both passes are
+// stable, so the arcs of a row stay in file order until the final sort.
+
+#define MAX_BUCKETS 4096
+#define MAX_TASKS 64
+
+typedef struct {
+	int u;
+	int v;
+	float weight;
+} arc_record;
+
+struct arc_key {
+	int v;
+	float weight;
+	size_t pos;		// position in the row, i.e. in the file
+};
+
+typedef struct {
+	size_t *cursor;		// 2^shift + 1 entries
+	struct arc_key *row;
+	size_t row_capacity;
+} bucket_scratch;
+
+typedef struct {
+	const int *src;
+	const int *dst;
+	const float *weight;
+	size_t num_edges;
+	int num_nodes;
+	int is_directed;
+	size_t num_tasks;
+	int shift;
+	size_t num_buckets;
+	size_t *cursor;		// num_tasks x num_buckets: counts, then
+				// write positions
+	size_t *bucket_start;	// num_buckets + 1 entries
+	arc_record *arcs;	// grouped by bucket, file order inside
+	size_t *offsets;
+	int *neighbors;
+	float *weights;
+	size_t *row_length;	// after removing duplicate arcs
+	bucket_scratch *scratch;	// one per worker
+	atomic_int failed;
+} csr_job;
+
+static int mirrored(const csr_job *job, size_t e)
+{
+	return !job->is_directed && job->src[e] != job->dst[e];
+}
+
+static size_t task_begin(const csr_job *job, size_t t)
+{
+	return job->num_edges / job->num_tasks * t
+	    + (t < job->num_edges % job->num_tasks
+	       ? t : job->num_edges % job->num_tasks);
+}
+
+static void count_task(void *ctx, size_t begin, size_t end, int worker)
+{
+	(void)worker;
+	csr_job *job = ctx;
+	for (size_t t = begin; t < end; t++) {
+		size_t *count = job->cursor + t * job->num_buckets;
+		for (size_t e = task_begin(job, t); e < task_begin(job, t + 1);
+		     e++) {
+			count[job->src[e] >> job->shift]++;
+			if (mirrored(job, e))
+				count[job->dst[e] >> job->shift]++;
+		}
+	}
+}
+
+static void partition_task(void *ctx, size_t begin, size_t end, int worker)
+{
+	(void)worker;
+	csr_job *job = ctx;
+	for (size_t t = begin; t < end; t++) {
+		size_t *cursor = job->cursor + t * job->num_buckets;
+		for (size_t e = task_begin(job, t); e < task_begin(job, t + 1);
+		     e++) {
+			int u = job->src[e], v = job->dst[e];
+			float w = job->weight ? job->weight[e] : 1.0f;
+			job->arcs[cursor[u >> job->shift]++] =
+			    (arc_record) { u, v, w };
+			if (mirrored(job, e))
+				job->arcs[cursor[v >> job->shift]++] =
+				    (arc_record) { v, u, w };
+		}
+	}
+}
+
+static int arc_key_less(const struct arc_key *x, const struct arc_key *y)
+{
+	return x->v < y->v || (x->v == y->v && x->pos < y->pos);
+}
+
+static int compare_arc_keys(const void *a, const void *b)
+{
+	return arc_key_less(b, a) - arc_key_less(a, b);
+}
+
+// Sorts one row by (neighbor, position) and keeps the last arc of each
+// run at the front of the row. Returns the number of arcs kept.
+static size_t sort_row(int *neighbors, float *weights, size_t len,
+		       struct arc_key *row)
+{
+	size_t k = 1;
+	while (k < len && neighbors[k - 1] < neighbors[k])
+		k++;
+	if (k >= len)
+		return len;
+
+	for (k = 0; k < len; k++)
+		row[k] = (struct arc_key) { neighbors[k], weights[k], k };
+	if (len <= 32) {
+		for (k = 1; k < len; k++) {
+			struct arc_key key = row[k];
+			size_t j = k;
+			for (; j > 0 && arc_key_less(&key, &row[j - 1]); j--)
+				row[j] = row[j - 1];
+			row[j] = key;
+		}
+	} else {
+		qsort(row, len, sizeof(struct arc_key), compare_arc_keys);
+	}
+	size_t out = 0;
+	for (k = 0; k < len; k++) {
+		if (k + 1 < len && row[k + 1].v == row[k].v)
+			continue;
+		neighbors[out] = row[k].v;
+		weights[out++] = row[k].weight;
+	}
+	return out;
+}
+
+static void bucket_task(void *ctx, size_t begin, size_t end, int worker)
+{
+	csr_job *job = ctx;
+	bucket_scratch *s = &job->scratch[worker];
+	for (size_t b = begin; b < end; b++) {
+		size_t first = b << job->shift;
+		size_t last = (b + 1) << job->shift;
+		if (last > (size_t)job->num_nodes)
+			last = (size_t)job->num_nodes;
+		size_t span = last - first;
+		const arc_record *arcs = job->arcs + job->bucket_start[b];
+		size_t count = job->bucket_start[b + 1] - job->bucket_start[b];
+
+		memset(s->cursor, 0, (span + 1) * sizeof(size_t));
+		for (size_t a = 0; a < count; a++)
+			s->cursor[arcs[a].u - first + 1]++;
+		size_t max_row = 0;
+		for (size_t i = 0; i < span; i++) {
+			if (s->cursor[i + 1] > max_row)
+				max_row = s->cursor[i + 1];
+			s->cursor[i + 1] += s->cursor[i];
+			job->offsets[first + i] =
+			    job->bucket_start[b] + s->cursor[i];
+		}
+		for (size_t a = 0; a < count; a++) {
+			size_t p = job->bucket_start[b]
+			    + s->cursor[arcs[a].u - first]++;
+			job->neighbors[p] = arcs[a].v;
+			job->weights[p] = arcs[a].weight;
+		}
+
+		if (max_row > s->row_capacity) {
+			free(s->row);
+			s->row = malloc(max_row * sizeof(struct arc_key));
+			s->row_capacity = s->row ? max_row : 0;
+			if (!s->row) {
+				atomic_store(&job->failed, 1);
+				return;
+			}
+		}
+		for (size_t u = first; u < last; u++) {
+			size_t p = job->offsets[u];
+			size_t len = (u + 1 < last ? job->offsets[u + 1]
+				      : job->bucket_start[b + 1]) - p;
+			job->row_length[u] = sort_row(job->neighbors + p,
+						      job->weights + p, len,
+						      s->row);
+		}
+	}
+}
+
+typedef struct {
+	const size_t *old_offsets;
+	const size_t *new_offsets;
+	const int *old_neighbors;
+	const float *old_weights;
+	int *neighbors;
+	float *weights;
+} pack_job;
+
+static void pack_rows_chunk(void *ctx, size_t begin, size_t end, int worker)
+{
+	(void)worker;
+	pack_job *job = ctx;
+	for (size_t u = begin; u < end; u++) {
+		size_t len = job->new_offsets[u + 1] - job->new_offsets[u];
+		memcpy(job->neighbors + job->new_offsets[u],
+		       job->old_neighbors + job->old_offsets[u],
+		       len * sizeof(int));
+		memcpy(job->weights + job->new_offsets[u],
+		       job->old_weights + job->old_offsets[u],
+		       len * sizeof(float));
+	}
+}
+
+// Duplicate arcs left gaps at the row ends: moves the rows together.
+// Returns 0 if the packed arrays cannot be allocated.
+static int pack_rows(csr_job *job)
+{
+	size_t n = (size_t)job->num_nodes, kept = 0;
+	for (size_t u = 0; u < n; u++) {
+		size_t len = job->row_length[u];
+		job->row_length[u] = kept;
+		kept += len;
+	}
+	job->row_length[n] = kept;
+	if (kept == job->offsets[n])
+		return 1;
+
+	int *neighbors = malloc((kept ? kept : 1) * sizeof(int));
+	float *weights = malloc((kept ? kept : 1) * sizeof(float));
+	if (!neighbors || !weights) {
+		free(neighbors);
+		free(weights);
+		return 0;
+	}
+	pack_job pj = { job->offsets, job->row_length, job->neighbors,
+		job->weights, neighbors, weights
+	};
+	parallel_for(n, ROWS_PER_TASK, pack_rows_chunk, &pj);
+	free(job->neighbors);
+	free(job->weights);
+	job->neighbors = neighbors;
+	job->weights = weights;
+	memcpy(job->offsets, job->row_length, (n + 1) * sizeof(size_t));
+	return 1;
+}
+
+graph *create_graph_from_edges(int n, int is_directed, const int *src,
+			      const int *dst, const float *weight,
+			      size_t num_edges)
+{
+	graph *g = create_graph_with_storage(n, is_directed, GRAPH_CSR);
+	if (!g)
+		return NULL;
+
+	csr_job job = { 0 };
+	job.src = src;
+	job.dst = dst;
+	job.weight = weight;
+	job.num_edges = num_edges;
+	job.num_nodes = n;
+	job.is_directed = is_directed;
+	job.num_tasks = num_edges / EDGES_PER_TASK + 1;
+	if (job.num_tasks > MAX_TASKS)
+		job.num_tasks = MAX_TASKS;
+	while (((size_t)n >> job.shift) >= MAX_BUCKETS)
+		job.shift++;
+	job.num_buckets = ((size_t)n >> job.shift) + 1;
+
+	int workers = thread_pool_size();
+	job.cursor = calloc(job.num_tasks * job.num_buckets, sizeof(size_t));
+	job.bucket_start = malloc((job.num_buckets + 1) * sizeof(size_t));
+	job.offsets = malloc(((size_t)n + 1) * sizeof(size_t));
+	job.row_length = malloc(((size_t)n + 1) * sizeof(size_t));
+	job.scratch = calloc((size_t)workers, sizeof(bucket_scratch));
+	int ok = job.cursor && job.bucket_start && job.offsets
+	    && job.row_length && job.scratch;
+	for (int w = 0; ok && w < workers; w++) {
+		job.scratch[w].cursor = malloc((((size_t)1 << job.shift) + 1)
+					       * sizeof(size_t));
+		ok = job.scratch[w].cursor != NULL;
+	}
+
+	size_t arcs = 0;
+	if (ok) {
+		parallel_for(job.num_tasks, 1, count_task, &job);
+		for (size_t b = 0; b < job.num_buckets; b++) {
+			job.bucket_start[b] = arcs;
+			for (size_t t = 0; t < job.num_tasks; t++) {
+				size_t *c = &job.cursor[t * job.num_buckets + b];
+				size_t count = *c;
+				*c = arcs;
+				arcs += count;
+			}
+		}
+		job.bucket_start[job.num_buckets] = arcs;
+		job.arcs = malloc((arcs ? arcs : 1) * sizeof(arc_record));
+		job.neighbors = malloc((arcs ? arcs : 1) * sizeof(int));
+		job.weights = malloc((arcs ? arcs : 1) * sizeof(float));
+		ok = job.arcs && job.neighbors && job.weights;
+	}
+	if (ok) {
+		parallel_for(job.num_tasks, 1, partition_task, &job);
+		parallel_for(job.num_buckets, 1, bucket_task, &job);
+		job.offsets[n] = arcs;
+		ok = !atomic_load(&job.failed) && pack_rows(&job);
+	}
+
+	for (int w = 0; job.scratch && w < workers; w++) {
+		free(job.scratch[w].cursor);
+		free(job.scratch[w].row);
+	}
+	free(job.scratch);
+	free(job.arcs);
+	free(job.cursor);
+	free(job.bucket_start);
+	free(job.row_length);
+	if (!ok) {
+		free(job.offsets);
+		free(job.neighbors);
+		free(job.weights);
+		free_graph(g);
+		return NULL;
+	}
+	free(g->offsets);
+	g->offsets = job.offsets;
+	g->neighbors = job.neighbors;
+	g->weights = job.weights;
+	return g;
+}
+
+// Relabels the parsed edges with job, releases the parsed file and
+// builds the graph.
+static graph *finish_import(parsed_file *pf, relabel_job *job, int n,
+			    int is_directed)
+{
+	size_t num_edges = pf->num_edges;
+	free_parsed(pf);
+	graph *g = NULL;
+	if (job->src && job->dst && job->weight)
+		g = create_graph_from_edges(n, is_directed, job->src,
+					    job->dst, job->weight, num_edges);
+	free(job->src);
+	free(job->dst);
+	free(job->weight);
+	return g;
+}
+
+static void alloc_edges(relabel_job *job, size_t num_edges)
+{
+	size_t len = num_edges ? num_edges : 1;
+	job->src = malloc(len * sizeof(int));
+	job->dst = malloc(len * sizeof(int));
+	job->weight = malloc(len * sizeof(float));
+}
+
+graph *import_edge_list(const char *filename, int is_directed,
+			long long **original_ids)
+{
+	parsed_file pf;
+	if (!map_file(filename, &pf))
+		return NULL;
+	if (!parse_body(&pf, pf.data)) {
+		free_parsed(&pf);
+		return NULL;
+	}
+
+	relabel_job job = { &pf, NULL, NULL, 0, 0, NULL, NULL, NULL };
+	alloc_edges(&job, pf.num_edges);
+	int n = 0;
+	if (!job.src || !job.dst || !job.weight
+	    || !relabel_compact(&pf, &job, &n, original_ids)) {
+		free(job.src);
+		job.src = NULL;
+	}
+	graph *g = finish_import(&pf, &job, n, is_directed);
+	if (!g && original_ids && *original_ids) {
+		free(*original_ids);
+		*original_ids = NULL;
+	}
+	return g;
+}
+
+// Reads one whitespace-separated word of the banner, lowercased
+static const char *banner_word(const char *p, const char *eol, char *word,
+			       size_t size)
+{
+	size_t len = 0;
+	p = skip_blanks(p, eol);
+	for (; p < eol && !is_blank(*p); p++)
+		if (len + 1 < size)
+			word[len++] = (char)(*p >= 'A' && *p <= 'Z'
+					     ? *p - 'A' + 'a' : *p);
+	word[len] = '\0';
+	return p;
+}
+
+graph *import_matrix_market(const char *filename)
+{
+	parsed_file pf;
+	if (!map_file(filename, &pf))
+		return NULL;
+	const char *p = pf.data, *end = pf.data + pf.size;
+
+	// %%MatrixMarket matrix coordinate <field> <symmetry>
+	char words[5][32];
+	const char *eol = memchr(p, '\n', (size_t)(end - p));
+	if (!eol)
+		eol = end;
+	for (int k = 0; k < 5; k++)
+		p = banner_word(p, eol, words[k], sizeof(words[k]));
+	// An undirected graph has one weight per edge: skew-symmetric
+	// (A_ji = -A_ij) and hermitian matrices have no such graph
+	int symmetric = strcmp(words[4], "general") != 0;
+	if (strcmp(words[0], "%%matrixmarket") || strcmp(words[1], "matrix")
+	    || strcmp(words[2], "coordinate")
+	    || !strcmp(words[3], "complex")
+	    || (symmetric && strcmp(words[4], "symmetric"))) {
+		free_parsed(&pf);
+		return NULL;
+	}
+
+	// Comments, then "rows cols entries"
+	long long rows = 0, cols = 0, entries = 0;
+	int have_size = 0;
+	for (p = eol + 1; p < end && !have_size; p = eol + 1) {
+		eol = memchr(p, '\n', (size_t)(end - p));
+		if (!eol)
+			eol = end;
+		const char *q = skip_blanks(p, eol);
+		if (q == eol || *q == '%')
+			continue;
+		have_size = parse_id(&q, eol, &rows);
+		q = skip_blanks(q, eol);
+		have_size = have_size && parse_id(&q, eol, &cols);
+		q = skip_blanks(q, eol);
+		have_size = have_size && parse_id(&q, eol, &entries);
+	}
+	long long n = rows > cols ? rows : cols;
+	if (!have_size || n > INT32_MAX
+	    || (p < end && !parse_body(&pf, p))
+	    || pf.num_edges != (size_t)entries) {
+		// A count that disagrees with the entries read means the file
+		// was truncated or corrupted
+		free_parsed(&pf);
+		return NULL;
+	}
+
+	// Indices are 1-based and must lie inside the declared size
+	for (size_t k = 0; k < pf.num_chunks; k++) {
+		const chunk *c = &pf.chunks[k];
+		for (size_t e = 0; e < c->count; e++)
+			if (c->src[e] < 1 || c->src[e] > rows
+			    || c->dst[e] < 1 || c->dst[e] > cols) {
+				free_parsed(&pf);
+				return NULL;
+			}
+	}
+
+	relabel_job job = { &pf, NULL, NULL, 0, 1, NULL, NULL, NULL };
+	alloc_edges(&job, pf.num_edges);
+	if (job.src && job.dst && job.weight)
+		parallel_for(pf.num_chunks, 1, relabel_chunk, &job);
+	return finish_import(&pf, &job, (int)n, !symmetric);
+}
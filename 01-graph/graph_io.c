@@ -0,0 +1,322 @@
+#include "graph.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Binary graph file, version 1, native byte order:
+//
+//	graph_file_header
+//	offsets		uint64[n + 1]	CSR row starts, as in graph.h
+//	neighbors	int32[m]	sorted within each row
+//	weights		float32[m]
+//
+// Every array starts at a multiple of GRAPH_FILE_ALIGN bytes, so a
+// mapping of the file can be used as the CSR arrays directly. The
+// checksum covers the three arrays.
+
+#define GRAPH_FILE_MAGIC "MODGRPH"
+#define GRAPH_FILE_VERSION 1
+#define GRAPH_FILE_BYTE_ORDER 0x01020304u
+#define GRAPH_FILE_ALIGN 64
+
+typedef struct {
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;	// GRAPH_FILE_BYTE_ORDER as the writer saw it
+	uint64_t num_nodes;
+	uint64_t num_arcs;
+	uint32_t is_directed;
+	uint32_t reserved;
+	uint64_t checksum;
+	uint64_t offsets_at;	// file positions of the arrays
+	uint64_t neighbors_at;
+	uint64_t weights_at;
+} graph_file_header;
+
+static uint64_t align_up(uint64_t x)
+{
+	return (x + GRAPH_FILE_ALIGN - 1) & ~(uint64_t) (GRAPH_FILE_ALIGN - 1);
+}
+
+// 64-bit FNV-1a over 8-byte words; a short tail is zero-padded.
+static uint64_t checksum_update(uint64_t h, const void *data, size_t len)
+{
+	const unsigned char *p = data;
+	size_t words = len / 8;
+	for (size_t k = 0; k < words; k++) {
+		uint64_t w;
+		memcpy(&w, p + 8 * k, 8);
+		h = (h ^ w) * 0x100000001b3ULL;
+	}
+	if (len % 8) {
+		uint64_t w = 0;
+		memcpy(&w, p + 8 * words, len % 8);
+		h = (h ^ w) * 0x100000001b3ULL;
+	}
+	return h;
+}
+
+#define CHECKSUM_SEED 0xcbf29ce484222325ULL
+
+static int write_padding(FILE *file, uint64_t *pos)
+{
+	static const char zeros[GRAPH_FILE_ALIGN];
+	uint64_t next = align_up(*pos);
+	if (next > *pos && fwrite(zeros, 1, next - *pos, file) != next - *pos)
+		return 0;
+	*pos = next;
+	return 1;
+}
+
+typedef struct {
+	int v;
+	float weight;
+} arc;
+
+static int compare_arcs(const void *a, const void *b)
+{
+	const arc *x = a;
+	const arc *y = b;
+	return (x->v > y->v) - (x->v < y->v);
+}
+
+// Sorted CSR arrays of any storage; borrowed when g is compacted CSR.
+static int csr_arrays(graph *g, uint64_t **offsets, int **neighbors,
+		      float **weights, int *owned)
+{
+	int n = g->num_nodes;
+	size_t arcs = graph_num_arcs(g);
+	*owned = 0;
+	if (g->storage == GRAPH_CSR) {
+		graph_compact(g);
+		if (g->num_pending == 0 && g->num_dead == 0
+		    && sizeof(size_t) == sizeof(uint64_t)) {
+			*offsets = (uint64_t *) g->offsets;
+			*neighbors = g->neighbors;
+			*weights = g->weights;
+			return 1;
+		}
+	}
+
+	*owned = 1;
+	*offsets = malloc(((size_t)n + 1) * sizeof(uint64_t));
+	*neighbors = malloc((arcs ? arcs : 1) * sizeof(int));
+	*weights = malloc((arcs ? arcs : 1) * sizeof(float));
+	arc *row = malloc((n > 0 ? (size_t)n : 1) * sizeof(arc));
+	if (!*offsets || !*neighbors || !*weights || !row) {
+		free(*offsets);
+		free(*neighbors);
+		free(*weights);
+		free(row);
+		return 0;
+	}
+
+	size_t p = 0;
+	for (int u = 0; u < n; u++) {
+		size_t len = 0;
+		(*offsets)[u] = p;
+		for (neighbor_iter it = graph_neighbors(g, u);
+		     neighbor_next(&it);)
+			row[len++] = (arc) {
+		it.v, it.weight};
+		if (g->storage == GRAPH_DYNAMIC)
+			qsort(row, len, sizeof(arc), compare_arcs);
+		for (size_t k = 0; k < len; k++) {
+			(*neighbors)[p] = row[k].v;
+			(*weights)[p++] = row[k].weight;
+		}
+	}
+	(*offsets)[n] = p;
+	free(row);
+	return 1;
+}
+
+int save_graph_binary(graph *g, const char *filename)
+{
+	uint64_t *offsets;
+	int *neighbors;
+	float *weights;
+	int owned;
+	if (!csr_arrays(g, &offsets, &neighbors, &weights, &owned))
+		return 0;
+
+	uint64_t n = (uint64_t) g->num_nodes;
+	uint64_t m = offsets[n];
+	graph_file_header header = { 0 };
+	memcpy(header.magic, GRAPH_FILE_MAGIC, sizeof(GRAPH_FILE_MAGIC));
+	header.version = GRAPH_FILE_VERSION;
+	header.byte_order = GRAPH_FILE_BYTE_ORDER;
+	header.num_nodes = n;
+	header.num_arcs = m;
+	header.is_directed = (uint32_t)g->is_directed;
+	header.offsets_at = align_up(sizeof(header));
+	header.neighbors_at = align_up(header.offsets_at
+				       + (n + 1) * sizeof(uint64_t));
+	header.weights_at = align_up(header.neighbors_at + m * sizeof(int));
+
+	uint64_t h = CHECKSUM_SEED;
+	h = checksum_update(h, offsets, (n + 1) * sizeof(uint64_t));
+	h = checksum_update(h, neighbors, m * sizeof(int));
+	h = checksum_update(h, weights, m * sizeof(float));
+	header.checksum = h;
+
+	int ok = 0;
+	FILE *file = fopen(filename, "wb");
+	if (file) {
+		uint64_t pos = sizeof(header);
+		ok = fwrite(&header, sizeof(header), 1, file) == 1
+		    && write_padding(file, &pos)
+		    && fwrite(offsets, sizeof(uint64_t), n + 1, file) == n + 1;
+		pos += (n + 1) * sizeof(uint64_t);
+		ok = ok && write_padding(file, &pos)
+		    && (m == 0
+			|| fwrite(neighbors, sizeof(int), m, file) == m);
+		pos += m * sizeof(int);
+		ok = ok && write_padding(file, &pos)
+		    && (m == 0 || fwrite(weights, sizeof(float), m, file) == m);
+		ok = (fclose(file) == 0) && ok;
+	} else {
+		perror("Error");
+	}
+
+	if (owned) {
+		free(offsets);
+		free(neighbors);
+		free(weights);
+	}
+	return ok;
+}
+
+// count elements of elem bytes at offset at lie within the file, past
+// the header and not before first_free, without wrapping around
+static int range_valid(uint64_t at, uint64_t count, uint64_t elem,
+		       uint64_t first_free, size_t size)
+{
+	return at >= first_free && at <= size && count <= (size - at) / elem;
+}
+
+static int header_valid(const graph_file_header *hd, size_t size)
+{
+	if (memcmp(hd->magic, GRAPH_FILE_MAGIC, sizeof(GRAPH_FILE_MAGIC))
+	    || hd->version != GRAPH_FILE_VERSION
+	    || hd->byte_order != GRAPH_FILE_BYTE_ORDER)
+		return 0;
+	uint64_t n = hd->num_nodes, m = hd->num_arcs;
+	if (n > (uint64_t) INT32_MAX || m > size)
+		return 0;
+	if (hd->offsets_at % GRAPH_FILE_ALIGN
+	    || hd->neighbors_at % GRAPH_FILE_ALIGN
+	    || hd->weights_at % GRAPH_FILE_ALIGN)
+		return 0;
+	// The arrays follow the header and each other, as written: none
+	// overlaps the header or another array
+	return range_valid(hd->offsets_at, n + 1, sizeof(uint64_t),
+			   sizeof(*hd), size)
+	    && range_valid(hd->neighbors_at, m, sizeof(int),
+			   hd->offsets_at + (n + 1) * sizeof(uint64_t), size)
+	    && range_valid(hd->weights_at, m, sizeof(float),
+			   hd->neighbors_at + m * sizeof(int), size);
+}
+
+// Checksum, monotone offsets ending at m, sorted in-range neighbors
+static int contents_valid(const graph_file_header *hd,
+			  const uint64_t *offsets, const int *neighbors,
+			  const float *weights)
+{
+	uint64_t n = hd->num_nodes, m = hd->num_arcs;
+	uint64_t h = CHECKSUM_SEED;
+	h = checksum_update(h, offsets, (n + 1) * sizeof(uint64_t));
+	h = checksum_update(h, neighbors, m * sizeof(int));
+	h = checksum_update(h, weights, m * sizeof(float));
+	if (h != hd->checksum || offsets[0] != 0 || offsets[n] != m)
+		return 0;
+	for (uint64_t u = 0; u < n; u++) {
+		if (offsets[u] > offsets[u + 1])
+			return 0;
+		for (uint64_t p = offsets[u]; p < offsets[u + 1]; p++) {
+			if (neighbors[p] < 0 || (uint64_t) neighbors[p] >= n)
+				return 0;
+			if (p > offsets[u] && neighbors[p] <= neighbors[p - 1])
+				return 0;
+		}
+	}
+	return 1;
+}
+
+graph *read_graph_binary(const char *filename, int verify)
+{
+	if (sizeof(size_t) != sizeof(uint64_t))
+		return NULL;	// offsets are mapped as size_t
+
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0) {
+		perror("Failed to open file");
+		return NULL;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0
+	    || (size_t)st.st_size < sizeof(graph_file_header)) {
+		close(fd);
+		return NULL;
+	}
+	size_t size = (size_t)st.st_size;
+	// Private and writable: graph updates are copy-on-write in memory.
+	void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+			  fd, 0);
+	close(fd);
+	if (base == MAP_FAILED)
+		return NULL;
+
+	const graph_file_header *hd = base;
+	char *bytes = base;
+	graph *g = NULL;
+	if (header_valid(hd, size)) {
+		uint64_t *offsets = (uint64_t *) (bytes + hd->offsets_at);
+		int *neighbors = (int *)(bytes + hd->neighbors_at);
+		float *weights = (float *)(bytes + hd->weights_at);
+		if (!verify
+		    || contents_valid(hd, offsets, neighbors, weights))
+			g = calloc(1, sizeof(graph));
+		if (g) {
+			g->num_nodes = (int)hd->num_nodes;
+			g->is_directed = (int)hd->is_directed;
+			g->storage = GRAPH_CSR;
+			g->offsets = (size_t *)offsets;
+			g->neighbors = neighbors;
+			g->weights = weights;
+			g->mapping = base;
+			g->mapping_size = size;
+		}
+	}
+	if (!g)
+		munmap(base, size);
+	return g;
+}
+
+graph *load_graph(const char *filename, graph_storage storage)
+{
+	char magic[sizeof(GRAPH_FILE_MAGIC)] = { 0 };
+	FILE *file = fopen(filename, "rb");
+	if (!file) {
+		perror("Failed to open file");
+		return NULL;
+	}
+	size_t got = fread(magic, 1, sizeof(magic), file);
+	fclose(file);
+
+	if (got == sizeof(magic)
+	    && memcmp(magic, GRAPH_FILE_MAGIC, sizeof(magic)) == 0) {
+		graph *g = read_graph_binary(filename, 1);
+		if (g && !graph_convert(g, storage)) {
+			free_graph(g);
+			return NULL;
+		}
+		return g;
+	}
+	return read_graph_with_storage((char *)filename, storage);
+}
@@ -0,0 +1,414 @@
+#include "graph_reorder.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Label propagation stops after this many sweeps even if labels still
+// move; by then the communities that matter for locality are settled.
+#define MAX_PROPAGATION_SWEEPS 20
+// Searches for a pseudo-peripheral start node per component
+#define MAX_PERIPHERAL_SEARCHES 8
+
+const char *node_order_name(node_order order)
+{
+	switch (order) {
+	case NODE_ORDER_IDENTITY:
+		return "identity";
+	case NODE_ORDER_DEGREE:
+		return "degree";
+	case NODE_ORDER_RCM:
+		return "rcm";
+	case NODE_ORDER_COMMUNITY:
+		return "community";
+	}
+	return "?";
+}
+
+int *invert_permutation(const int *new_id, int n)
+{
+	int *inverse = malloc((n > 0 ? (size_t)n : 1) * sizeof(int));
+	if (!inverse)
+		return NULL;
+	for (int u = 0; u < n; u++)
+		inverse[new_id[u]] = u;
+	return inverse;
+}
+
+static int *degrees(graph *g)
+{
+	int n = g->num_nodes;
+	int *degree = malloc((n > 0 ? (size_t)n : 1) * sizeof(int));
+	if (!degree)
+		return NULL;
+	for (int u = 0; u < n; u++)
+		degree[u] = get_degree(g, u);
+	return degree;
+}
+
+// Nodes by degree, stable by id: list[k] is the k-th node. Counting sort,
+// O(n + max degree).
+static int *sort_by_degree(const int *degree, int n, int descending)
+{
+	int max_degree = 0;
+	for (int u = 0; u < n; u++)
+		if (degree[u] > max_degree)
+			max_degree = degree[u];
+
+	size_t *start = calloc((size_t)max_degree + 2, sizeof(size_t));
+	int *list = malloc((n > 0 ? (size_t)n : 1) * sizeof(int));
+	if (!start || !list) {
+		free(start);
+		free(list);
+		return NULL;
+	}
+	for (int u = 0; u < n; u++) {
+		int key = descending ? max_degree - degree[u] : degree[u];
+		start[key + 1]++;
+	}
+	for (int d = 0; d <= max_degree; d++)
+		start[d + 1] += start[d];
+	for (int u = 0; u < n; u++) {
+		int key = descending ? max_degree - degree[u] : degree[u];
+		list[start[key]++] = u;
+	}
+	free(start);
+	return list;
+}
+
+typedef struct {
+	int degree;
+	int v;
+} ranked_node;
+
+static int compare_ranked(const void *a, const void *b)
+{
+	const ranked_node *x = a;
+	const ranked_node *y = b;
+	if (x->degree != y->degree)
+		return (x->degree > y->degree) - (x->degree < y->degree);
+	return (x->v > y->v) - (x->v < y->v);
+}
+
+typedef struct {
+	graph *g;
+	const int *degree;
+	char *placed;		// already has a position in the ordering
+	int *stamp;		// BFS of the peripheral search that saw a node
+	int *queue;
+	ranked_node *scratch;
+	int searches;		// stamps handed out so far
+} rcm_work;
+
+// BFS over the unplaced nodes reachable from root. Returns the number of
+// levels; the last level is left at queue[*last_begin .. *count).
+static int bfs_levels(rcm_work *w, int root, int *last_begin, int *count)
+{
+	int stamp = ++w->searches;
+	int head = 0, tail = 0, levels = 0;
+	w->queue[tail++] = root;
+	w->stamp[root] = stamp;
+	while (head < tail) {
+		int level_end = tail;
+		*last_begin = head;
+		levels++;
+		for (; head < level_end; head++)
+			for (neighbor_iter it =
+			     graph_neighbors(w->g, w->queue[head]);
+			     neighbor_next(&it);) {
+				if (w->placed[it.v] || w->stamp[it.v] == stamp)
+					continue;
+				w->stamp[it.v] = stamp;
+				w->queue[tail++] = it.v;
+			}
+	}
+	*count = tail;
+	return levels;
+}
+
+// George-Liu: move to a minimum-degree node of the last BFS level while
+// that increases the eccentricity. Ends near one end of a long path
+// through the component, which keeps the Cuthill-McKee levels narrow.
+static int pseudo_peripheral(rcm_work *w, int root)
+{
+	int begin, count;
+	int levels = bfs_levels(w, root, &begin, &count);
+	for (int search = 0; search < MAX_PERIPHERAL_SEARCHES; search++) {
+		int best = w->queue[begin];
+		for (int k = begin + 1; k < count; k++) {
+			int v = w->queue[k];
+			if (w->degree[v] < w->degree[best]
+			    || (w->degree[v] == w->degree[best] && v < best))
+				best = v;
+		}
+		int next_levels = bfs_levels(w, best, &begin, &count);
+		if (next_levels <= levels)
+			break;
+		root = best;
+		levels = next_levels;
+	}
+	return root;
+}
+
+// Cuthill-McKee: BFS from a pseudo-peripheral node of every component,
+// visiting the neighbors of a node by increasing degree. order[k] is the
+// k-th node of that order; it is returned reversed by rcm_order.
+static int cuthill_mckee(rcm_work *w, const int *by_degree, int *order)
+{
+	int n = w->g->num_nodes;
+	int placed = 0;
+	for (int k = 0; k < n; k++) {
+		int s = by_degree[k];
+		if (w->placed[s])
+			continue;
+		int root = pseudo_peripheral(w, s);
+		int head = placed;
+		order[placed++] = root;
+		w->placed[root] = 1;
+		while (head < placed) {
+			int u = order[head++];
+			int found = 0;
+			for (neighbor_iter it = graph_neighbors(w->g, u);
+			     neighbor_next(&it);) {
+				if (w->placed[it.v])
+					continue;
+				w->placed[it.v] = 1;
+				w->scratch[found].degree = w->degree[it.v];
+				w->scratch[found++].v = it.v;
+			}
+			qsort(w->scratch, (size_t)found, sizeof(ranked_node),
+			      compare_ranked);
+			for (int f = 0; f < found; f++)
+				order[placed++] = w->scratch[f].v;
+		}
+	}
+	return placed == n;
+}
+
+// Reverse Cuthill-McKee as a list of nodes, list[k] being the node that
+// gets id k
+static int *rcm_order(graph *g, const int *degree)
+{
+	int n = g->num_nodes;
+	size_t len = n > 0 ? (size_t)n : 1;
+	rcm_work w = {
+		.g = g,
+		.degree = degree,
+		.placed = calloc(len, 1),
+		.stamp = calloc(len, sizeof(int)),
+		.queue = malloc(len * sizeof(int)),
+		.scratch = malloc(len * sizeof(ranked_node)),
+	};
+	int *by_degree = sort_by_degree(degree, n, 0);
+	int *order = malloc(len * sizeof(int));
+	int ok = w.placed && w.stamp && w.queue && w.scratch && by_degree
+	    && order && cuthill_mckee(&w, by_degree, order);
+
+	free(w.placed);
+	free(w.stamp);
+	free(w.queue);
+	free(w.scratch);
+	free(by_degree);
+	if (!ok) {
+		free(order);
+		return NULL;
+	}
+	for (int k = 0; k < n / 2; k++) {
+		int t = order[k];
+		order[k] = order[n - 1 - k];
+		order[n - 1 - k] = t;
+	}
+	return order;
+}
+
+// Asynchronous label propagation in id order: every node takes the label
+// most of its neighbors carry, the smallest such label on a tie.
+static int *propagate_labels(graph *g)
+{
+	int n = g->num_nodes;
+	size_t len = n > 0 ? (size_t)n : 1;
+	int *label = malloc(len * sizeof(int));
+	int *votes = calloc(len, sizeof(int));
+	int *touched = malloc(len * sizeof(int));
+	if (!label || !votes || !touched) {
+		free(label);
+		free(votes);
+		free(touched);
+		return NULL;
+	}
+	for (int u = 0; u < n; u++)
+		label[u] = u;
+
+	for (int sweep = 0; sweep < MAX_PROPAGATION_SWEEPS; sweep++) {
+		int changed = 0;
+		for (int u = 0; u < n; u++) {
+			int num_touched = 0;
+			for (neighbor_iter it = graph_neighbors(g, u);
+			     neighbor_next(&it);) {
+				int l = label[it.v];
+				if (votes[l]++ == 0)
+					touched[num_touched++] = l;
+			}
+			if (num_touched == 0)
+				continue;
+			int best = touched[0];
+			for (int k = 1; k < num_touched; k++) {
+				int l = touched[k];
+				if (votes[l] > votes[best]
+				    || (votes[l] == votes[best] && l < best))
+					best = l;
+			}
+			for (int k = 0; k < num_touched; k++)
+				votes[touched[k]] = 0;
+			if (best != label[u]) {
+				label[u] = best;
+				changed = 1;
+			}
+		}
+		if (!changed)
+			break;
+	}
+	free(votes);
+	free(touched);
+	return label;
+}
+
+// Communities laid out in the order RCM first reaches them, and their
+// nodes in RCM order inside each block.
+static int *community_order(graph *g, const int *degree)
+{
+	int n = g->num_nodes;
+	size_t len = n > 0 ? (size_t)n : 1;
+	int *rcm = rcm_order(g, degree);
+	int *label = propagate_labels(g);
+	int *size = calloc(len, sizeof(int));
+	int *cursor = malloc(len * sizeof(int));
+	int *order = malloc(len * sizeof(int));
+	if (!rcm || !label || !size || !cursor || !order) {
+		free(order);
+		order = NULL;
+		goto cleanup;
+	}
+
+	for (int u = 0; u < n; u++) {
+		size[label[u]]++;
+		cursor[u] = -1;
+	}
+	int next = 0;
+	for (int k = 0; k < n; k++) {
+		int l = label[rcm[k]];
+		if (cursor[l] < 0) {
+			cursor[l] = next;
+			next += size[l];
+		}
+		order[cursor[l]++] = rcm[k];
+	}
+
+cleanup:
+	free(rcm);
+	free(label);
+	free(size);
+	free(cursor);
+	return order;
+}
+
+int *graph_node_order(graph *g, node_order order)
+{
+	int n = g->num_nodes;
+	int *list = NULL;
+	int *degree = NULL;
+
+	if (order == NODE_ORDER_IDENTITY) {
+		int *new_id = malloc((n > 0 ? (size_t)n : 1) * sizeof(int));
+		if (new_id)
+			for (int u = 0; u < n; u++)
+				new_id[u] = u;
+		return new_id;
+	}
+
+	degree = degrees(g);
+	if (!degree)
+		return NULL;
+	switch (order) {
+	case NODE_ORDER_DEGREE:
+		list = sort_by_degree(degree, n, 1);
+		break;
+	case NODE_ORDER_RCM:
+		list = rcm_order(g, degree);
+		break;
+	case NODE_ORDER_COMMUNITY:
+		list = community_order(g, degree);
+		break;
+	case NODE_ORDER_IDENTITY:
+		break;
+	}
+	free(degree);
+	if (!list)
+		return NULL;
+
+	int *new_id = invert_permutation(list, n);
+	free(list);
+	return new_id;
+}
+
+int graph_permute(graph *g, const int *new_id)
+{
+	size_t arcs = graph_num_arcs(g);
+	size_t len = arcs ? arcs : 1;
+	int *src = malloc(len * sizeof(int));
+	int *dst = malloc(len * sizeof(int));
+	float *weight = malloc(len * sizeof(float));
+	if (!src || !dst || !weight) {
+		free(src);
+		free(dst);
+		free(weight);
+		return 0;
+	}
+
+	// Every arc is passed on its own, so undirected graphs keep the
+	// weights of both directions even where they differ.
+	size_t m = 0;
+	for (int u = 0; u < g->num_nodes; u++)
+		for (neighbor_iter it = graph_neighbors(g, u);
+		     neighbor_next(&it); m++) {
+			src[m] = new_id[u];
+			dst[m] = new_id[it.v];
+			weight[m] = it.weight;
+		}
+	graph *h = create_graph_from_edges(g->num_nodes, 1, src, dst, weight,
+					   m);
+	free(src);
+	free(dst);
+	free(weight);
+	if (!h)
+		return 0;
+	if (!graph_convert(h, g->storage)) {
+		free_graph(h);
+		return 0;
+	}
+
+	// Swap the contents and free the old ones through h
+	graph old = *g;
+	*g = *h;
+	g->is_directed = old.is_directed;
+	g->change_log = old.change_log;
+	*h = old;
+	h->change_log = NULL;
+	free_graph(h);
+	return 1;
+}
+
+int permute_array(void *values, size_t element_size, const int *new_id,
+		  int n)
+{
+	if (n <= 0)
+		return 1;
+	char *copy = malloc((size_t)n * element_size);
+	if (!copy)
+		return 0;
+	for (int i = 0; i < n; i++)
+		memcpy(copy + (size_t)new_id[i] * element_size,
+		       (const char *)values + (size_t)i * element_size,
+		       element_size);
+	memcpy(values, copy, (size_t)n * element_size);
+	free(copy);
+	return 1;
+}
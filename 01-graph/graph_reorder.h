@@ -0,0 +1,37 @@
+#ifndef GRAPH_REORDER_H
+#define GRAPH_REORDER_H
+
+#include "graph.h"
+
+// Node orderings that put nodes which are accessed together next to each
+// other in memory, so that walking the rows of a node touches nearby
+// opinions, distances and neighbor rows.
+typedef enum {
+	NODE_ORDER_IDENTITY = 0,
+	NODE_ORDER_DEGREE,	// decreasing degree: hubs share cache lines
+	NODE_ORDER_RCM,		// reverse Cuthill-McKee: small bandwidth
+	NODE_ORDER_COMMUNITY	// label propagation communities, RCM inside
+} node_order;
+
+// Name of an ordering for logs and benchmarks, "?" if unknown
+const char *node_order_name(node_order order);
+
+// The new id of every node, new_id[u] in 0 .. n - 1, or NULL if out of
+// memory. Directed graphs are ordered by their out-arcs. Deterministic:
+// ties are broken by node id.
+int *graph_node_order(graph * g, node_order order);
+
+// inverse[new_id[u]] = u. NULL if out of memory.
+int *invert_permutation(const int *new_id, int n);
+
+// Renumbers the nodes of g in place, node u becoming new_id[u]. The
+// storage type and the attached change log are kept. Returns 0 (g
+// unchanged) if out of memory.
+int graph_permute(graph * g, const int *new_id);
+
+// values'[new_id[i]] = values[i] for n elements of element_size bytes.
+// Returns 0 (values unchanged) if out of memory.
+int permute_array(void *values, size_t element_size, const int *new_id,
+		  int n);
+
+#endif				// GRAPH_REORDER_H
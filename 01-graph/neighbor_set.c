@@ -0,0 +1,124 @@
+#include "neighbor_set.h"
+#include <stdlib.h>
+#include <stdint.h>
+
+#define MIN_CAPACITY 4
+
+static inline int slot_of(int v, int capacity)
+{
+	uint32_t h = (uint32_t)v * 2654435769u;	// Fibonacci hashing
+	h ^= h >> 16;
+	return (int)(h & (uint32_t)(capacity - 1));
+}
+
+// Keeps (live + deleted) below 3/4 of the capacity.
+static int fits(int used, int capacity)
+{
+	return (long)used * 4 < (long)capacity * 3;
+}
+
+static int rehash(neighbor_set *s, int capacity)
+{
+	neighbor_slot *slots = malloc((size_t)capacity * sizeof(neighbor_slot));
+	if (!slots)
+		return 0;
+	for (int i = 0; i < capacity; i++)
+		slots[i].v = NEIGHBOR_EMPTY;
+
+	for (int i = 0; i < s->capacity; i++) {
+		if (s->slots[i].v < 0)
+			continue;
+		int p = slot_of(s->slots[i].v, capacity);
+		while (slots[p].v != NEIGHBOR_EMPTY)
+			p = (p + 1) & (capacity - 1);
+		slots[p] = s->slots[i];
+	}
+
+	free(s->slots);
+	s->slots = slots;
+	s->capacity = capacity;
+	s->used = s->size;
+	return 1;
+}
+
+static int capacity_for(int size)
+{
+	int capacity = MIN_CAPACITY;
+	while (!fits(size + 1, capacity))
+		capacity *= 2;
+	return capacity;
+}
+
+int neighbor_set_find(const neighbor_set *s, int v)
+{
+	if (s->capacity == 0)
+		return -1;
+	int mask = s->capacity - 1;
+	for (int p = slot_of(v, s->capacity);; p = (p + 1) & mask) {
+		if (s->slots[p].v == v)
+			return p;
+		if (s->slots[p].v == NEIGHBOR_EMPTY)
+			return -1;
+	}
+}
+
+int neighbor_set_insert(neighbor_set *s, int v, float weight)
+{
+	int p = neighbor_set_find(s, v);
+	if (p >= 0) {
+		s->slots[p].weight = weight;
+		return 1;
+	}
+
+	if (!fits(s->used + 1, s->capacity)) {
+		// Grow only if live entries need the room; otherwise just
+		// clear out the deleted markers.
+		int capacity = capacity_for(s->size + 1);
+		if (capacity < s->capacity)
+			capacity = s->capacity;
+		if (!rehash(s, capacity))
+			return 0;
+	}
+
+	int mask = s->capacity - 1;
+	p = slot_of(v, s->capacity);
+	while (s->slots[p].v >= 0)
+		p = (p + 1) & mask;
+	if (s->slots[p].v == NEIGHBOR_EMPTY)
+		s->used++;
+	s->slots[p].v = v;
+	s->slots[p].weight = weight;
+	s->size++;
+	return 1;
+}
+
+int neighbor_set_remove(neighbor_set *s, int v)
+{
+	int p = neighbor_set_find(s, v);
+	if (p < 0)
+		return 0;
+	s->slots[p].v = NEIGHBOR_DELETED;
+	s->size--;
+	return 1;
+}
+
+int neighbor_set_shrink(neighbor_set *s)
+{
+	if (s->size == 0) {
+		neighbor_set_free(s);
+		return 1;
+	}
+	int capacity = capacity_for(s->size);
+	if (capacity == s->capacity && s->used == s->size)
+		return 1;
+	return rehash(s, capacity);
+}
+
+void neighbor_set_free(neighbor_set *s)
+{
+	free(s->slots);
+	s->slots = NULL;
+	s->capacity = 0;
+	s->size = 0;
+	s->used = 0;
+}
@@ -0,0 +1,40 @@
+#ifndef NEIGHBOR_SET_H
+#define NEIGHBOR_SET_H
+
+// Open-addressing hash set of (neighbor, weight) pairs with linear
+// probing. Backs the GRAPH_DYNAMIC storage: insert, remove and lookup are
+// amortized O(1) and iterating the slots costs O(capacity) = O(degree).
+
+#define NEIGHBOR_EMPTY (-1)
+#define NEIGHBOR_DELETED (-2)
+
+typedef struct {
+	int v;			// neighbor id, NEIGHBOR_EMPTY or NEIGHBOR_DELETED
+	float weight;
+} neighbor_slot;
+
+typedef struct {
+	neighbor_slot *slots;
+	int capacity;		// 0 or a power of two
+	int size;		// live neighbors
+	int used;		// live neighbors plus deleted markers
+} neighbor_set;
+
+// Slot index holding v, or -1
+int neighbor_set_find(const neighbor_set * s, int v);
+
+// Inserts v or updates its weight. Returns 0 if the set had to grow and
+// the allocation failed.
+int neighbor_set_insert(neighbor_set * s, int v, float weight);
+
+// Marks v deleted. Never moves other entries, so it is safe while the
+// slots are being iterated.
+int neighbor_set_remove(neighbor_set * s, int v);
+
+// Rebuilds the table without deleted markers at the smallest capacity
+// that keeps the load factor bounded.
+int neighbor_set_shrink(neighbor_set * s);
+
+void neighbor_set_free(neighbor_set * s);
+
+#endif				// NEIGHBOR_SET_H
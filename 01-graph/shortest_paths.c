@@ -0,0 +1,396 @@
+#include "shortest_paths.h"
+#include "../11-helpers/thread_pool.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define SOURCES_PER_CHUNK 8
+#define DENSE_ARC_RATIO 8	// m >= n^2 / 8 counts as dense
+
+static int scan_weights(sp_graph *sg)
+{
+	size_t arcs = sg->offsets[sg->num_nodes];
+	sg->unit_weights = 1;
+	sg->negative_weights = 0;
+	for (size_t p = 0; p < arcs; p++) {
+		if (sg->weights[p] != 1.0f)
+			sg->unit_weights = 0;
+		if (sg->weights[p] < 0.0f)
+			sg->negative_weights = 1;
+	}
+	return 1;
+}
+
+int sp_graph_init(sp_graph *sg, graph *g)
+{
+	memset(sg, 0, sizeof(*sg));
+	sg->num_nodes = g->num_nodes;
+
+	if (g->storage == GRAPH_CSR) {
+		graph_compact(g);
+		if (g->num_pending == 0 && g->num_dead == 0) {
+			sg->offsets = g->offsets;
+			sg->neighbors = g->neighbors;
+			sg->weights = g->weights;
+			return scan_weights(sg);
+		}
+	}
+
+	int n = g->num_nodes;
+	size_t arcs = graph_num_arcs(g);
+	sg->owned_offsets = malloc(((size_t)n + 1) * sizeof(size_t));
+	sg->owned_neighbors = malloc((arcs ? arcs : 1) * sizeof(int));
+	sg->owned_weights = malloc((arcs ? arcs : 1) * sizeof(float));
+	if (!sg->owned_offsets || !sg->owned_neighbors
+	    || !sg->owned_weights) {
+		sp_graph_free(sg);
+		return 0;
+	}
+
+	size_t p = 0;
+	for (int u = 0; u < n; u++) {
+		sg->owned_offsets[u] = p;
+		for (neighbor_iter it = graph_neighbors(g, u);
+		     neighbor_next(&it);) {
+			sg->owned_neighbors[p] = it.v;
+			sg->owned_weights[p++] = it.weight;
+		}
+	}
+	sg->owned_offsets[n] = p;
+
+	sg->offsets = sg->owned_offsets;
+	sg->neighbors = sg->owned_neighbors;
+	sg->weights = sg->owned_weights;
+	return scan_weights(sg);
+}
+
+void sp_graph_free(sp_graph *sg)
+{
+	free(sg->owned_offsets);
+	free(sg->owned_neighbors);
+	free(sg->owned_weights);
+	memset(sg, 0, sizeof(*sg));
+}
+
+int sp_workspace_init(sp_workspace *ws, int num_nodes)
+{
+	size_t n = num_nodes > 0 ? (size_t)num_nodes : 1;
+	ws->heap = malloc(n * sizeof(int));
+	ws->heap_pos = malloc(n * sizeof(int));
+	ws->heap_size = 0;
+	if (!ws->heap || !ws->heap_pos) {
+		sp_workspace_free(ws);
+		return 0;
+	}
+	for (size_t i = 0; i < n; i++)
+		ws->heap_pos[i] = -1;
+	return 1;
+}
+
+void sp_workspace_free(sp_workspace *ws)
+{
+	free(ws->heap);
+	free(ws->heap_pos);
+	ws->heap = NULL;
+	ws->heap_pos = NULL;
+}
+
+static void heap_sift_up(sp_workspace *ws, const float *key, int i)
+{
+	int node = ws->heap[i];
+	while (i > 0) {
+		int parent = (i - 1) / 2;
+		if (key[ws->heap[parent]] <= key[node])
+			break;
+		ws->heap[i] = ws->heap[parent];
+		ws->heap_pos[ws->heap[i]] = i;
+		i = parent;
+	}
+	ws->heap[i] = node;
+	ws->heap_pos[node] = i;
+}
+
+static void heap_sift_down(sp_workspace *ws, const float *key, int i)
+{
+	int node = ws->heap[i];
+	for (;;) {
+		int child = 2 * i + 1;
+		if (child >= ws->heap_size)
+			break;
+		if (child + 1 < ws->heap_size
+		    && key[ws->heap[child + 1]] < key[ws->heap[child]])
+			child++;
+		if (key[node] <= key[ws->heap[child]])
+			break;
+		ws->heap[i] = ws->heap[child];
+		ws->heap_pos[ws->heap[i]] = i;
+		i = child;
+	}
+	ws->heap[i] = node;
+	ws->heap_pos[node] = i;
+}
+
+static int heap_pop(sp_workspace *ws, const float *key)
+{
+	int top = ws->heap[0];
+	ws->heap_pos[top] = -1;
+	if (--ws->heap_size > 0) {
+		ws->heap[0] = ws->heap[ws->heap_size];
+		heap_sift_down(ws, key, 0);
+	}
+	return top;
+}
+
+// Inserts node or lowers its key to the value already stored in key[].
+static void heap_push_or_decrease(sp_workspace *ws, const float *key,
+				  int node)
+{
+	int i = ws->heap_pos[node];
+	if (i < 0) {
+		i = ws->heap_size++;
+		ws->heap[i] = node;
+	}
+	heap_sift_up(ws, key, i);
+}
+
+static void bfs(const sp_graph *sg, int source, float *row,
+		sp_workspace *ws)
+{
+	int *queue = ws->heap;
+	int front = 0, back = 0;
+	row[source] = 0.0f;
+	queue[back++] = source;
+	while (front < back) {
+		int u = queue[front++];
+		float next = row[u] + 1.0f;
+		for (size_t p = sg->offsets[u]; p < sg->offsets[u + 1]; p++) {
+			int v = sg->neighbors[p];
+			if (row[v] < SP_INF)
+				continue;
+			row[v] = next;
+			queue[back++] = v;
+		}
+	}
+}
+
+static void dijkstra(const sp_graph *sg, int source, float *row,
+		     sp_workspace *ws)
+{
+	row[source] = 0.0f;
+	ws->heap_size = 0;
+	heap_push_or_decrease(ws, row, source);
+	while (ws->heap_size > 0) {
+		int u = heap_pop(ws, row);
+		for (size_t p = sg->offsets[u]; p < sg->offsets[u + 1]; p++) {
+			int v = sg->neighbors[p];
+			float alt = row[u] + sg->weights[p];
+			if (alt < row[v]) {
+				row[v] = alt;
+				heap_push_or_decrease(ws, row, v);
+			}
+		}
+	}
+}
+
+void sp_single_source(const sp_graph *sg, int source, float *row,
+		      sp_workspace *ws)
+{
+	for (int v = 0; v < sg->num_nodes; v++)
+		row[v] = SP_INF;
+	if (sg->unit_weights)
+		bfs(sg, source, row, ws);
+	else
+		dijkstra(sg, source, row, ws);
+}
+
+void sp_propagate(const sp_graph *sg, float *row, const int *seeds,
+		  size_t num_seeds, sp_workspace *ws)
+{
+	ws->heap_size = 0;
+	for (size_t k = 0; k < num_seeds; k++)
+		heap_push_or_decrease(ws, row, seeds[k]);
+	while (ws->heap_size > 0) {
+		int u = heap_pop(ws, row);
+		for (size_t p = sg->offsets[u]; p < sg->offsets[u + 1]; p++) {
+			int v = sg->neighbors[p];
+			float alt = row[u] + sg->weights[p];
+			if (alt < row[v]) {
+				row[v] = alt;
+				heap_push_or_decrease(ws, row, v);
+			}
+		}
+	}
+}
+
+size_t sp_ball(const sp_graph *sg, int source, float radius, float *row,
+	       int *nodes, float *dists, float *cutoff, sp_workspace *ws)
+{
+	size_t count = 0;
+	row[source] = 0.0f;
+	ws->heap_size = 0;
+	heap_push_or_decrease(ws, row, source);
+	while (ws->heap_size > 0 && row[ws->heap[0]] <= radius) {
+		int u = heap_pop(ws, row);
+		nodes[count] = u;
+		dists[count++] = row[u];
+		for (size_t p = sg->offsets[u]; p < sg->offsets[u + 1]; p++) {
+			int v = sg->neighbors[p];
+			float alt = row[u] + sg->weights[p];
+			if (alt < row[v]) {
+				row[v] = alt;
+				heap_push_or_decrease(ws, row, v);
+			}
+		}
+	}
+
+	// The frontier left in the heap bounds every node outside the ball
+	*cutoff = ws->heap_size > 0 ? row[ws->heap[0]] : SP_INF;
+	for (int k = 0; k < ws->heap_size; k++) {
+		row[ws->heap[k]] = SP_INF;
+		ws->heap_pos[ws->heap[k]] = -1;
+	}
+	ws->heap_size = 0;
+	for (size_t k = 0; k < count; k++)
+		row[nodes[k]] = SP_INF;
+	return count;
+}
+
+#define DIST(i,j) dist[(size_t)(i)*n + (j)]
+
+void floyd_warshall_scalar(float *dist, int n)
+{
+	for (int k = 0; k < n; k++) {
+		for (int i = 0; i < n; i++) {
+			for (int j = 0; j < n; j++) {
+				if (DIST(i, k) < SP_INF
+				    && DIST(k, j) < SP_INF) {
+					float alt =
+					    DIST(i, k) + DIST(k, j);
+					if (alt < DIST(i, j)) {
+						DIST(i, j) = alt;
+					}
+				}
+			}
+		}
+	}
+}
+
+static float *weight_matrix(const sp_graph *sg)
+{
+	int n = sg->num_nodes;
+	float *dist = malloc((size_t)n * n * sizeof(float));
+	if (!dist)
+		return NULL;
+
+	for (int i = 0; i < n; i++) {
+		for (int j = 0; j < n; j++)
+			DIST(i, j) = (i == j) ? 0.0f : SP_INF;
+		for (size_t p = sg->offsets[i]; p < sg->offsets[i + 1]; p++) {
+			if (sg->neighbors[p] != i)
+				DIST(i, sg->neighbors[p]) = sg->weights[p];
+		}
+	}
+	return dist;
+}
+
+static float *floyd_warshall(const sp_graph *sg, int blocked)
+{
+	float *dist = weight_matrix(sg);
+	if (!dist)
+		return NULL;
+	if (!blocked) {
+		floyd_warshall_scalar(dist, sg->num_nodes);
+	} else if (!floyd_warshall_blocked(dist, sg->num_nodes)) {
+		free(dist);
+		return NULL;
+	}
+	return dist;
+}
+
+typedef struct {
+	const sp_graph *sg;
+	float *dist;
+	sp_workspace *workspaces;	// one per pool worker
+} per_source_job;
+
+static void per_source_chunk(void *ctx, size_t begin, size_t end,
+			     int worker)
+{
+	per_source_job *job = ctx;
+	size_t n = (size_t)job->sg->num_nodes;
+	for (size_t s = begin; s < end; s++)
+		sp_single_source(job->sg, (int)s, job->dist + s * n,
+				 &job->workspaces[worker]);
+}
+
+static float *per_source(const sp_graph *sg)
+{
+	int n = sg->num_nodes;
+	int workers = thread_pool_size();
+	float *dist = malloc((size_t)n * n * sizeof(float));
+	sp_workspace *workspaces = calloc((size_t)workers,
+					  sizeof(sp_workspace));
+	if (!dist || !workspaces) {
+		free(dist);
+		free(workspaces);
+		return NULL;
+	}
+
+	int ok = 1;
+	for (int w = 0; w < workers; w++)
+		ok &= sp_workspace_init(&workspaces[w], n);
+	if (ok) {
+		per_source_job job = { sg, dist, workspaces };
+		parallel_for((size_t)n, SOURCES_PER_CHUNK, per_source_chunk,
+			     &job);
+	}
+
+	for (int w = 0; w < workers; w++)
+		sp_workspace_free(&workspaces[w]);
+	free(workspaces);
+	if (!ok) {
+		free(dist);
+		return NULL;
+	}
+	return dist;
+}
+
+float *compute_all_pairs_distances_with(graph *g, apsp_method method)
+{
+	sp_graph sg;
+	if (!sp_graph_init(&sg, g))
+		return NULL;
+
+	// Dijkstra and the unguarded SIMD kernels need non-negative weights
+	if (sg.negative_weights)
+		method = APSP_FLOYD_WARSHALL;
+
+	// A search per source costs about n * m (log n for Dijkstra), the
+	// blocked kernel n^3 at 8-16 lanes: it wins once rows are dense.
+	if (method == APSP_AUTO) {
+		size_t n = (size_t)sg.num_nodes;
+		method = sg.offsets[n] * DENSE_ARC_RATIO >= n * n
+		    ? APSP_BLOCKED_FLOYD_WARSHALL : APSP_PER_SOURCE;
+	}
+
+	float *dist = NULL;
+	switch (method) {
+	case APSP_FLOYD_WARSHALL:
+		dist = floyd_warshall(&sg, 0);
+		break;
+	case APSP_BLOCKED_FLOYD_WARSHALL:
+		dist = floyd_warshall(&sg, 1);
+		break;
+	case APSP_AUTO:
+	case APSP_PER_SOURCE:
+		dist = per_source(&sg);
+		break;
+	}
+
+	sp_graph_free(&sg);
+	return dist;
+}
+
+float *compute_all_pairs_distances(graph *g)
+{
+	return compute_all_pairs_distances_with(g, APSP_AUTO);
+}
@@ -0,0 +1,95 @@
+#ifndef SHORTEST_PATHS_H
+#define SHORTEST_PATHS_H
+
+#include "graph.h"
+
+#define SP_INF 1e9f		// distance between unreachable nodes
+
+typedef enum {
+	APSP_AUTO = 0,		// picks one of the methods below
+	APSP_PER_SOURCE,	// BFS / Dijkstra from every node, in parallel
+	APSP_FLOYD_WARSHALL,	// scalar O(n^3) reference
+	APSP_BLOCKED_FLOYD_WARSHALL	// cache-blocked SIMD Floyd-Warshall
+} apsp_method;
+
+// Read-only CSR snapshot of a graph that worker threads can share. It
+// borrows the arrays of a compacted CSR graph and copies any other storage.
+typedef struct {
+	int num_nodes;
+	const size_t *offsets;
+	const int *neighbors;
+	const float *weights;
+	int unit_weights;	// every weight is 1: BFS gives the distances
+	int negative_weights;	// Dijkstra does not apply
+
+	size_t *owned_offsets;
+	int *owned_neighbors;
+	float *owned_weights;
+} sp_graph;
+
+// Per-thread scratch space for single-source searches
+typedef struct {
+	int *heap;		// binary min-heap of nodes keyed by distance
+	int *heap_pos;		// index of each node in heap, -1 if absent
+	int heap_size;
+} sp_workspace;
+
+int sp_graph_init(sp_graph * sg, graph * g);
+void sp_graph_free(sp_graph * sg);
+
+int sp_workspace_init(sp_workspace * ws, int num_nodes);
+void sp_workspace_free(sp_workspace * ws);
+
+// Fills row[0 .. n) with the distances from source: BFS hop counts on
+// unit-weight graphs, Dijkstra otherwise. Unreachable nodes get SP_INF.
+void sp_single_source(const sp_graph * sg, int source, float *row,
+		      sp_workspace * ws);
+
+// Resumes Dijkstra after some arcs got cheaper: row holds the distances
+// before the change except at the seed nodes, whose entries have just
+// been lowered. Pushes the improvements to everything reachable from them.
+void sp_propagate(const sp_graph * sg, float *row, const int *seeds,
+		  size_t num_seeds, sp_workspace * ws);
+
+// Dijkstra from source cut at radius: writes the nodes at distance <=
+// radius (source first) with their distances to nodes[] / dists[] and
+// returns their number. *cutoff gets a lower bound on the distance of
+// every other node, SP_INF if none is reachable. row is scratch of n
+// entries that must be all SP_INF on entry and is left that way.
+size_t sp_ball(const sp_graph * sg, int source, float radius, float *row,
+	       int *nodes, float *dists, float *cutoff, sp_workspace * ws);
+
+// n x n row-major distance matrix (free with free()), or NULL. Graphs
+// with negative weights always take the scalar Floyd-Warshall path.
+float *compute_all_pairs_distances_with(graph * g, apsp_method method);
+
+// In-place Floyd-Warshall on an n x n row-major matrix holding arc
+// weights, SP_INF for missing arcs and 0 on the diagonal. The blocked
+// version needs non-negative weights and returns 0 if out of memory.
+void floyd_warshall_scalar(float *dist, int n);
+int floyd_warshall_blocked(float *dist, int n);
+// Name of the kernel floyd_warshall_blocked dispatches to on this CPU
+const char *floyd_warshall_blocked_kernel(void);
+
+// Brings dist (the n x n matrix of g before the changes in log) up to
+// date with g. The net change of every arc is classified:
+//  - a weight increase or removal invalidates the rows of the sources
+//    whose shortest-path tree may use the arc (d[s][u] + w_old <= d[s][v]);
+//    those rows are recomputed from scratch,
+//  - a decrease or insertion that shortens d[s][v] seeds an incremental
+//    Dijkstra pass over the remaining rows.
+// Rows untouched by the changes cost O(#changes) each. Falls back to a
+// full recomputation when the log overflowed or weights are negative,
+// and recomputes every row in place, without looking at the changes,
+// when the log holds a quarter as many entries as g has arcs. Repair
+// only pays off for local changes (edge inserts and removals, a few
+// reweighted arcs), not when every arc is reweighted.
+// Returns 0 if out of memory, dist is then left unchanged.
+int apsp_repair(graph * g, float *dist, const graph_change_log * log);
+// Same, also setting changed[s] (n entries) to 1 for the rows it may
+// have modified and to 0 for the rows it left as they were. Rows are
+// flagged conservatively: a recomputed row counts as changed.
+int apsp_repair_rows(graph * g, float *dist, const graph_change_log * log,
+		     unsigned char *changed);
+
+#endif				// SHORTEST_PATHS_H
@@ -1,168 +1,697 @@
-#include "../01-graph/graph.h"
+#include "graph_generators.h"
+#include <math.h>
+#include <stdatomic.h>
 #include <stdlib.h>
-#include "../11-helpers/get_urandom.h"	// random float in [min, max)
+#include <string.h>
+#include "../11-helpers/thread_pool.h"
+#include "../11-helpers/rng_batch.h"
 
-// Helper: get out-degree of node (for directed, else degree)
-static int get_degree(graph *g, int node)
+// Every generator is written as a stream into an edge_sink (see
+// edge_sink.h). The parallel ones cut their work into chunks, each with
+// its own stream of the seed, and hand the chunk edges to the sink in
+// chunk order, so the output depends only on the seed. Only one wave of
+// chunks is buffered at a time.
+
+#define EDGES_PER_BATCH 65536
+
+typedef struct {
+	int *src;
+	int *dst;
+	size_t count;
+	size_t capacity;
+} edge_buffer;
+
+static int buffer_push(edge_buffer *b, int u, int v)
 {
-	int degree = 0;
-	int n = g->num_nodes;
-	for (int v = 0; v < n; v++) {
-		if (is_connected(g, node, v))
-			degree++;
+	if (b->count == b->capacity) {
+		size_t cap = b->capacity ? 2 * b->capacity : 1024;
+		int *s = realloc(b->src, cap * sizeof(int));
+		if (!s)
+			return 0;
+		b->src = s;
+		int *d = realloc(b->dst, cap * sizeof(int));
+		if (!d)
+			return 0;
+		b->dst = d;
+		b->capacity = cap;
 	}
-	return degree;
+	b->src[b->count] = u;
+	b->dst[b->count++] = v;
+	return 1;
+}
+
+// Passes the buffered edges on once there are enough of them, or always
+// if force is set.
+static int buffer_flush(edge_buffer *b, edge_sink *sink, int force)
+{
+	if (b->count == 0 || (!force && b->count < EDGES_PER_BATCH))
+		return 1;
+	int ok = sink->add(sink, b->src, b->dst, b->count);
+	b->count = 0;
+	return ok;
+}
+
+static void buffer_free(edge_buffer *b)
+{
+	free(b->src);
+	free(b->dst);
+}
+
+// Generates the edges of one chunk into out; 0 on failure
+typedef int (*chunk_fn)(void *ctx, size_t chunk, edge_buffer *out,
+			int worker);
+
+typedef struct {
+	chunk_fn fn;
+	void *ctx;
+	size_t first;
+	edge_buffer *buffers;
+	atomic_int failed;
+} wave_job;
+
+static void wave_chunk(void *ctx, size_t begin, size_t end, int worker)
+{
+	wave_job *job = ctx;
+	for (size_t c = begin; c < end; c++)
+		if (!job->fn(job->ctx, job->first + c, &job->buffers[c],
+			     worker))
+			atomic_store(&job->failed, 1);
 }
 
-// Check if 'val' is in 'arr' of length 'len'
-static int contains(int *arr, int len, int val)
+// Runs fn over all chunks in parallel waves and streams their edges to
+// sink in chunk order.
+static int stream_chunks(size_t num_chunks, chunk_fn fn, void *ctx,
+			 edge_sink *sink)
 {
-	for (int i = 0; i < len; i++) {
-		if (arr[i] == val)
-			return 1;
+	size_t wave = 4 * (size_t)thread_pool_size();
+	edge_buffer *buffers = calloc(wave, sizeof(edge_buffer));
+	int ok = buffers != NULL;
+	for (size_t first = 0; ok && first < num_chunks; first += wave) {
+		size_t count = num_chunks - first < wave
+		    ? num_chunks - first : wave;
+		wave_job job = { fn, ctx, first, buffers, 0 };
+		parallel_for(count, 1, wave_chunk, &job);
+		ok = !atomic_load(&job.failed);
+		for (size_t c = 0; c < count; c++)
+			ok = ok && buffer_flush(&buffers[c], sink, 1);
+		for (size_t c = 0; c < count; c++)
+			buffers[c].count = 0;
 	}
-	return 0;
+	for (size_t c = 0; buffers && c < wave; c++)
+		buffer_free(&buffers[c]);
+	free(buffers);
+	return ok;
 }
 
-// Erdős-Rényi random graph
-graph *generate_erdos_renyi(int n, float p, int is_directed)
+// Random pairs by geometric skips (Batagelj and Brandes): in a region of
+// candidate pairs where each is an edge with probability p, the gap
+// between two successive edges is geometric, so one random number per
+// edge replaces one per pair and a region costs O(rows + edges). Each
+// region is cut by rows into chunks of about EDGES_PER_CHUNK expected
+// edges.
+
+#define EDGES_PER_CHUNK 65536
+
+typedef enum {
+	PAIRS_ALL,		// every column
+	PAIRS_ABOVE_DIAGONAL,	// columns v > u
+	PAIRS_OFF_DIAGONAL	// columns v != u
+} pair_shape;
+
+typedef struct {
+	int row_begin;
+	int row_end;
+	int col_begin;
+	int col_end;
+	pair_shape shape;
+	double log_q;		// log(1 - p)
+} pair_chunk;
+
+typedef struct {
+	pair_chunk *chunks;
+	size_t count;
+	size_t capacity;
+	uint64_t seed;
+} pair_job;
+
+static size_t row_pairs(const pair_chunk *c, int u)
 {
-	graph *g = create_graph(n, is_directed);
-	if (!g)
-		return NULL;
+	switch (c->shape) {
+	case PAIRS_ABOVE_DIAGONAL:
+		return (size_t)(c->col_end - u - 1);
+	case PAIRS_OFF_DIAGONAL:
+		return (size_t)(c->col_end - c->col_begin - 1);
+	default:
+		return (size_t)(c->col_end - c->col_begin);
+	}
+}
 
-	for (int u = 0; u < n; u++) {
-		// if directed, v starts from 0; else avoid double edges by v > u
-		for (int v = is_directed ? 0 : u + 1; v < n; v++) {
-			if (u != v && get_urandom(0.0f, 1.0f) < p) {
-				add_edge(g, u, v, 1.0f);
-				if (!is_directed)
-					add_edge(g, v, u, 1.0f);
-			}
+static int pair_column(const pair_chunk *c, int u, int j)
+{
+	switch (c->shape) {
+	case PAIRS_ABOVE_DIAGONAL:
+		return u + 1 + j;
+	case PAIRS_OFF_DIAGONAL:
+		return c->col_begin + j < u ? c->col_begin + j
+		    : c->col_begin + j + 1;
+	default:
+		return c->col_begin + j;
+	}
+}
+
+// Adds the chunks of rows x cols (same range for the diagonal shapes)
+static int add_pair_region(pair_job *job, int row_begin, int row_end,
+			   int col_begin, int col_end, pair_shape shape,
+			   double p)
+{
+	if (p <= 0.0 || row_begin >= row_end || col_begin >= col_end)
+		return 1;
+	pair_chunk region = { row_begin, row_end, col_begin, col_end, shape,
+		p >= 1.0 ? -INFINITY : log1p(-p)
+	};
+	double pairs = 0;
+	for (int u = row_begin; u < row_end; u++)
+		pairs += (double)row_pairs(&region, u);
+	double chunks = ceil(p * pairs / EDGES_PER_CHUNK);
+	if (chunks > row_end - row_begin)
+		chunks = row_end - row_begin;
+	if (chunks < 1)
+		chunks = 1;
+
+	double seen = 0;
+	int u = row_begin;
+	for (int c = 0; c < (int)chunks; c++) {
+		if (job->count == job->capacity) {
+			size_t cap = job->capacity ? 2 * job->capacity : 64;
+			pair_chunk *grown = realloc(job->chunks,
+						    cap * sizeof(pair_chunk));
+			if (!grown)
+				return 0;
+			job->chunks = grown;
+			job->capacity = cap;
 		}
+		pair_chunk *chunk = &job->chunks[job->count++];
+		*chunk = region;
+		chunk->row_begin = u;
+		while (u < row_end && seen < pairs * (c + 1) / chunks)
+			seen += (double)row_pairs(&region, u++);
+		chunk->row_end = c + 1 == (int)chunks ? row_end : u;
+		u = chunk->row_end;
 	}
-	return g;
+	return 1;
 }
 
-// Watts-Strogatz small-world model
-// k must be even
-graph *generate_watts_strogatz(int n, int k, float beta, int is_directed)
+static int pair_chunk_edges(void *ctx, size_t k, edge_buffer *out,
+			    int worker)
 {
-	if (k % 2 != 0)
-		return NULL;	// k must be even
-	graph *g = create_graph(n, is_directed);
-	if (!g)
-		return NULL;
+	(void)worker;
+	pair_job *job = ctx;
+	const pair_chunk *c = &job->chunks[k];
+	rng_buffer draws;
+	rng_buffer_seed(&draws, job->seed, k);
+	int u = c->row_begin;
+	double pos = -1;	// index into the row of u
+	while (u < c->row_end) {
+		pos += 1 + floor(log1p(-rng_buffer_uniform(&draws)) / c->log_q);
+		while (u < c->row_end && pos >= (double)row_pairs(c, u))
+			pos -= (double)row_pairs(c, u++);
+		if (u == c->row_end)
+			break;
+		if (!buffer_push(out, u, pair_column(c, u, (int)pos)))
+			return 0;
+	}
+	return 1;
+}
 
-	int half_k = k / 2;
+static int stream_pairs(pair_job *job, int n, int is_directed,
+			edge_sink *sink)
+{
+	int ok = sink->begin(sink, n, is_directed)
+	    && stream_chunks(job->count, pair_chunk_edges, job, sink)
+	    && sink->end(sink);
+	free(job->chunks);
+	return ok;
+}
 
-	// Step 1: Ring lattice
-	for (int u = 0; u < n; u++) {
-		for (int i = 1; i <= half_k; i++) {
-			int v = (u + i) % n;
-			add_edge(g, u, v, 1.0f);
-			if (!is_directed)
-				add_edge(g, v, u, 1.0f);
-		}
+int stream_erdos_renyi(int n, float p, int is_directed, uint64_t seed,
+		       edge_sink *sink)
+{
+	if (n < 0)
+		return 0;
+	pair_job job = { NULL, 0, 0, seed };
+	if (!add_pair_region(&job, 0, n, 0, n, is_directed
+			     ? PAIRS_OFF_DIAGONAL : PAIRS_ABOVE_DIAGONAL, p))
+		return 0;
+	return stream_pairs(&job, n, is_directed, sink);
+}
+
+int stream_stochastic_block_model(int num_blocks, const int *block_sizes,
+				  const float *probs, int is_directed,
+				  uint64_t seed, edge_sink *sink)
+{
+	if (num_blocks < 1)
+		return 0;
+	int *first = malloc(((size_t)num_blocks + 1) * sizeof(int));
+	if (!first)
+		return 0;
+	long long n = 0;
+	for (int b = 0; b < num_blocks; b++) {
+		first[b] = (int)n;
+		n += block_sizes[b] > 0 ? block_sizes[b] : 0;
+	}
+	first[num_blocks] = (int)n;
+	if (n > INT32_MAX) {
+		free(first);
+		return 0;
 	}
 
-	// Step 2: Rewiring edges with probability beta
-	for (int u = 0; u < n; u++) {
-		for (int i = 1; i <= half_k; i++) {
-			int v = (u + i) % n;
-			if (is_connected(g, u, v)
-			    && get_urandom(0.0f, 1.0f) < beta) {
-				// Remove original edge(s)
-				g->edges[u * n + v] = 0;
-				g->edge_weights[u * n + v] = 0.0f;
-				if (!is_directed) {
-					g->edges[v * n + u] = 0;
-					g->edge_weights[v * n + u] = 0.0f;
-				}
-
-				// Find new random node for rewiring
-				int new_v;
-				do {
-					new_v =
-					    (int)get_urandom(0, (float)n);
-				} while (new_v == u
-					 || is_connected(g, u, new_v));
-
-				add_edge(g, u, new_v, 1.0f);
-				if (!is_directed)
-					add_edge(g, new_v, u, 1.0f);
-			}
+	pair_job job = { NULL, 0, 0, seed };
+	int ok = 1;
+	for (int r = 0; ok && r < num_blocks; r++) {
+		for (int s = is_directed ? 0 : r; ok && s < num_blocks; s++) {
+			pair_shape shape = r != s ? PAIRS_ALL : is_directed
+			    ? PAIRS_OFF_DIAGONAL : PAIRS_ABOVE_DIAGONAL;
+			ok = add_pair_region(&job, first[r], first[r + 1],
+					     first[s], first[s + 1], shape,
+					     probs[r * num_blocks + s]);
 		}
 	}
-	return g;
+	free(first);
+	if (!ok) {
+		free(job.chunks);
+		return 0;
+	}
+	return stream_pairs(&job, (int)n, is_directed, sink);
 }
 
-// Barabási-Albert scale-free model
-graph *generate_barabasi_albert(int n, int m, int is_directed)
+// Watts-Strogatz: node u owns the k/2 ring lattice edges to u + 1 ..
+// u + k/2 and rewires each with probability beta to a uniform node that
+// is not u, not already a target of u and, if undirected, not one of its
+// lattice neighbors u - k/2 .. u - 1; a small hash set per worker does
+// the duplicate checks. O(n k) in chunks of WS_NODES_PER_CHUNK nodes,
+// every node drawing from its own stream.
+
+#define WS_NODES_PER_CHUNK 4096
+
+typedef struct {
+	int n;
+	int half_k;
+	int is_directed;
+	double beta;
+	uint64_t seed;
+	neighbor_set *seen;	// one per worker
+} ws_job;
+
+static void clear_set(neighbor_set *s)
 {
-	if (m < 1 || m >= n)
-		return NULL;
+	for (int i = 0; i < s->capacity; i++)
+		s->slots[i].v = NEIGHBOR_EMPTY;
+	s->size = 0;
+	s->used = 0;
+}
+
+// Lattice targets of u, rewired in place
+static int ws_rewire(ws_job *job, int u, int *dst, neighbor_set *seen)
+{
+	int n = job->n, half_k = job->half_k;
+	// Largest number of nodes a rewiring may have to avoid
+	int avoided = 1 + (job->is_directed ? 2 : 3) * half_k;
+	for (int i = 0; i < half_k; i++)
+		dst[i] = (u + i + 1) % n;
+	if (job->beta <= 0.0 || avoided >= n)
+		return 1;
+
+	rng_state rng;
+	rng_seed_stream(&rng, job->seed, (uint64_t)u);
+	clear_set(seen);
+	int ok = neighbor_set_insert(seen, u, 1.0f);
+	for (int i = 0; ok && i < half_k; i++) {
+		ok = neighbor_set_insert(seen, dst[i], 1.0f);
+		if (ok && !job->is_directed)
+			ok = neighbor_set_insert(seen, (u - i - 1 + n) % n,
+						 1.0f);
+	}
+	for (int i = 0; ok && i < half_k; i++) {
+		if (rng_uniform(&rng) >= job->beta)
+			continue;
+		int w;
+		do
+			w = (int)rng_below(&rng, (uint64_t)n);
+		while (neighbor_set_find(seen, w) >= 0);
+		ok = neighbor_set_insert(seen, w, 1.0f);
+		dst[i] = w;
+	}
+	return ok;
+}
 
-	graph *g = create_graph(n, is_directed);
-	if (!g)
-		return NULL;
+static int ws_chunk_edges(void *ctx, size_t chunk, edge_buffer *out,
+			  int worker)
+{
+	ws_job *job = ctx;
+	int *dst = malloc((size_t)job->half_k * sizeof(int));
+	int first = (int)(chunk * WS_NODES_PER_CHUNK);
+	int last = job->n - first < WS_NODES_PER_CHUNK
+	    ? job->n : first + WS_NODES_PER_CHUNK;
+	int ok = dst != NULL;
+	for (int u = first; ok && u < last; u++) {
+		ok = ws_rewire(job, u, dst, &job->seen[worker]);
+		for (int i = 0; ok && i < job->half_k; i++)
+			ok = buffer_push(out, u, dst[i]);
+	}
+	free(dst);
+	return ok;
+}
+
+int stream_watts_strogatz(int n, int k, float beta, int is_directed,
+			  uint64_t seed, edge_sink *sink)
+{
+	if (k % 2 != 0 || k < 0 || n < 0)
+		return 0;	// k must be even
+	if (!sink->begin(sink, n, is_directed))
+		return 0;
+	if (n == 0 || k == 0)
+		return sink->end(sink);
+
+	int workers = thread_pool_size();
+	ws_job job = { n, k / 2, is_directed, beta, seed,
+		calloc((size_t)workers, sizeof(neighbor_set))
+	};
+	// An edge rewired onto u by v while u rewired onto v is kept once
+	int ok = job.seen
+	    && stream_chunks(((size_t)n + WS_NODES_PER_CHUNK - 1)
+			     / WS_NODES_PER_CHUNK, ws_chunk_edges, &job, sink)
+	    && sink->end(sink);
+	for (int w = 0; job.seen && w < workers; w++)
+		neighbor_set_free(&job.seen[w]);
+	free(job.seen);
+	return ok;
+}
+
+// Barabási-Albert: every new node attaches to m distinct earlier nodes
+// picked with probability proportional to their degree. Each edge
+// appends both of its endpoints to one array, so a uniform pick from
+// that array is a degree-proportional pick of a node and the whole graph
+// takes O(n m) time.
+int stream_barabasi_albert(int n, int m, int is_directed, uint64_t seed,
+			   edge_sink *sink)
+{
+	if (m < 1 || m >= n)
+		return 0;
 
 	int m0 = m + 1;		// initial fully connected nodes count
+	size_t num_endpoints = (size_t)m0 * m + 2 * (size_t)(n - m0) * m;
+	int *endpoints = malloc(num_endpoints * sizeof(int));
+	int *picked_by = malloc(n * sizeof(int));	// last node to pick i
+	edge_buffer batch = { 0 };
+	int ok = endpoints && picked_by && sink->begin(sink, n, is_directed);
+	rng_state rng;
+	rng_seed(&rng, seed);
 
 	// Step 1: Fully connect initial m0 nodes
-	for (int u = 0; u < m0; u++) {
-		for (int v = u + 1; v < m0; v++) {
-			add_edge(g, u, v, 1.0f);
-			if (!is_directed)
-				add_edge(g, v, u, 1.0f);
+	size_t len = 0;
+	for (int u = 0; ok && u < m0; u++) {
+		for (int v = u + 1; ok && v < m0; v++) {
+			ok = buffer_push(&batch, u, v);
+			endpoints[len++] = u;
+			endpoints[len++] = v;
 		}
 	}
+	for (int i = 0; ok && i < n; i++)
+		picked_by[i] = -1;
 
-	// Step 2: Add new nodes with preferential attachment
-	for (int new_node = m0; new_node < n; new_node++) {
-		int *targets = malloc(m * sizeof(int));
-		if (!targets) {
-			free_graph(g);
-			return NULL;
+	// Step 2: Add new nodes with preferential attachment, rejecting
+	// repeated picks; at least m0 > m nodes have positive degree.
+	for (int new_node = m0; ok && new_node < n; new_node++) {
+		size_t earlier = len;
+		for (int count = 0; ok && count < m;) {
+			int t = endpoints[rng_below(&rng, earlier)];
+			if (picked_by[t] == new_node)
+				continue;
+			picked_by[t] = new_node;
+			ok = buffer_push(&batch, new_node, t);
+			endpoints[len++] = new_node;
+			endpoints[len++] = t;
+			count++;
 		}
+		ok = ok && buffer_flush(&batch, sink, 0);
+	}
+	ok = ok && buffer_flush(&batch, sink, 1) && sink->end(sink);
 
-		// Calculate total degree for probability distribution
-		int total_degree = 0;
-		for (int i = 0; i < new_node; i++) {
-			total_degree += get_degree(g, i);
-		}
+	buffer_free(&batch);
+	free(endpoints);
+	free(picked_by);
+	return ok;
+}
 
-		int count = 0;
-		while (count < m) {
-			int r = (int)get_urandom(0, (float)total_degree);
-			int sum = 0;
-			int selected = -1;
-			for (int i = 0; i < new_node; i++) {
-				sum += get_degree(g, i);
-				if (sum > r) {
-					selected = i;
-					break;
-				}
-			}
+// Configuration model: every node gets degrees[u] stubs, the stubs are
+// shuffled and paired up in order. Self-loops are dropped and the sinks
+// merge repeated edges (the "erased" configuration model). O(n + sum of
+// degrees).
+int stream_configuration_model(int n, const int *degrees, uint64_t seed,
+			       edge_sink *sink)
+{
+	if (n < 0)
+		return 0;
+	size_t num_stubs = 0;
+	for (int u = 0; u < n; u++)
+		num_stubs += degrees[u] > 0 ? (size_t)degrees[u] : 0;
+	if (num_stubs % 2)
+		return 0;	// the degrees must add up to an even number
+
+	int *stubs = malloc((num_stubs ? num_stubs : 1) * sizeof(int));
+	edge_buffer batch = { 0 };
+	int ok = stubs && sink->begin(sink, n, 0);
+	size_t len = 0;
+	for (int u = 0; ok && u < n; u++)
+		for (int d = 0; d < degrees[u]; d++)
+			stubs[len++] = u;
+
+	rng_state rng;
+	rng_seed(&rng, seed);
+	for (size_t i = len; ok && i > 1; i--) {
+		size_t j = (size_t)rng_below(&rng, i);
+		int t = stubs[i - 1];
+		stubs[i - 1] = stubs[j];
+		stubs[j] = t;
+	}
+	for (size_t i = 0; ok && i < len; i += 2) {
+		if (stubs[i] != stubs[i + 1])
+			ok = buffer_push(&batch, stubs[i], stubs[i + 1]);
+		ok = ok && buffer_flush(&batch, sink, 0);
+	}
+	ok = ok && buffer_flush(&batch, sink, 1) && sink->end(sink);
+
+	buffer_free(&batch);
+	free(stubs);
+	return ok;
+}
+
+// Random geometric graph in the unit square: the points are binned into
+// a grid of cells at least radius wide, so every edge joins a cell to
+// itself or to one of four forward neighbors (east, north-west, north,
+// north-east). O(n + m) expected time; one chunk per row of cells.
 
-			if (selected != -1
-			    && !contains(targets, count, selected)) {
-				targets[count++] = selected;
+typedef struct {
+	int cells;		// per side
+	const float *positions;
+	const int *cell_start;	// cells^2 + 1 entries
+	const int *cell_points;
+	float radius;
+} rgg_job;
+
+static int rgg_pair(const rgg_job *job, int i, int j, edge_buffer *out)
+{
+	float dx = job->positions[2 * i] - job->positions[2 * j];
+	float dy = job->positions[2 * i + 1] - job->positions[2 * j + 1];
+	if (dx * dx + dy * dy > job->radius * job->radius)
+		return 1;
+	return buffer_push(out, i, j);
+}
+
+static int rgg_chunk_edges(void *ctx, size_t chunk, edge_buffer *out,
+			   int worker)
+{
+	(void)worker;
+	static const int forward[4][2] = { {1, 0}, {-1, 1}, {0, 1}, {1, 1} };
+	rgg_job *job = ctx;
+	int g = job->cells, y = (int)chunk;
+	for (int x = 0; x < g; x++) {
+		int cell = y * g + x;
+		for (int a = job->cell_start[cell];
+		     a < job->cell_start[cell + 1]; a++) {
+			int i = job->cell_points[a];
+			for (int b = a + 1; b < job->cell_start[cell + 1]; b++)
+				if (!rgg_pair(job, i, job->cell_points[b], out))
+					return 0;
+			for (int f = 0; f < 4; f++) {
+				int nx = x + forward[f][0], ny = y + forward[f][1];
+				if (nx < 0 || nx >= g || ny >= g)
+					continue;
+				int other = ny * g + nx;
+				for (int b = job->cell_start[other];
+				     b < job->cell_start[other + 1]; b++)
+					if (!rgg_pair(job, i,
+						      job->cell_points[b], out))
+						return 0;
 			}
-			// else repeat pick
 		}
+	}
+	return 1;
+}
 
-		// Add edges from new node to selected targets
-		for (int j = 0; j < m; j++) {
-			int target = targets[j];
-			if (!is_connected(g, new_node, target)) {
-				add_edge(g, new_node, target, 1.0f);
-				if (!is_directed)
-					add_edge(g, target, new_node,
-						 1.0f);
-			}
+int stream_random_geometric(int n, float radius, uint64_t seed,
+			    float *positions, edge_sink *sink)
+{
+	if (n < 0 || !(radius >= 0.0f))
+		return 0;
+	// Cells no narrower than radius, and not many more than points
+	double per_side = radius > 0.0f ? floor(1.0 / radius) : INFINITY;
+	double cap = floor(sqrt((double)n)) + 1;
+	int cells = (int)(per_side < 1 ? 1 : per_side > cap ? cap : per_side);
+	size_t num_cells = (size_t)cells * cells;
+
+	float *own = positions ? NULL : malloc(2 * (n ? (size_t)n : 1)
+					       * sizeof(float));
+	int *cell_start = calloc(num_cells + 1, sizeof(int));
+	int *cell_points = malloc((n ? (size_t)n : 1) * sizeof(int));
+	int *cell_of = malloc((n ? (size_t)n : 1) * sizeof(int));
+	if (!positions)
+		positions = own;
+	int ok = positions && cell_start && cell_points && cell_of;
+
+	if (ok) {
+		rng_state rng;
+		rng_seed(&rng, seed);
+		for (int i = 0; i < n; i++) {
+			float x = (float)rng_uniform(&rng);
+			float y = (float)rng_uniform(&rng);
+			positions[2 * i] = x;
+			positions[2 * i + 1] = y;
+			int cx = (int)(x * cells), cy = (int)(y * cells);
+			cx = cx < cells ? cx : cells - 1;
+			cy = cy < cells ? cy : cells - 1;
+			cell_of[i] = cy * cells + cx;
+			cell_start[cell_of[i] + 1]++;
 		}
-		free(targets);
+		for (size_t c = 0; c < num_cells; c++)
+			cell_start[c + 1] += cell_start[c];
+		for (int i = 0; i < n; i++)
+			cell_points[cell_start[cell_of[i]]++] = i;
+		for (size_t c = num_cells; c > 0; c--)
+			cell_start[c] = cell_start[c - 1];
+		cell_start[0] = 0;
+	}
+
+	rgg_job job = { cells, positions, cell_start, cell_points, radius };
+	ok = ok && sink->begin(sink, n, 0)
+	    && stream_chunks((size_t)cells, rgg_chunk_edges, &job, sink)
+	    && sink->end(sink);
+
+	free(own);
+	free(cell_start);
+	free(cell_points);
+	free(cell_of);
+	return ok;
+}
+
+// Collects a finished stream from a csr_sink into the requested storage
+static graph *collect(csr_sink *s, int ok, graph_storage storage)
+{
+	graph *g = ok ? csr_sink_take(s) : NULL;
+	csr_sink_free(s);
+	if (g && storage != GRAPH_CSR && !graph_convert(g, storage)) {
+		free_graph(g);
+		g = NULL;
 	}
 	return g;
 }
+
+graph *generate_erdos_renyi_with_rng(int n, float p, int is_directed,
+				     graph_storage storage, rng_state *rng)
+{
+	csr_sink s;
+	csr_sink_init(&s, NULL);
+	int ok = stream_erdos_renyi(n, p, is_directed, rng_next(rng), &s.sink);
+	return collect(&s, ok, storage);
+}
+
+graph *generate_erdos_renyi(int n, float p, int is_directed,
+			    graph_storage storage)
+{
+	rng_state rng;
+	rng_seed(&rng, rng_seed_from_rand());
+	return generate_erdos_renyi_with_rng(n, p, is_directed, storage, &rng);
+}
+
+graph *generate_watts_strogatz_with_rng(int n, int k, float beta,
+					 int is_directed, graph_storage storage,
+					 rng_state *rng)
+{
+	csr_sink s;
+	csr_sink_init(&s, NULL);
+	int ok = stream_watts_strogatz(n, k, beta, is_directed, rng_next(rng),
+				       &s.sink);
+	return collect(&s, ok, storage);
+}
+
+graph *generate_watts_strogatz(int n, int k, float beta, int is_directed,
+				graph_storage storage)
+{
+	rng_state rng;
+	rng_seed(&rng, rng_seed_from_rand());
+	return generate_watts_strogatz_with_rng(n, k, beta, is_directed,
+						storage, &rng);
+}
+
+graph *generate_barabasi_albert_with_rng(int n, int m, int is_directed,
+					  graph_storage storage,
+					  rng_state *rng)
+{
+	csr_sink s;
+	csr_sink_init(&s, NULL);
+	int ok = stream_barabasi_albert(n, m, is_directed, rng_next(rng),
+					&s.sink);
+	return collect(&s, ok, storage);
+}
+
+graph *generate_barabasi_albert(int n, int m, int is_directed,
+				 graph_storage storage)
+{
+	rng_state rng;
+	rng_seed(&rng, rng_seed_from_rand());
+	return generate_barabasi_albert_with_rng(n, m, is_directed, storage,
+						 &rng);
+}
+
+graph *generate_stochastic_block_model(int num_blocks,
+				       const int *block_sizes,
+				       const float *probs, int is_directed,
+				       graph_storage storage, rng_state *rng)
+{
+	csr_sink s;
+	csr_sink_init(&s, NULL);
+	int ok = stream_stochastic_block_model(num_blocks, block_sizes, probs,
+					       is_directed, rng_next(rng),
+					       &s.sink);
+	return collect(&s, ok, storage);
+}
+
+graph *generate_configuration_model(int n, const int *degrees,
+				    graph_storage storage, rng_state *rng)
+{
+	csr_sink s;
+	csr_sink_init(&s, NULL);
+	int ok = stream_configuration_model(n, degrees, rng_next(rng),
+					    &s.sink);
+	return collect(&s, ok, storage);
+}
+
+graph *generate_random_geometric(int n, float radius, float *positions,
+				 graph_storage storage, rng_state *rng)
+{
+	csr_sink s;
+	csr_sink_init(&s, NULL);
+	int ok = stream_random_geometric(n, radius, rng_next(rng), positions,
+					 &s.sink);
+	return collect(&s, ok, storage);
+}
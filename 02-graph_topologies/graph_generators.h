@@ -2,15 +2,84 @@
 #define GRAPH_GENERATORS_H
 
 #include "../01-graph/graph.h"
+#include "../01-graph/edge_sink.h"
+#include "../11-helpers/rng.h"
 
-// Erdős-Rényi random graph generator
-graph *generate_erdos_renyi(int n, float p, int is_directed);
+// Every generator exists in two forms: stream_* writes its edges to an
+// edge_sink and returns 0 on invalid parameters or failure, generate_*
+// collects them into a graph of the given storage (NULL on failure).
+// A stream is fully determined by its seed and never depends on the
+// number of threads, so it can be replayed into a count_sink first.
 
-// Watts-Strogatz small-world network generator
-// k must be even
-graph *generate_watts_strogatz(int n, int k, float beta, int is_directed);
+// Erdős-Rényi random graph generator: every pair u != v (ordered if
+// directed) is an edge with probability p. O(n + m) expected time, built
+// in parallel without an n x n buffer unless storage is GRAPH_DENSE
+// (GRAPH_BITMATRIX holds n x n bits, 32 times less).
+// Draws its seed from rand().
+graph *generate_erdos_renyi(int n, float p, int is_directed,
+			    graph_storage storage);
+// Same, seeded by one draw from rng
+graph *generate_erdos_renyi_with_rng(int n, float p, int is_directed,
+				     graph_storage storage, rng_state * rng);
+int stream_erdos_renyi(int n, float p, int is_directed, uint64_t seed,
+		       edge_sink * sink);
 
-// Barabási-Albert scale-free network generator
-graph *generate_barabasi_albert(int n, int m, int is_directed);
+// Watts-Strogatz small-world network generator: a ring lattice linking
+// every node to its k/2 successors, each of these edges rewired with
+// probability beta. k must be even. O(n k) time, built in parallel.
+// Draws its seed from rand().
+graph *generate_watts_strogatz(int n, int k, float beta, int is_directed,
+				graph_storage storage);
+// Same, seeded by one draw from rng
+graph *generate_watts_strogatz_with_rng(int n, int k, float beta,
+					 int is_directed,
+					 graph_storage storage,
+					 rng_state * rng);
+int stream_watts_strogatz(int n, int k, float beta, int is_directed,
+			  uint64_t seed, edge_sink * sink);
+
+// Barabási-Albert scale-free network generator: m + 1 fully connected
+// seed nodes, then every new node links to m distinct earlier nodes with
+// probability proportional to their degree (in + out if directed).
+// Draws its seed from rand().
+graph *generate_barabasi_albert(int n, int m, int is_directed,
+				 graph_storage storage);
+// Same, seeded by one draw from rng
+graph *generate_barabasi_albert_with_rng(int n, int m, int is_directed,
+					  graph_storage storage,
+					  rng_state * rng);
+int stream_barabasi_albert(int n, int m, int is_directed, uint64_t seed,
+			   edge_sink * sink);
+
+// Stochastic block model: num_blocks consecutive blocks of block_sizes[b]
+// nodes; a node of block r links to a node of block s with probability
+// probs[r * num_blocks + s] (read for r <= s only if undirected).
+// O(n + m) expected time, in parallel.
+graph *generate_stochastic_block_model(int num_blocks,
+				       const int *block_sizes,
+				       const float *probs, int is_directed,
+				       graph_storage storage,
+				       rng_state * rng);
+int stream_stochastic_block_model(int num_blocks, const int *block_sizes,
+				  const float *probs, int is_directed,
+				  uint64_t seed, edge_sink * sink);
+
+// Undirected configuration model for the degree sequence degrees[0 .. n)
+// (its sum must be even): random stub matching with self-loops dropped
+// and multi-edges merged, so a few nodes can end up below their degree.
+// O(n + sum of degrees).
+graph *generate_configuration_model(int n, const int *degrees,
+				    graph_storage storage, rng_state * rng);
+int stream_configuration_model(int n, const int *degrees, uint64_t seed,
+			       edge_sink * sink);
+
+// Undirected random geometric graph: n uniform points in the unit square,
+// linked when at most radius apart. positions, if not NULL, receives the
+// 2n coordinates (x0, y0, x1, y1, ...). O(n + m) expected time, in
+// parallel.
+graph *generate_random_geometric(int n, float radius, float *positions,
+				 graph_storage storage, rng_state * rng);
+int stream_random_geometric(int n, float radius, uint64_t seed,
+			    float *positions, edge_sink * sink);
 
 #endif				// GRAPH_GENERATORS_H
@@ -295,16 +295,17 @@ void save_graph_as_image(graph *g, RGBColor *node_colors,
 	draw_cluster_hulls(cr, layout, node_sizes, clusters);
 	// Draw edges
 	for (size_t i = 0; i < n; i++) {
-		for (size_t j = i + 1; j < n; j++) {
+		for (neighbor_iter it = graph_neighbors(g, (int)i);
+		     neighbor_next(&it);) {
+			size_t j = (size_t)it.v;
 			int edge_idx = i * (int)n + (int)j;
-			if (g->edges[edge_idx] != 0) {
+			if (j > i) {
 				float r = edge_colors[edge_idx].r / 255.0f;
 				float g_col =
 				    edge_colors[edge_idx].g / 255.0f;
 				float b = edge_colors[edge_idx].b / 255.0f;
 
-				float bond_strength =
-				    1.0f - g->edge_weights[edge_idx];
+				float bond_strength = 1.0f - it.weight;
 				float edge_width =
 				    5.0f + bond_strength * (10.0f - 5.0f);
 
@@ -1,8 +1,11 @@
 #include "abstract_opinion_space.h"
+#include "discrete_opinion_space.h"
+#include "../01-graph/graph_reorder.h"
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
 #include <assert.h>
+#include <stdint.h>
 
 const void *default_get(const opinion_space *os, int idx)
 {
@@ -19,19 +22,11 @@ static bool default_set(opinion_space *os, int idx, const void *val)
 	return true;
 }
 
-static void *default_distance(const void *opinion1, const void *opinion2)
+static float default_distance(const void *opinion1, const void *opinion2)
 {
-	float *a = (float *)opinion1;
-	float *b = (float *)opinion2;
-
-	float diff = fabsf(*a - *b);
-
-	float *result = malloc(sizeof(float));
-	if (!result)
-		return NULL;
-
-	*result = diff;
-	return result;
+	const float *a = opinion1;
+	const float *b = opinion2;
+	return fabsf(*a - *b);
 }
 
 opinion_space *create_opinion_space(size_t num, size_t esize)
@@ -55,6 +50,42 @@ opinion_space *create_opinion_space(size_t num, size_t esize)
 	return os;
 }
 
+float *alloc_float_array(size_t n)
+{
+	size_t padded = (n + FLOAT_ARRAY_PAD - 1) / FLOAT_ARRAY_PAD
+	    * FLOAT_ARRAY_PAD;
+	void *array;
+	if (padded < n || padded > SIZE_MAX / sizeof(float)
+	    || posix_memalign(&array, FLOAT_ARRAY_ALIGN,
+			      (padded ? padded : FLOAT_ARRAY_PAD)
+			      * sizeof(float)) != 0)
+		return NULL;
+	memset(array, 0, padded * sizeof(float));
+	return array;
+}
+
+opinion_space *create_float_opinion_space(size_t num_agents)
+{
+	opinion_space *os = calloc(1, sizeof(opinion_space));
+	if (!os)
+		return NULL;
+	os->opinions = alloc_float_array(num_agents);
+	if (!os->opinions) {
+		free(os);
+		return NULL;
+	}
+
+	os->num_agents = num_agents;
+	os->element_size = sizeof(float);
+	os->type = OPINION_FLOAT;
+	os->dim = 1;
+	os->stride = num_agents;
+	os->get_opinion = default_get;
+	os->set_opinion = default_set;
+	os->get_distance = default_distance;
+	return os;
+}
+
 opinion_space *create_finite_domain_space(size_t num_agents,
 					  const void *domain_samples,
 					  size_t element_size,
@@ -77,10 +108,95 @@ opinion_space *create_finite_domain_space(size_t num_agents,
 	return os;
 }
 
+int permute_opinions(opinion_space *os, const int *new_id)
+{
+	size_t n = os->num_agents;
+	if (os->type == OPINION_DISCRETE)
+		return permute_discrete_opinions(os, new_id);
+	if (os->type != OPINION_VECTOR)
+		return permute_array(os->opinions, os->element_size, new_id,
+				     (int)n);
+
+	// One column at a time through a single buffer, so nothing can
+	// fail halfway
+	float *old = malloc((n ? n : 1) * sizeof(float));
+	if (!old)
+		return 0;
+	for (size_t t = 0; t < os->dim; t++) {
+		float *col = opinion_column(os, t);
+		memcpy(old, col, n * sizeof(float));
+		for (size_t i = 0; i < n; i++)
+			col[new_id[i]] = old[i];
+	}
+	free(old);
+	return 1;
+}
+
 void free_opinion_space(opinion_space *os)
 {
 	if (os) {
 		free(os->opinions);
+		free(os->scratch);
+		free(os->state_count);
 		free(os);
 	}
 }
+
+static void column_range(const float *op, size_t n, float *min, float *max)
+{
+	float lo = INFINITY, hi = -INFINITY;
+	for (size_t i = 0; i < n; i++) {
+		lo = op[i] < lo ? op[i] : lo;
+		hi = op[i] > hi ? op[i] : hi;
+	}
+	*min = lo;
+	*max = hi;
+}
+
+void float_opinion_range(const opinion_space *os, float *min, float *max)
+{
+	column_range(float_opinions(os), os->num_agents, min, max);
+}
+
+float opinion_spread(const opinion_space *os)
+{
+	float spread = 0.0f;
+	if (os->num_agents == 0)
+		return spread;
+	if (os->type == OPINION_DISCRETE)
+		return (float)(os->states_present - 1);
+	for (size_t t = 0; t < os->dim; t++) {
+		float lo, hi;
+		column_range(opinion_column(os, t), os->num_agents, &lo, &hi);
+		if (hi - lo > spread)
+			spread = hi - lo;
+	}
+	return spread;
+}
+
+float float_opinion_min(const opinion_space *os)
+{
+	const float *op = float_opinions(os);
+	float lo = INFINITY;
+	for (size_t i = 0; i < os->num_agents; i++)
+		lo = op[i] < lo ? op[i] : lo;
+	return lo;
+}
+
+float float_opinion_max(const opinion_space *os)
+{
+	const float *op = float_opinions(os);
+	float hi = -INFINITY;
+	for (size_t i = 0; i < os->num_agents; i++)
+		hi = op[i] > hi ? op[i] : hi;
+	return hi;
+}
+
+float float_opinion_mean(const opinion_space *os)
+{
+	const float *op = float_opinions(os);
+	double sum = 0.0;
+	for (size_t i = 0; i < os->num_agents; i++)
+		sum += op[i];
+	return os->num_agents ? (float)(sum / os->num_agents) : 0.0f;
+}
@@ -4,12 +4,45 @@
 #include "../01-graph/graph.h"
 #include <stddef.h>
 #include <stdbool.h>
+#include <math.h>
+
+// Element type of a space. The function pointers work for every space;
+// spaces of a known type also get the inline accessors and reductions
+// further down, which need neither calls nor casts per agent.
+typedef enum {
+	OPINION_GENERIC = 0,	// element_size bytes, known to the pointers only
+	OPINION_FLOAT,		// one float per agent
+	OPINION_VECTOR,		// dim floats per agent, see opinion_vector.h
+	OPINION_DISCRETE	// one of num_states, see discrete_opinion_space.h
+} opinion_type;
+
+// Distances between opinion vectors (of length 1 for float spaces)
+typedef enum {
+	OPINION_L1 = 0,		// sum of |a_t - b_t|: |a - b| for floats
+	OPINION_L2,		// Euclidean
+	OPINION_COSINE		// 1 - cos(a, b), 1 if either is 0
+} opinion_metric;
 
 typedef struct opinion_space {
-	// Core data storage
+	// Core data storage. Float and vector spaces keep their opinions as
+	// dim columns of stride floats: topic t of agent i is
+	// opinion_column(os, t)[i].
 	void *opinions;
 	size_t num_agents;
 	size_t element_size;
+	opinion_type type;
+	size_t dim;		// topics per agent, 0 for generic spaces
+	size_t stride;		// floats from one column to the next (words
+				// from one bit plane to the next if discrete)
+	opinion_metric metric;	// used by opinion_distance
+	float *scratch;		// vector and discrete spaces: get_opinion
+				// gathers here
+
+	// Discrete spaces: agents per state and how many states have any,
+	// kept up to date by set_discrete_opinion
+	unsigned num_states;
+	size_t *state_count;
+	unsigned states_present;
 
 	// Accessor method (const-safe)
 	const void *(*get_opinion)(const struct opinion_space * os,
@@ -19,8 +52,8 @@ typedef struct opinion_space {
 	bool (*set_opinion)(struct opinion_space * os, int index,
 			    const void *value);
 
-	// Distance metric (NULL for default Euclidean)
-	void *(*get_distance)(const void *opinion1, const void *opinion2);
+	// Distance metric, returned by value (default: |a - b| of floats)
+	float (*get_distance)(const void *opinion1, const void *opinion2);
 } opinion_space;
 
 // Memory management
@@ -29,7 +62,19 @@ void free_opinion_space(opinion_space * os);
 // Space creation functions
 opinion_space *create_opinion_space(size_t num_agents,
 				    size_t element_size);
+// OPINION_FLOAT space, every opinion 0. The array comes from
+// alloc_float_array.
+opinion_space *create_float_opinion_space(size_t num_agents);
+
+// n zeros, 64-byte aligned and padded to a multiple of 16 floats so that
+// SIMD loops need no peeling; free with free(). NULL if out of memory.
+#define FLOAT_ARRAY_ALIGN 64
+#define FLOAT_ARRAY_PAD 16
+float *alloc_float_array(size_t n);
 
+// Calls sampler once per agent, in order. For samplers that pick from a
+// finite set, create_space_from_samples (opinion_init.h) does the same in
+// parallel.
 opinion_space *create_finite_domain_space(size_t num_agents,
 					  const void *domain_samples,
 					  size_t element_size,
@@ -48,4 +93,82 @@ opinion_space *create_finite_domain_space(size_t num_agents,
     (os)->set_opinion((os), (index), &__tmp); \
 } while(0)
 
+// Float spaces (type OPINION_FLOAT): direct access to the opinion array
+
+static inline float *float_opinions(const opinion_space * os)
+{
+	return (float *)os->opinions;
+}
+
+static inline float get_float_opinion(const opinion_space * os, size_t i)
+{
+	return ((const float *)os->opinions)[i];
+}
+
+static inline void set_float_opinion(opinion_space * os, size_t i,
+				     float value)
+{
+	((float *)os->opinions)[i] = value;
+}
+
+// A float space over a caller's array of n opinions, for code that has a
+// bare float array but wants the batched functions of opinion_vector.h.
+// Not created by malloc: never pass it to free_opinion_space, and only
+// the typed helpers work on it (get_opinion and friends are NULL).
+static inline opinion_space float_opinion_view(float *opinions, size_t n)
+{
+	opinion_space view = { 0 };
+	view.opinions = opinions;
+	view.num_agents = n;
+	view.element_size = sizeof(float);
+	view.type = OPINION_FLOAT;
+	view.dim = 1;
+	view.stride = n;
+	return view;
+}
+
+// Column t of a float (t = 0) or vector space
+static inline float *opinion_column(const opinion_space * os, size_t t)
+{
+	return (float *)os->opinions + t * os->stride;
+}
+
+float opinion_vector_distance(const opinion_space * os, int i, int j);
+int discrete_opinion_distance(const opinion_space * os, int i, int j);
+
+// Distance between the opinions of agents i and j: inline for float
+// spaces, in os->metric for vector spaces, 0 or 1 (same state or not)
+// for discrete spaces, through get_distance for the others. Nothing to
+// free.
+static inline float opinion_distance(const opinion_space * os, int i, int j)
+{
+	if (os->type == OPINION_FLOAT)
+		return fabsf(get_float_opinion(os, (size_t)i)
+			     - get_float_opinion(os, (size_t)j));
+	if (os->type == OPINION_VECTOR)
+		return opinion_vector_distance(os, i, j);
+	if (os->type == OPINION_DISCRETE)
+		return (float)discrete_opinion_distance(os, i, j);
+	return os->get_distance(os->get_opinion(os, i),
+				os->get_opinion(os, j));
+}
+
+// Reductions over a float space. An empty space has min INFINITY, max
+// -INFINITY and mean 0. The mean is accumulated in double.
+float float_opinion_min(const opinion_space * os);
+float float_opinion_max(const opinion_space * os);
+float float_opinion_mean(const opinion_space * os);
+// Both bounds in one pass
+void float_opinion_range(const opinion_space * os, float *min, float *max);
+
+// Renumbers the agents, agent i becoming new_id[i], whatever the layout
+// of the space. Returns 0 (space unchanged) if out of memory.
+int permute_opinions(opinion_space * os, const int *new_id);
+
+// Largest max - min of any topic of a float or vector space, the
+// convergence measure of run_simulation. For a discrete space the number
+// of states present less one, 0 exactly at consensus, in O(1). 0 for an
+// empty space.
+float opinion_spread(const opinion_space * os);
+
 #endif				// OPINION_SPACE_H
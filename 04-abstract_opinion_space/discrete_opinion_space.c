@@ -0,0 +1,129 @@
+#include "discrete_opinion_space.h"
+#include "../01-graph/bit_matrix.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const void *discrete_get(const opinion_space *os, int idx)
+{
+	if (idx < 0 || (size_t)idx >= os->num_agents)
+		return NULL;
+	int *state = (int *)os->scratch;
+	*state = get_discrete_opinion(os, (size_t)idx);
+	return state;
+}
+
+static bool discrete_set(opinion_space *os, int idx, const void *value)
+{
+	int state = *(const int *)value;
+	if (idx < 0 || (size_t)idx >= os->num_agents || state < 0
+	    || (unsigned)state >= os->num_states)
+		return false;
+	set_discrete_opinion(os, (size_t)idx, state);
+	return true;
+}
+
+static float discrete_distance(const void *opinion1, const void *opinion2)
+{
+	return *(const int *)opinion1 != *(const int *)opinion2;
+}
+
+opinion_space *create_discrete_opinion_space(size_t num_agents,
+					     unsigned num_states)
+{
+	if (num_states < 2 || num_states > DISCRETE_MAX_STATES)
+		return NULL;
+	opinion_space *os = calloc(1, sizeof(opinion_space));
+	if (!os)
+		return NULL;
+	os->num_states = num_states;
+	os->stride = (num_agents + 63) / 64;
+	size_t words = discrete_num_planes(os) * os->stride;
+	os->opinions = calloc(words ? words : 1, sizeof(uint64_t));
+	os->state_count = calloc(num_states, sizeof(size_t));
+	// get_opinion returns an int from here
+	os->scratch = malloc(sizeof(int));
+	if (!os->opinions || !os->state_count || !os->scratch) {
+		free_opinion_space(os);
+		return NULL;
+	}
+
+	os->num_agents = num_agents;
+	os->element_size = sizeof(int);
+	os->type = OPINION_DISCRETE;
+	os->state_count[0] = num_agents;
+	os->states_present = num_agents > 0;
+	os->get_opinion = discrete_get;
+	os->set_opinion = discrete_set;
+	os->get_distance = discrete_distance;
+	return os;
+}
+
+int discrete_opinion_distance(const opinion_space *os, int i, int j)
+{
+	return get_discrete_opinion(os, (size_t)i)
+	    != get_discrete_opinion(os, (size_t)j);
+}
+
+// Agents of row word w whose state is s: the AND of every plane, taken
+// as is where s has a 1 bit and inverted where it has a 0
+static inline uint64_t state_mask(const opinion_space *os, unsigned planes,
+				  size_t w, unsigned s)
+{
+	uint64_t mask = ~(uint64_t)0;
+	for (unsigned p = 0; p < planes; p++) {
+		uint64_t bits = discrete_plane(os, p)[w];
+		mask &= (s >> p) & 1 ? bits : ~bits;
+	}
+	return mask;
+}
+
+void discrete_neighbor_counts(const opinion_space *os, graph *g, int u,
+			      size_t *count)
+{
+	unsigned planes = discrete_num_planes(os);
+	const uint64_t *row = graph_bit_row(g, u);
+	memset(count, 0, os->num_states * sizeof(size_t));
+
+	if (row && planes == 1) {
+		count[1] = bit_row_and_popcount(row, discrete_plane(os, 0),
+						g->row_words);
+		count[0] = bit_row_popcount(row, g->row_words) - count[1];
+		return;
+	}
+	if (row) {
+		for (size_t w = 0; w < g->row_words; w++) {
+			if (!row[w])
+				continue;
+			for (unsigned s = 0; s < os->num_states; s++)
+				count[s] += (size_t)
+				    __builtin_popcountll(row[w]
+							 & state_mask(os, planes,
+								      w, s));
+		}
+		return;
+	}
+	for (neighbor_iter it = graph_neighbors(g, u); neighbor_next(&it);)
+		count[get_discrete_opinion(os, (size_t)it.v)]++;
+}
+
+// The states are saved one byte per agent, then written back at their
+// new places; the counts do not change.
+int permute_discrete_opinions(opinion_space *os, const int *new_id)
+{
+	size_t n = os->num_agents;
+	unsigned char *state = malloc(n ? n : 1);
+	if (!state)
+		return 0;
+	for (size_t i = 0; i < n; i++)
+		state[i] = (unsigned char)get_discrete_opinion(os, i);
+	memset(os->opinions, 0,
+	       discrete_num_planes(os) * os->stride * sizeof(uint64_t));
+	for (size_t i = 0; i < n; i++) {
+		size_t j = (size_t)new_id[i];
+		for (unsigned p = 0; p < discrete_num_planes(os); p++)
+			discrete_plane(os, p)[j >> 6] |=
+			    (uint64_t)((state[i] >> p) & 1) << (j & 63);
+	}
+	free(state);
+	return 1;
+}
@@ -0,0 +1,81 @@
+#ifndef DISCRETE_OPINION_SPACE_H
+#define DISCRETE_OPINION_SPACE_H
+
+#include "abstract_opinion_space.h"
+#include <stdint.h>
+
+// Opinions that take one of num_states values 0 .. num_states - 1 (2 for
+// binary), stored as bit planes: plane p holds bit p of every agent's
+// state, 64 agents per word, so a binary space of a million agents is
+// 125 KB. The space counts the agents in each state as they change,
+// which makes the consensus test O(1). get_opinion gathers the state as
+// an int into a buffer of the space (not thread safe) and set_opinion
+// takes a const int *; the inline functions below are the fast path.
+
+// Discrete space with every agent in state 0. NULL if num_states is not
+// in 2 .. DISCRETE_MAX_STATES or out of memory.
+#define DISCRETE_MAX_STATES 256
+opinion_space *create_discrete_opinion_space(size_t num_agents,
+					     unsigned num_states);
+
+static inline opinion_space *create_binary_opinion_space(size_t num_agents)
+{
+	return create_discrete_opinion_space(num_agents, 2);
+}
+
+// Bit planes of a discrete space: ceil(log2(num_states)) of them, each
+// os->stride words long
+static inline unsigned discrete_num_planes(const opinion_space * os)
+{
+	return 32 - (unsigned)__builtin_clz(os->num_states - 1);
+}
+
+static inline uint64_t *discrete_plane(const opinion_space * os, unsigned p)
+{
+	return (uint64_t *) os->opinions + p * os->stride;
+}
+
+static inline int get_discrete_opinion(const opinion_space * os, size_t i)
+{
+	int state = 0;
+	for (unsigned p = 0; p < discrete_num_planes(os); p++)
+		state |= (int)((discrete_plane(os, p)[i >> 6] >> (i & 63)) & 1)
+		    << p;
+	return state;
+}
+
+// state must be below num_states
+static inline void set_discrete_opinion(opinion_space * os, size_t i,
+					int state)
+{
+	int old = get_discrete_opinion(os, i);
+	if (old == state)
+		return;
+	uint64_t bit = (uint64_t)1 << (i & 63);
+	for (unsigned p = 0; p < discrete_num_planes(os); p++) {
+		uint64_t *word = &discrete_plane(os, p)[i >> 6];
+		*word = (state >> p) & 1 ? *word | bit : *word & ~bit;
+	}
+	if (--os->state_count[old] == 0)
+		os->states_present--;
+	if (os->state_count[state]++ == 0)
+		os->states_present++;
+}
+
+// Every agent holds the same state (true for an empty space)
+static inline bool discrete_consensus(const opinion_space * os)
+{
+	return os->states_present <= 1;
+}
+
+// count[s] = out-neighbors of u in state s, for s < num_states. On bit
+// matrix storage a word of the adjacency row is matched against the bit
+// planes at once, 64 neighbors per AND and popcount; the other storages
+// look up each neighbor.
+void discrete_neighbor_counts(const opinion_space * os, graph * g, int u,
+			      size_t *count);
+
+// For permute_opinions
+int permute_discrete_opinions(opinion_space * os, const int *new_id);
+
+#endif				// DISCRETE_OPINION_SPACE_H
@@ -0,0 +1,69 @@
+#include "opinion_clusters.h"
+#include "opinion_vector.h"
+#include <stdlib.h>
+#include <math.h>
+
+int *bfs_cluster(int start, int n, const distance_matrix *distances,
+		 float *opinions, int *visited, float dist_thresh,
+		 float op_thresh)
+{
+	int *cluster = malloc((n + 1) * sizeof(int));
+	int *near = malloc(n * sizeof(int));
+	if (!cluster || !near) {
+		free(cluster);
+		free(near);
+		return NULL;
+	}
+	opinion_space view = float_opinion_view(opinions, n);
+	// opinion_within keeps d <= epsilon, the clusters want d < op_thresh
+	float epsilon = nextafterf(op_thresh, -INFINITY);
+	int front = 0, back = 0;
+	cluster[back++] = start;
+	visited[start] = 1;
+
+	while (front < back) {
+		int u = cluster[front++];
+		size_t count = opinion_within(&view, u, epsilon, OPINION_L1,
+					      near);
+		for (size_t k = 0; k < count; k++) {
+			int v = near[k];
+			if (visited[v])
+				continue;
+			if (distance_get(distances, u, v) < dist_thresh) {
+				visited[v] = 1;
+				cluster[back++] = v;
+			}
+		}
+	}
+
+	free(near);
+	cluster[back] = -1;	// sentinel
+	return cluster;
+}
+
+int count_opinion_clusters(const distance_matrix *distances,
+			   float *opinions, int n, float dist_thresh,
+			   float op_thresh)
+{
+	int *visited = calloc(n, sizeof(int));
+	int num_clusters = 0;
+	if (!visited)
+		return -1;
+
+	for (int i = 0; i < n; i++) {
+		if (!visited[i]) {
+			int *cluster =
+			    bfs_cluster(i, n, distances, opinions, visited,
+					dist_thresh, op_thresh);
+			if (!cluster) {
+				num_clusters = -1;
+				break;
+			}
+			free(cluster);
+			num_clusters++;
+		}
+	}
+
+	free(visited);
+	return num_clusters;
+}
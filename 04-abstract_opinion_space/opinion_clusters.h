@@ -0,0 +1,19 @@
+#ifndef OPINION_CLUSTERS_H
+#define OPINION_CLUSTERS_H
+
+#include "abstract_opinion_space.h"
+#include "../01-graph/distance_matrix.h"
+
+// Clusters of agents closer than dist_thresh in the network and than
+// op_thresh in opinion, grown breadth first. The opinion test is one
+// opinion_within query per dequeued agent.
+
+// The cluster of start, -1 terminated; marks its members in visited
+int *bfs_cluster(int start, int n, const distance_matrix * distances,
+		 float *opinions, int *visited, float dist_thresh,
+		 float op_thresh);
+int count_opinion_clusters(const distance_matrix * distances,
+			   float *opinions, int n, float dist_thresh,
+			   float op_thresh);
+
+#endif				// OPINION_CLUSTERS_H
@@ -0,0 +1,213 @@
+#include "opinion_init.h"
+#include "../11-helpers/rng_batch.h"
+#include "../11-helpers/thread_pool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Draws per refill of the proposal buffers
+#define BLOCK 1024
+
+typedef struct {
+	const opinion_distribution *dist;
+	uint64_t seed;
+	float *values;
+	size_t n;
+	// Truncated normal and bimodal: the centers of the components and
+	// whether to propose uniformly in [low, high] (narrow windows)
+	// rather than from the normals
+	float center[2];
+	int num_centers;
+	int uniform_proposal;
+	float density_bound;
+	// create_space_from_samples
+	const char *samples;
+	size_t num_samples;
+	size_t element_size;
+	char *out;
+} init_job;
+
+static float normal_cdf(float x)
+{
+	return 0.5f * erfcf(-x * 0.70710678f);
+}
+
+// Unnormalized density of the mixture at x
+static float mixture_density(const init_job *job, float x)
+{
+	float f = 0.0f, s = job->dist->stddev;
+	for (int k = 0; k < job->num_centers; k++) {
+		float z = (x - job->center[k]) / s;
+		f += expf(-0.5f * z * z);
+	}
+	return f;
+}
+
+static void fill_truncated(const init_job *job, rng_lanes *lanes,
+			   float *out, size_t count)
+{
+	const opinion_distribution *d = job->dist;
+	float draw[BLOCK], pick[BLOCK];
+	size_t done = 0;
+	while (done < count) {
+		if (job->uniform_proposal) {
+			rng_fill_uniform_float(lanes, draw, BLOCK);
+			rng_fill_uniform_float(lanes, pick, BLOCK);
+			for (int k = 0; k < BLOCK && done < count; k++) {
+				float x = d->low + (d->high - d->low) * draw[k];
+				if (pick[k] * job->density_bound
+				    < mixture_density(job, x))
+					out[done++] = x;
+			}
+			continue;
+		}
+		rng_fill_normal(lanes, draw, BLOCK, 0.0f, d->stddev);
+		if (job->num_centers > 1)
+			rng_fill_uniform_float(lanes, pick, BLOCK);
+		for (int k = 0; k < BLOCK && done < count; k++) {
+			float x = draw[k] + job->center[job->num_centers > 1
+							&& pick[k] >= 0.5f];
+			if (x >= d->low && x <= d->high)
+				out[done++] = x;
+		}
+	}
+}
+
+static void fill_chunks(void *ctx, size_t begin, size_t end, int worker)
+{
+	(void)worker;
+	init_job *job = ctx;
+	const opinion_distribution *d = job->dist;
+	rng_lanes lanes;
+	for (size_t chunk = begin; chunk < end; chunk++) {
+		size_t first = chunk * OPINION_INIT_CHUNK;
+		size_t count = job->n - first < OPINION_INIT_CHUNK
+		    ? job->n - first : OPINION_INIT_CHUNK;
+		float *out = job->values + first;
+		rng_lanes_seed(&lanes, job->seed, chunk);
+		if (d->kind == OPINION_DIST_UNIFORM) {
+			rng_fill_uniform_float(&lanes, out, count);
+			for (size_t k = 0; k < count; k++)
+				out[k] = d->low + (d->high - d->low) * out[k];
+		} else {
+			fill_truncated(job, &lanes, out, count);
+		}
+	}
+}
+
+static int read_values(float *values, size_t n, const char *path)
+{
+	FILE *file = path ? fopen(path, "r") : NULL;
+	if (!file)
+		return 0;
+	size_t k = 0;
+	while (k < n && fscanf(file, "%f", &values[k]) == 1)
+		k++;
+	fclose(file);
+	return k == n;
+}
+
+int fill_opinion_values(float *values, size_t n,
+			const opinion_distribution *dist, uint64_t seed)
+{
+	if (dist->kind == OPINION_DIST_FILE)
+		return read_values(values, n, dist->path);
+	if (!(dist->low <= dist->high))
+		return 0;
+
+	init_job job = { 0 };
+	job.dist = dist;
+	job.seed = seed;
+	job.values = values;
+	job.n = n;
+	if (dist->kind != OPINION_DIST_UNIFORM) {
+		if (!(dist->stddev > 0.0f))
+			return 0;
+		job.num_centers = dist->kind == OPINION_DIST_BIMODAL ? 2 : 1;
+		job.center[0] = dist->mean - (job.num_centers > 1
+					      ? dist->separation : 0.0f);
+		job.center[1] = dist->mean + dist->separation;
+		// Share of the normal draws that land in [low, high]: below
+		// a quarter, uniform proposals thinned by the density waste
+		// fewer draws
+		float mass = 0.0f, bound = 0.0f;
+		for (int k = 0; k < job.num_centers; k++) {
+			float c = job.center[k], s = dist->stddev;
+			mass += (normal_cdf((dist->high - c) / s)
+				 - normal_cdf((dist->low - c) / s))
+			    / job.num_centers;
+			// Density of the component at its point nearest to c
+			float near = c < dist->low ? dist->low
+			    : c > dist->high ? dist->high : c;
+			float z = (near - c) / s;
+			bound += expf(-0.5f * z * z);
+		}
+		if (!(mass > 0.0f) || !(bound > 0.0f))
+			return 0;
+		job.uniform_proposal = mass < 0.25f;
+		job.density_bound = bound;
+	}
+	parallel_for((n + OPINION_INIT_CHUNK - 1) / OPINION_INIT_CHUNK, 1,
+		     fill_chunks, &job);
+	return 1;
+}
+
+opinion_space *create_float_opinion_space_from(size_t num_agents,
+					       const opinion_distribution *dist,
+					       uint64_t seed)
+{
+	opinion_space *os = create_float_opinion_space(num_agents);
+	if (!os)
+		return NULL;
+	if (!fill_opinion_values(float_opinions(os), num_agents, dist, seed)) {
+		free_opinion_space(os);
+		return NULL;
+	}
+	return os;
+}
+
+static void sample_chunks(void *ctx, size_t begin, size_t end, int worker)
+{
+	(void)worker;
+	init_job *job = ctx;
+	rng_lanes lanes;
+	uint32_t pick[BLOCK];
+	for (size_t chunk = begin; chunk < end; chunk++) {
+		size_t first = chunk * OPINION_INIT_CHUNK;
+		size_t count = job->n - first < OPINION_INIT_CHUNK
+		    ? job->n - first : OPINION_INIT_CHUNK;
+		rng_lanes_seed(&lanes, job->seed, chunk);
+		for (size_t done = 0; done < count; done += BLOCK) {
+			size_t take = count - done < BLOCK ? count - done : BLOCK;
+			rng_fill_below(&lanes, pick, take,
+				       (uint32_t)job->num_samples);
+			for (size_t k = 0; k < take; k++)
+				memcpy(job->out + (first + done + k)
+				       * job->element_size,
+				       job->samples + pick[k] * job->element_size,
+				       job->element_size);
+		}
+	}
+}
+
+opinion_space *create_space_from_samples(size_t num_agents,
+					 const void *samples,
+					 size_t num_samples,
+					 size_t element_size, uint64_t seed)
+{
+	if (!samples || num_samples == 0 || num_samples > UINT32_MAX)
+		return NULL;
+	opinion_space *os = create_opinion_space(num_agents, element_size);
+	if (!os)
+		return NULL;
+	init_job job = { 0 };
+	job.seed = seed;
+	job.n = num_agents;
+	job.samples = samples;
+	job.num_samples = num_samples;
+	job.element_size = element_size;
+	job.out = os->opinions;
+	parallel_for((num_agents + OPINION_INIT_CHUNK - 1) / OPINION_INIT_CHUNK,
+		     1, sample_chunks, &job);
+	return os;
+}
@@ -0,0 +1,57 @@
+#ifndef OPINION_INIT_H
+#define OPINION_INIT_H
+
+#include "abstract_opinion_space.h"
+#include <stdint.h>
+
+// Bulk initial values for opinions and per-agent attributes. The agents
+// are cut into chunks of OPINION_INIT_CHUNK that are filled in parallel,
+// chunk c drawing from stream c of the seed (see rng_batch.h): the values
+// depend on the seed only, not on the number of threads.
+
+#define OPINION_INIT_CHUNK 65536
+
+typedef enum {
+	OPINION_DIST_UNIFORM = 0,	// uniform in [low, high)
+	OPINION_DIST_TRUNCATED_NORMAL,	// normal(mean, stddev) in [low, high]
+	OPINION_DIST_BIMODAL,		// equal mix of normal(mean -+
+					// separation, stddev) in [low, high]
+	OPINION_DIST_FILE		// the first n numbers of path
+} opinion_dist_kind;
+
+typedef struct {
+	opinion_dist_kind kind;
+	float low, high;
+	float mean, stddev;
+	float separation;
+	const char *path;	// whitespace separated numbers
+} opinion_distribution;
+
+static inline opinion_distribution opinion_uniform(float low, float high)
+{
+	opinion_distribution d = { OPINION_DIST_UNIFORM, low, high,
+		0.0f, 0.0f, 0.0f, NULL
+	};
+	return d;
+}
+
+// values[0 .. n) from dist. Returns 0 if the parameters make no sense
+// (low > high, stddev <= 0, no mass in [low, high]) or the file cannot
+// be read or holds fewer than n numbers.
+int fill_opinion_values(float *values, size_t n,
+			const opinion_distribution * dist, uint64_t seed);
+
+// OPINION_FLOAT space filled from dist, NULL on failure
+opinion_space *create_float_opinion_space_from(size_t num_agents,
+					       const opinion_distribution *
+					       dist, uint64_t seed);
+
+// Every agent gets a copy of one of the num_samples elements of samples,
+// picked uniformly: the bulk counterpart of create_finite_domain_space
+// for samplers that draw from a finite domain.
+opinion_space *create_space_from_samples(size_t num_agents,
+					 const void *samples,
+					 size_t num_samples,
+					 size_t element_size, uint64_t seed);
+
+#endif				// OPINION_INIT_H
@@ -0,0 +1,466 @@
+#include "opinion_vector.h"
+#include "../11-helpers/cpu_features.h"
+#include "../11-helpers/thread_pool.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_KERNELS 1
+#endif
+
+#define COLUMN_ALIGN 64
+#define COLUMN_PAD 16		// floats per 64 bytes
+// Agents per tile of the batched distances: the tile of sums (and of
+// norms for the cosine) stays in L1 while every column passes over it.
+#define TILE 1024
+// Rows per task of opinion_pairwise_distances; they share each column
+// tile while it is in cache.
+#define ROWS_PER_TASK 16
+// Shorter one-vs-all rows are not worth waking the pool
+#define PARALLEL_MIN (64 * TILE)
+
+static const void *vector_get(const opinion_space *os, int idx)
+{
+	if (idx < 0 || (size_t)idx >= os->num_agents)
+		return NULL;
+	for (size_t t = 0; t < os->dim; t++)
+		os->scratch[t] = opinion_column(os, t)[idx];
+	return os->scratch;
+}
+
+static bool vector_set(opinion_space *os, int idx, const void *value)
+{
+	if (idx < 0 || (size_t)idx >= os->num_agents)
+		return false;
+	const float *v = value;
+	for (size_t t = 0; t < os->dim; t++)
+		opinion_column(os, t)[idx] = v[t];
+	return true;
+}
+
+opinion_space *create_vector_opinion_space(size_t num_agents, size_t dim,
+					   opinion_metric metric)
+{
+	size_t stride = (num_agents + COLUMN_PAD - 1) / COLUMN_PAD * COLUMN_PAD;
+	if (dim == 0 || (stride && dim > SIZE_MAX / sizeof(float) / stride))
+		return NULL;
+	size_t bytes = dim * stride * sizeof(float);
+
+	opinion_space *os = calloc(1, sizeof(opinion_space));
+	if (!os)
+		return NULL;
+	os->scratch = malloc(dim * sizeof(float));
+	if (!os->scratch
+	    || posix_memalign(&os->opinions, COLUMN_ALIGN,
+			      bytes ? bytes : COLUMN_ALIGN) != 0) {
+		free(os->scratch);
+		free(os);
+		return NULL;
+	}
+	memset(os->opinions, 0, bytes);
+
+	os->num_agents = num_agents;
+	os->element_size = dim * sizeof(float);
+	os->type = OPINION_VECTOR;
+	os->dim = dim;
+	os->stride = stride;
+	os->metric = metric;
+	os->get_opinion = vector_get;
+	os->set_opinion = vector_set;
+	// A pair of bare pointers does not say how long the vectors are:
+	// vector distances go through opinion_distance.
+	os->get_distance = NULL;
+	return os;
+}
+
+static float finish(opinion_metric metric, float sum, float norm_i,
+		    float norm_j)
+{
+	switch (metric) {
+	case OPINION_L2:
+		return sqrtf(sum);
+	case OPINION_COSINE:
+		if (!(norm_i * norm_j > 0.0f))
+			return 1.0f;
+		float d = 1.0f - sum / sqrtf(norm_i * norm_j);
+		return d > 0.0f ? d : 0.0f;
+	default:
+		return sum;
+	}
+}
+
+float opinion_vector_distance(const opinion_space *os, int i, int j)
+{
+	float sum = 0.0f, norm_i = 0.0f, norm_j = 0.0f;
+	for (size_t t = 0; t < os->dim; t++) {
+		const float *col = opinion_column(os, t);
+		float a = col[i], b = col[j];
+		switch (os->metric) {
+		case OPINION_L1:
+			sum += fabsf(a - b);
+			break;
+		case OPINION_L2:
+			sum += (a - b) * (a - b);
+			break;
+		case OPINION_COSINE:
+			sum += a * b;
+			norm_i += a * a;
+			norm_j += b * b;
+			break;
+		}
+	}
+	return finish(os->metric, sum, norm_i, norm_j);
+}
+
+// Per column: sum[k] += |x[k] - c|, (x[k] - c)^2, or x[k] * c together
+// with norm[k] += x[k]^2
+
+static void add_abs_diff(float *sum, const float *x, float c, size_t n)
+{
+	for (size_t k = 0; k < n; k++)
+		sum[k] += fabsf(x[k] - c);
+}
+
+static void add_sq_diff(float *sum, const float *x, float c, size_t n)
+{
+	for (size_t k = 0; k < n; k++)
+		sum[k] += (x[k] - c) * (x[k] - c);
+}
+
+static void add_dot(float *sum, float *norm, const float *x, float c,
+		    size_t n)
+{
+	for (size_t k = 0; k < n; k++) {
+		sum[k] += x[k] * c;
+		norm[k] += x[k] * x[k];
+	}
+}
+
+#ifdef HAVE_X86_KERNELS
+__attribute__((target("avx2,fma")))
+static void add_abs_diff_avx2(float *sum, const float *x, float c, size_t n)
+{
+	const __m256 sign = _mm256_set1_ps(-0.0f);
+	const __m256 vc = _mm256_set1_ps(c);
+	size_t k = 0;
+	for (; k + 8 <= n; k += 8) {
+		__m256 d = _mm256_sub_ps(_mm256_loadu_ps(x + k), vc);
+		_mm256_storeu_ps(sum + k,
+				 _mm256_add_ps(_mm256_loadu_ps(sum + k),
+					       _mm256_andnot_ps(sign, d)));
+	}
+	add_abs_diff(sum + k, x + k, c, n - k);
+}
+
+__attribute__((target("avx2,fma")))
+static void add_sq_diff_avx2(float *sum, const float *x, float c, size_t n)
+{
+	const __m256 vc = _mm256_set1_ps(c);
+	size_t k = 0;
+	for (; k + 8 <= n; k += 8) {
+		__m256 d = _mm256_sub_ps(_mm256_loadu_ps(x + k), vc);
+		_mm256_storeu_ps(sum + k, _mm256_fmadd_ps(d, d,
+							  _mm256_loadu_ps(sum +
+									  k)));
+	}
+	add_sq_diff(sum + k, x + k, c, n - k);
+}
+
+__attribute__((target("avx2,fma")))
+static void add_dot_avx2(float *sum, float *norm, const float *x, float c,
+			 size_t n)
+{
+	const __m256 vc = _mm256_set1_ps(c);
+	size_t k = 0;
+	for (; k + 8 <= n; k += 8) {
+		__m256 v = _mm256_loadu_ps(x + k);
+		_mm256_storeu_ps(sum + k, _mm256_fmadd_ps(v, vc,
+							  _mm256_loadu_ps(sum +
+									  k)));
+		_mm256_storeu_ps(norm + k,
+				 _mm256_fmadd_ps(v, v,
+						 _mm256_loadu_ps(norm + k)));
+	}
+	add_dot(sum + k, norm + k, x + k, c, n - k);
+}
+
+// AVX-512 handles the tail with a mask instead of a scalar loop
+
+__attribute__((target("avx512f")))
+static void add_abs_diff_avx512(float *sum, const float *x, float c,
+				size_t n)
+{
+	const __m512 vc = _mm512_set1_ps(c);
+	for (size_t k = 0; k < n; k += 16) {
+		__mmask16 m = n - k >= 16 ? 0xffff
+		    : (__mmask16) ((1u << (n - k)) - 1);
+		__m512 d = _mm512_sub_ps(_mm512_maskz_loadu_ps(m, x + k), vc);
+		_mm512_mask_storeu_ps(sum + k, m,
+				      _mm512_add_ps(_mm512_maskz_loadu_ps
+						    (m, sum + k),
+						    _mm512_abs_ps(d)));
+	}
+}
+
+__attribute__((target("avx512f")))
+static void add_sq_diff_avx512(float *sum, const float *x, float c,
+			       size_t n)
+{
+	const __m512 vc = _mm512_set1_ps(c);
+	for (size_t k = 0; k < n; k += 16) {
+		__mmask16 m = n - k >= 16 ? 0xffff
+		    : (__mmask16) ((1u << (n - k)) - 1);
+		__m512 d = _mm512_sub_ps(_mm512_maskz_loadu_ps(m, x + k), vc);
+		_mm512_mask_storeu_ps(sum + k, m,
+				      _mm512_fmadd_ps(d, d,
+						      _mm512_maskz_loadu_ps
+						      (m, sum + k)));
+	}
+}
+
+__attribute__((target("avx512f")))
+static void add_dot_avx512(float *sum, float *norm, const float *x,
+			   float c, size_t n)
+{
+	const __m512 vc = _mm512_set1_ps(c);
+	for (size_t k = 0; k < n; k += 16) {
+		__mmask16 m = n - k >= 16 ? 0xffff
+		    : (__mmask16) ((1u << (n - k)) - 1);
+		__m512 v = _mm512_maskz_loadu_ps(m, x + k);
+		_mm512_mask_storeu_ps(sum + k, m,
+				      _mm512_fmadd_ps(v, vc,
+						      _mm512_maskz_loadu_ps
+						      (m, sum + k)));
+		_mm512_mask_storeu_ps(norm + k, m,
+				      _mm512_fmadd_ps(v, v,
+						      _mm512_maskz_loadu_ps
+						      (m, norm + k)));
+	}
+}
+#endif
+
+static void add_column(opinion_metric metric, simd_isa isa, float *sum,
+		       float *norm, const float *x, float c, size_t n)
+{
+	(void)isa;
+	switch (metric) {
+	case OPINION_L1:
+#ifdef HAVE_X86_KERNELS
+		if (isa >= SIMD_AVX512)
+			add_abs_diff_avx512(sum, x, c, n);
+		else if (isa >= SIMD_AVX2)
+			add_abs_diff_avx2(sum, x, c, n);
+		else
+#endif
+			add_abs_diff(sum, x, c, n);
+		break;
+	case OPINION_L2:
+#ifdef HAVE_X86_KERNELS
+		if (isa >= SIMD_AVX512)
+			add_sq_diff_avx512(sum, x, c, n);
+		else if (isa >= SIMD_AVX2)
+			add_sq_diff_avx2(sum, x, c, n);
+		else
+#endif
+			add_sq_diff(sum, x, c, n);
+		break;
+	case OPINION_COSINE:
+#ifdef HAVE_X86_KERNELS
+		if (isa >= SIMD_AVX512)
+			add_dot_avx512(sum, norm, x, c, n);
+		else if (isa >= SIMD_AVX2)
+			add_dot_avx2(sum, norm, x, c, n);
+		else
+#endif
+			add_dot(sum, norm, x, c, n);
+		break;
+	}
+}
+
+static float squared_norm(const opinion_space *os, size_t i)
+{
+	float norm = 0.0f;
+	for (size_t t = 0; t < os->dim; t++) {
+		float c = opinion_column(os, t)[i];
+		norm += c * c;
+	}
+	return norm;
+}
+
+// Distances from agent i to the agents begin .. begin + n - 1, n <= TILE,
+// or to index[0 .. n) when index is set
+static void distance_tile(const opinion_space *os, size_t i, size_t begin,
+			  const int *index, size_t n, opinion_metric metric,
+			  float norm_i, float *sum)
+{
+	simd_isa isa = cpu_simd_isa();
+	float norm[TILE];
+	float gathered[TILE];
+	memset(sum, 0, n * sizeof(float));
+	if (metric == OPINION_COSINE)
+		memset(norm, 0, n * sizeof(float));
+	for (size_t t = 0; t < os->dim; t++) {
+		const float *col = opinion_column(os, t);
+		const float *x = col + begin;
+		if (index) {
+			for (size_t k = 0; k < n; k++)
+				gathered[k] = col[index[k]];
+			x = gathered;
+		}
+		add_column(metric, isa, sum, norm, x, col[i], n);
+	}
+	if (metric != OPINION_L1)
+		for (size_t k = 0; k < n; k++)
+			sum[k] = finish(metric, sum[k], norm_i,
+					metric == OPINION_COSINE
+					? norm[k] : 0.0f);
+}
+
+typedef struct {
+	const opinion_space *os;
+	size_t i;
+	size_t begin;
+	size_t end;
+	opinion_metric metric;
+	float norm_i;
+	float *out;
+} row_job;
+
+static void row_tiles(void *ctx, size_t first, size_t last, int worker)
+{
+	(void)worker;
+	row_job *job = ctx;
+	for (size_t tile = first; tile < last; tile++) {
+		size_t from = job->begin + tile * TILE;
+		size_t n = job->end - from < TILE ? job->end - from : TILE;
+		distance_tile(job->os, job->i, from, NULL, n, job->metric,
+			      job->norm_i, job->out + (from - job->begin));
+	}
+}
+
+void opinion_distances_to(const opinion_space *os, int i, size_t begin,
+			  size_t end, opinion_metric metric, float *out)
+{
+	if (end <= begin)
+		return;
+	row_job job = { os, (size_t)i, begin, end, metric,
+		metric == OPINION_COSINE ? squared_norm(os, i) : 0.0f, out
+	};
+	size_t tiles = (end - begin + TILE - 1) / TILE;
+	if ((end - begin) * os->dim < PARALLEL_MIN)
+		row_tiles(&job, 0, tiles, 0);
+	else
+		parallel_for(tiles, 1, row_tiles, &job);
+}
+
+void opinion_distances_to_set(const opinion_space *os, int i,
+			      const int *index, size_t count,
+			      opinion_metric metric, float *out)
+{
+	float norm_i = metric == OPINION_COSINE ? squared_norm(os, i) : 0.0f;
+	for (size_t k = 0; k < count; k += TILE)
+		distance_tile(os, i, 0, index + k,
+			      count - k < TILE ? count - k : TILE, metric,
+			      norm_i, out + k);
+}
+
+typedef struct {
+	const opinion_space *os;
+	opinion_metric metric;
+	float *out;
+} pairwise_job;
+
+// Rows [first, last) of the matrix: each column tile is loaded once for
+// the whole block of rows
+static void pairwise_rows(void *ctx, size_t first, size_t last, int worker)
+{
+	(void)worker;
+	pairwise_job *job = ctx;
+	const opinion_space *os = job->os;
+	size_t n = os->num_agents;
+	float norm_i[ROWS_PER_TASK];
+	for (size_t r = first; r < last; r += ROWS_PER_TASK) {
+		size_t rows = last - r < ROWS_PER_TASK ? last - r
+		    : ROWS_PER_TASK;
+		for (size_t k = 0; k < rows; k++)
+			norm_i[k] = job->metric == OPINION_COSINE
+			    ? squared_norm(os, r + k) : 0.0f;
+		for (size_t from = 0; from < n; from += TILE) {
+			size_t width = n - from < TILE ? n - from : TILE;
+			for (size_t k = 0; k < rows; k++)
+				distance_tile(os, r + k, from, NULL, width,
+					      job->metric, norm_i[k],
+					      job->out + (r + k) * n + from);
+		}
+	}
+}
+
+void opinion_pairwise_distances(const opinion_space *os,
+				opinion_metric metric, float *out)
+{
+	pairwise_job job = { os, metric, out };
+	parallel_for(os->num_agents, ROWS_PER_TASK, pairwise_rows, &job);
+}
+
+typedef struct {
+	const opinion_space *os;
+	size_t i;
+	float epsilon;
+	opinion_metric metric;
+	float norm_i;
+	int *out;
+	size_t *found;		// matches per tile
+} within_job;
+
+// Matches of tile k go to out + k * TILE, compacted afterwards
+static void within_tiles(void *ctx, size_t first, size_t last, int worker)
+{
+	(void)worker;
+	within_job *job = ctx;
+	float dist[TILE];
+	for (size_t tile = first; tile < last; tile++) {
+		size_t from = tile * TILE;
+		size_t n = job->os->num_agents - from < TILE
+		    ? job->os->num_agents - from : TILE;
+		distance_tile(job->os, job->i, from, NULL, n, job->metric,
+			      job->norm_i, dist);
+		int *out = job->out + from;
+		size_t found = 0;
+		for (size_t k = 0; k < n; k++) {
+			out[found] = (int)(from + k);
+			found += dist[k] <= job->epsilon;
+		}
+		job->found[tile] = found;
+	}
+}
+
+size_t opinion_within(const opinion_space *os, int i, float epsilon,
+		      opinion_metric metric, int *out)
+{
+	size_t n = os->num_agents;
+	size_t tiles = (n + TILE - 1) / TILE;
+	size_t found_stack[64];
+	size_t *found = tiles <= 64 ? found_stack
+	    : malloc(tiles * sizeof(size_t));
+	if (!found)
+		return 0;
+	within_job job = { os, (size_t)i, epsilon, metric,
+		metric == OPINION_COSINE ? squared_norm(os, i) : 0.0f, out,
+		found
+	};
+	if (n * os->dim < PARALLEL_MIN)
+		within_tiles(&job, 0, tiles, 0);
+	else
+		parallel_for(tiles, 1, within_tiles, &job);
+
+	size_t count = 0;
+	for (size_t tile = 0; tile < tiles; tile++) {
+		memmove(out + count, out + tile * TILE,
+			found[tile] * sizeof(int));
+		count += found[tile];
+	}
+	if (found != found_stack)
+		free(found);
+	return count;
+}
@@ -0,0 +1,43 @@
+#ifndef OPINION_VECTOR_H
+#define OPINION_VECTOR_H
+
+#include "abstract_opinion_space.h"
+
+// d-dimensional opinions (one per topic) stored as structure of arrays:
+// dim columns of num_agents floats, each 64-byte aligned and padded to
+// a multiple of 16 floats, so that a topic of consecutive agents is one
+// run of SIMD loads. get_opinion/set_opinion still work with the dim
+// floats of an agent side by side (get_opinion gathers into a buffer of
+// the space and is not thread safe); bulk code uses opinion_column.
+
+// Vector space of num_agents x dim zeros with the given distance metric.
+// NULL if dim is 0 or out of memory.
+opinion_space *create_vector_opinion_space(size_t num_agents, size_t dim,
+					   opinion_metric metric);
+
+// Batched distances. They work on float spaces too (dim 1, where L1 and
+// L2 are |a - b|), walk the columns in tiles that stay in L1, use
+// AVX2/AVX-512 when the CPU has it (see cpu_features.h) and split large
+// jobs over the thread pool.
+
+// out[k] = distance between agents i and begin + k for k < end - begin
+void opinion_distances_to(const opinion_space * os, int i, size_t begin,
+			  size_t end, opinion_metric metric, float *out);
+
+// out[k] = distance between agents i and index[k] for k < count
+void opinion_distances_to_set(const opinion_space * os, int i,
+			      const int *index, size_t count,
+			      opinion_metric metric, float *out);
+
+// Every pair: out[i * n + j] for n agents, filled by blocks of rows
+// against tiles of columns.
+void opinion_pairwise_distances(const opinion_space * os,
+				opinion_metric metric, float *out);
+
+// The agents j (i included) at distance <= epsilon from agent i, in
+// increasing order. out must have room for num_agents indices; returns
+// how many were written.
+size_t opinion_within(const opinion_space * os, int i, float epsilon,
+		      opinion_metric metric, int *out);
+
+#endif				// OPINION_VECTOR_H
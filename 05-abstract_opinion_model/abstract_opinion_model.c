@@ -18,6 +18,10 @@ opinion_model *create_model(graph *network,
 	model->opinion_space = opinion_space;
 	model->params = params;	// just store the pointer, no copy
 	model->update = update_fn;
+	rng_seed(&model->rng, rng_seed_from_rand());
+	model->permute_params = NULL;
+	model->original_id = NULL;
+	model->current_id = NULL;
 	return model;
 }
 
@@ -25,5 +29,67 @@ void free_model(opinion_model *model)
 {
 	if (!model)
 		return;
+	free(model->original_id);
+	free(model->current_id);
 	free(model);
 }
+
+// Applies one renumbering to the network, the opinions and the params,
+// in that order; a failed step is undone with the inverse.
+static int permute_model(opinion_model *model, const int *new_id,
+			 const int *old_id)
+{
+	opinion_space *os = model->opinion_space;
+
+	if (!graph_permute(model->network, new_id))
+		return 0;
+	if (!permute_opinions(os, new_id))
+		goto undo_graph;
+	if (model->permute_params && !model->permute_params(model, new_id))
+		goto undo_opinions;
+	return 1;
+
+undo_opinions:
+	permute_opinions(os, old_id);
+undo_graph:
+	graph_permute(model->network, old_id);
+	return 0;
+}
+
+int reorder_model(opinion_model *model, node_order order)
+{
+	int n = model->network->num_nodes;
+	if ((size_t)n != model->opinion_space->num_agents)
+		return 0;
+
+	int *new_id = graph_node_order(model->network, order);
+	int *old_id = new_id ? invert_permutation(new_id, n) : NULL;
+	int *original_id = malloc((n > 0 ? (size_t)n : 1) * sizeof(int));
+	int *current_id = NULL;
+	int ok = 0;
+	if (!new_id || !old_id || !original_id)
+		goto cleanup;
+
+	// Compose with an earlier reordering: node a was old_id[a] before
+	// this one, and that node came from original_id[old_id[a]].
+	for (int a = 0; a < n; a++)
+		original_id[a] = model->original_id
+		    ? model->original_id[old_id[a]] : old_id[a];
+	current_id = invert_permutation(original_id, n);
+	if (!current_id || !permute_model(model, new_id, old_id))
+		goto cleanup;
+
+	free(model->original_id);
+	free(model->current_id);
+	model->original_id = original_id;
+	model->current_id = current_id;
+	original_id = current_id = NULL;
+	ok = 1;
+
+cleanup:
+	free(new_id);
+	free(old_id);
+	free(original_id);
+	free(current_id);
+	return ok;
+}
@@ -2,7 +2,9 @@
 #define OPINION_MODEL_H
 
 #include "../01-graph/graph.h"
+#include "../01-graph/graph_reorder.h"
 #include "../04-abstract_opinion_space/abstract_opinion_space.h"
+#include "../11-helpers/rng.h"
 #include <stddef.h>
 
 typedef struct opinion_model {
@@ -10,9 +12,21 @@ typedef struct opinion_model {
 	opinion_space *opinion_space;
 	void *params;		// Pointer to a block of memory holding model parameters/ Size of the params block in bytes
 	void (*update)(struct opinion_model * model);	// Model-specific update function
+	// The model's own random stream: update draws only from here, so a
+	// run is repeatable from the seed and models never share state.
+	rng_state rng;
+	// Optional: renumbers the per-node data in params, node i becoming
+	// new_id[i]. Returns 0 (params unchanged) if out of memory.
+	int (*permute_params)(struct opinion_model * model, const int *new_id);
+	// After reorder_model: original_id[i] is the id node i had when the
+	// model was created and current_id the inverse. NULL before.
+	int *original_id;
+	int *current_id;
 } opinion_model;
 
 // Create model - params pointer is copied, ownership stays with caller (or you can copy inside)
+// The model's rng is seeded from rand(); reseed it with rng_seed_run for
+// reproducible ensembles.
 opinion_model *create_model(graph * network,
 			    opinion_space * opinion_space,
 			    void *params,
@@ -20,4 +34,10 @@ opinion_model *create_model(graph * network,
     );
 
 void free_model(opinion_model * model);
+
+// Renumbers the nodes of the network, the opinions and the params
+// consistently for better memory locality, see graph_reorder.h. Output
+// written by write_current_state keeps the original ids. Returns 0
+// (model unchanged) if out of memory.
+int reorder_model(opinion_model * model, node_order order);
 #endif				// OPINION_MODEL_H
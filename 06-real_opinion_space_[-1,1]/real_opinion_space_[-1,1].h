@@ -2,6 +2,7 @@
 #define REAL_OPINION_SPACE_H
 
 #include "../04-abstract_opinion_space/abstract_opinion_space.h"
+#include "../11-helpers/rng.h"
 #include <stdlib.h>
 #include <math.h>
 #include <time.h>
@@ -9,7 +10,10 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <stdint.h>
-// Creates an opinion_space of floats ∈ [-1, 1], uniformly sampled
+// Creates an opinion_space of floats ∈ [-1, 1], uniformly sampled in
+// parallel chunks (see opinion_init.h) from a seed drawn from rng, or
+// from a generator seeded by rand() when rng is NULL
 opinion_space *create_opinions_in_real_ball_of_radius_one(size_t
-							  num_agents);
+							  num_agents,
+							  rng_state * rng);
 #endif				// REAL_OPINION_SPACE_H
@@ -4,43 +4,80 @@
 #include <stdbool.h>
 #include <string.h>
 #include "01-graph/graph.h"	// your graph header
+#include "01-graph/distance_matrix.h"
+#include "04-abstract_opinion_space/opinion_vector.h"
 
-#define MAX_NODES 1024
-
-static bool is_valid_opinion(float *opinions, int *cluster, int size,
-			     int node, float max_op_diff)
+// diff has room for the cluster
+static bool is_valid_opinion(const opinion_space *view, int *cluster,
+			     int size, int node, float max_op_diff,
+			     float *diff)
 {
+	opinion_distances_to_set(view, node, cluster, size, OPINION_L1, diff);
 	for (int i = 0; i < size; i++) {
-		if (fabsf(opinions[cluster[i]] - opinions[node]) >
-		    max_op_diff)
+		if (diff[i] > max_op_diff)
 			return false;
 	}
 	return true;
 }
 
+// Exact shortest-path distances in the smallest encoding that holds
+// them: packed for undirected graphs, u16 hop counts while every weight
+// is an integer and the distances fit, f32 otherwise
+static distance_matrix *cluster_distances(graph *g)
+{
+	dist_format format = DIST_U16;
+	for (int u = 0; u < g->num_nodes && format == DIST_U16; u++)
+		for (neighbor_iter it = graph_neighbors(g, u);
+		     neighbor_next(&it);)
+			if (it.weight != floorf(it.weight)) {
+				format = DIST_F32;
+				break;
+			}
+	distance_matrix *m = compute_distance_matrix(g, format, 1);
+	if (m && m->lossy) {
+		free_distance_matrix(m);
+		m = compute_distance_matrix(g, DIST_F32, 1);
+	}
+	return m;
+}
+
+// A node is queued again by every neighbor that reaches it before it is
+// visited: the queue needs one slot per arc plus the start
+static size_t cluster_queue_size(graph *g)
+{
+	return graph_num_arcs(g) + 1;
+}
+
 cluster_result find_disjoint_maximal_opinion_clusters(graph *g,
 						      float *opinions,
 						      float max_distance,
 						      float max_op_diff)
 {
 	int n = g->num_nodes;
-	float *distances = compute_all_pairs_distances(g);
+	distance_matrix *distances = cluster_distances(g);
+	opinion_space view = float_opinion_view(opinions, n);
+	float *diff = malloc(sizeof(float) * n);
+	bool *visited = calloc(n, sizeof(bool));
+	int *queue = malloc(sizeof(int) * cluster_queue_size(g));
 
 	cluster_result result = { 0 };
 	result.clusters = malloc(sizeof(int *) * n);
 	result.cluster_sizes = malloc(sizeof(int) * n);
 	result.avg_opinions = malloc(sizeof(float) * n);	// allocate avg_opinions array
 	result.num_clusters = 0;
-
-	bool visited[MAX_NODES] = { false };
+	if (!distances || !diff || !visited || !queue || !result.clusters
+	    || !result.cluster_sizes || !result.avg_opinions)
+		goto out;
 
 	for (int start = 0; start < n; start++) {
 		if (visited[start])
 			continue;
 
 		int *cluster = malloc(sizeof(int) * n);
+		if (!cluster)
+			break;
 		int cluster_size = 0;
-		int queue[MAX_NODES], front = 0, rear = 0;
+		int front = 0, rear = 0;
 
 		queue[rear++] = start;
 
@@ -52,17 +89,19 @@ cluster_result find_disjoint_maximal_opinion_clusters(graph *g,
 			visited[curr] = true;
 			cluster[cluster_size++] = curr;
 
-			for (int neighbor = 0; neighbor < n; neighbor++) {
+			for (neighbor_iter it = graph_neighbors(g, curr);
+			     neighbor_next(&it);) {
+				int neighbor = it.v;
 				if (visited[neighbor])
 					continue;
 
-				float d = distances[start * n + neighbor];
+				float d =
+				    distance_get(distances, start, neighbor);
 				if (d <= max_distance
-				    && is_connected(g, curr, neighbor)
-				    && is_valid_opinion(opinions, cluster,
+				    && is_valid_opinion(&view, cluster,
 							cluster_size,
 							neighbor,
-							max_op_diff)) {
+							max_op_diff, diff)) {
 					queue[rear++] = neighbor;
 				}
 			}
@@ -82,7 +121,11 @@ cluster_result find_disjoint_maximal_opinion_clusters(graph *g,
 		result.num_clusters++;
 	}
 
-	free(distances);
+out:
+	free_distance_matrix(distances);
+	free(diff);
+	free(visited);
+	free(queue);
 	return result;
 }
 
@@ -93,19 +136,28 @@ cluster_result find_overlapping_maximal_opinion_clusters(graph *g,
 							 float max_op_diff)
 {
 	int n = g->num_nodes;
-	float *distances = compute_all_pairs_distances(g);
+	distance_matrix *distances = cluster_distances(g);
+	opinion_space view = float_opinion_view(opinions, n);
+	float *diff = malloc(sizeof(float) * n);
+	bool *in_cluster = malloc(sizeof(bool) * n);
+	int *queue = malloc(sizeof(int) * cluster_queue_size(g));
 
 	cluster_result result = { 0 };
 	result.clusters = malloc(sizeof(int *) * n);
 	result.cluster_sizes = malloc(sizeof(int) * n);
 	result.avg_opinions = malloc(sizeof(float) * n);	// allocate avg_opinions array
 	result.num_clusters = 0;
+	if (!distances || !diff || !in_cluster || !queue || !result.clusters
+	    || !result.cluster_sizes || !result.avg_opinions)
+		goto out;
 
 	for (int start = 0; start < n; start++) {
-		bool in_cluster[MAX_NODES] = { false };
 		int *cluster = malloc(sizeof(int) * n);
+		if (!cluster)
+			break;
 		int cluster_size = 0;
-		int queue[MAX_NODES], front = 0, rear = 0;
+		int front = 0, rear = 0;
+		memset(in_cluster, 0, sizeof(bool) * n);
 
 		queue[rear++] = start;
 
@@ -117,17 +169,19 @@ cluster_result find_overlapping_maximal_opinion_clusters(graph *g,
 			in_cluster[curr] = true;
 			cluster[cluster_size++] = curr;
 
-			for (int neighbor = 0; neighbor < n; neighbor++) {
+			for (neighbor_iter it = graph_neighbors(g, curr);
+			     neighbor_next(&it);) {
+				int neighbor = it.v;
 				if (in_cluster[neighbor])
 					continue;
 
-				float d = distances[start * n + neighbor];
+				float d =
+				    distance_get(distances, start, neighbor);
 				if (d <= max_distance
-				    && is_connected(g, curr, neighbor)
-				    && is_valid_opinion(opinions, cluster,
+				    && is_valid_opinion(&view, cluster,
 							cluster_size,
 							neighbor,
-							max_op_diff)) {
+							max_op_diff, diff)) {
 					queue[rear++] = neighbor;
 				}
 			}
@@ -153,7 +207,11 @@ cluster_result find_overlapping_maximal_opinion_clusters(graph *g,
 		}
 	}
 
-	free(distances);
+out:
+	free_distance_matrix(distances);
+	free(diff);
+	free(in_cluster);
+	free(queue);
 	return result;
 }
 
@@ -219,9 +277,14 @@ float *read_opinions(const char *filename, size_t *out_num_nodes)
 		return NULL;
 	}
 
+	// Lines of multi-topic models carry one value per topic: the
+	// drawing shows the first.
+	char line[4096];
 	size_t idx;
 	float val;
-	while (fscanf(file, "%zu %f\n", &idx, &val) == 2) {
+	while (fgets(line, sizeof(line), file)) {
+		if (sscanf(line, "%zu %f", &idx, &val) != 2)
+			continue;
 		if (idx >= count) {
 			fprintf(stderr,
 				"Warning: node index %zu out of range in opinions file\n",
@@ -299,10 +362,9 @@ void save_image_as_graph_wopinion_labels_and_colors(char *graph_filename,
 	}
 
 	for (size_t i = 0; i < num_nodes; i++) {
-		for (size_t j = 0; j < num_nodes; j++) {
-			if (!g->edges[i * num_nodes + j])
-				continue;
-
+		for (neighbor_iter it = graph_neighbors(g, (int)i);
+		     neighbor_next(&it);) {
+			size_t j = (size_t)it.v;
 			float opinion_avg = (opinions[i] + opinions[j]) / 2.0f;	// Range: [-1, 1]
 			int r = 0, g_col = 0, b = 0;
 
@@ -0,0 +1,349 @@
+#include "impact_weights.h"
+#include "../01-graph/shortest_paths.h"
+#include "../04-abstract_opinion_space/abstract_opinion_space.h"
+#include "../11-helpers/thread_pool.h"
+#include "../11-helpers/cpu_features.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_KERNELS 1
+#endif
+
+#define ROWS_PER_TASK 16
+#define MAX_INT_ALPHA 32
+
+// 1 / max(dist, IMPACT_MIN_DIST)^alpha without the table. The integer
+// power is taken in double: k squarings lose less than one float ulp.
+static float weight_direct(const impact_weights *w, float dist)
+{
+	if (dist < IMPACT_MIN_DIST)
+		dist = IMPACT_MIN_DIST;
+	if (w->int_alpha < 0)
+		return 1.0f / powf(dist, w->alpha);
+	double power = 1.0, base = dist;
+	for (int k = w->int_alpha; k; k >>= 1) {
+		if (k & 1)
+			power *= base;
+		base *= base;
+	}
+	return (float)(1.0 / power);
+}
+
+float impact_weight(const impact_weights *w, float dist)
+{
+	if (dist >= SP_INF * 0.9f)
+		return 0.0f;
+	if (dist >= 0.0f && dist < IMPACT_HOP_LUT) {
+		int hops = (int)dist;
+		if ((float)hops == dist)
+			return w->hop_weight[hops];
+	}
+	return weight_direct(w, dist);
+}
+
+static void init_common(impact_weights *w, int n, float alpha)
+{
+	memset(w, 0, sizeof(*w));
+	w->num_nodes = n;
+	w->alpha = alpha;
+	w->int_alpha = alpha >= 0.0f && alpha <= MAX_INT_ALPHA
+	    && alpha == floorf(alpha) ? (int)alpha : -1;
+	for (int h = 0; h < IMPACT_HOP_LUT; h++)
+		w->hop_weight[h] = weight_direct(w, (float)h);
+}
+
+// Distances of row i turned into weights in place
+static void weigh_row(const impact_weights *w, float *row, int i)
+{
+	for (int j = 0; j < w->num_nodes; j++)
+		row[j] = impact_weight(w, row[j]);
+	row[i] = 0.0f;
+}
+
+typedef struct {
+	impact_weights *w;
+	const distance_matrix *d;
+	const unsigned char *changed;
+} update_job;
+
+static void update_rows(void *ctx, size_t begin, size_t end, int worker)
+{
+	(void)worker;
+	update_job *job = ctx;
+	for (size_t i = begin; i < end; i++) {
+		if (job->changed && !job->changed[i])
+			continue;
+		float *row = job->w->rows + i * job->w->stride;
+		distance_row(job->d, (int)i, row);
+		weigh_row(job->w, row, (int)i);
+	}
+}
+
+int impact_weights_init(impact_weights *w, const distance_matrix *d,
+			float alpha)
+{
+	size_t n = (size_t)d->num_nodes;
+	init_common(w, (int)n, alpha);
+	if (d->packed || d->format != DIST_F32) {
+		w->scratch = alloc_float_array(n);
+		return w->scratch != NULL;
+	}
+	w->stride = (n + FLOAT_ARRAY_PAD - 1) / FLOAT_ARRAY_PAD
+	    * FLOAT_ARRAY_PAD;
+	if (n && w->stride > SIZE_MAX / n)
+		return 0;
+	w->rows = alloc_float_array(n * w->stride);
+	if (!w->rows)
+		return 0;
+	impact_weights_update(w, d, NULL);
+	return 1;
+}
+
+int impact_weights_init_ball(impact_weights *w, const distance_ball *b,
+			     float alpha)
+{
+	init_common(w, b->num_nodes, alpha);
+	size_t total = b->offsets[b->num_nodes];
+	w->ball_weights = malloc((total ? total : 1) * sizeof(float));
+	if (!w->ball_weights)
+		return 0;
+	impact_weights_update_ball(w, b);
+	return 1;
+}
+
+void impact_weights_free(impact_weights *w)
+{
+	free(w->rows);
+	free(w->scratch);
+	free(w->ball_weights);
+	w->rows = w->scratch = w->ball_weights = NULL;
+}
+
+void impact_weights_update(impact_weights *w, const distance_matrix *d,
+			   const unsigned char *changed)
+{
+	if (!w->rows)
+		return;
+	update_job job = { w, d, changed };
+	parallel_for((size_t)w->num_nodes, ROWS_PER_TASK, update_rows, &job);
+}
+
+void impact_weights_update_ball(impact_weights *w, const distance_ball *b)
+{
+	size_t total = b->offsets[b->num_nodes];
+	for (size_t p = 0; p < total; p++)
+		w->ball_weights[p] = impact_weight(w, b->dists[p]);
+}
+
+const float *impact_weights_row(impact_weights *w,
+				const distance_matrix *d, int i)
+{
+	if (w->rows)
+		return w->rows + (size_t)i * w->stride;
+	distance_row(d, i, w->scratch);
+	weigh_row(w, w->scratch, i);
+	return w->scratch;
+}
+
+float impact_sum_scalar(const float *weight, const float *persuasiveness,
+			const float *support, const float *opinions, float oi,
+			size_t n)
+{
+	float impact = 0.0f;
+	for (size_t j = 0; j < n; j++) {
+		float p = persuasiveness[j], s = support[j];
+		impact += weight[j] * ((p - s) - oi * opinions[j] * (p + s));
+	}
+	return impact;
+}
+
+// The vector kernels keep four accumulators to hide the latency of the
+// adds and fold them once at the end; the scalar loop takes the tail
+// (AVX-512 masks it instead). The term is ((p - s) - (oi o) (p + s)) w
+// in every kernel, with one rounding less where FMA fuses it.
+#ifdef HAVE_X86_KERNELS
+__attribute__((target("sse2")))
+static inline __m128 impact_step_sse2(__m128 acc, const float *weight,
+				      const float *p, const float *s,
+				      const float *o, __m128 oi)
+{
+	__m128 vp = _mm_loadu_ps(p), vs = _mm_loadu_ps(s);
+	__m128 x = _mm_sub_ps(_mm_sub_ps(vp, vs),
+			      _mm_mul_ps(_mm_mul_ps(oi, _mm_loadu_ps(o)),
+					 _mm_add_ps(vp, vs)));
+	return _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(weight), x));
+}
+
+__attribute__((target("sse2")))
+static inline float hsum_sse2(__m128 v)
+{
+	v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+	v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+	return _mm_cvtss_f32(v);
+}
+
+__attribute__((target("sse2")))
+static float impact_sum_sse2(const float *weight, const float *p,
+			     const float *s, const float *o, float oi,
+			     size_t n)
+{
+	const __m128 voi = _mm_set1_ps(oi);
+	__m128 acc0 = _mm_setzero_ps(), acc1 = acc0, acc2 = acc0, acc3 = acc0;
+	size_t j = 0;
+	for (; j + 16 <= n; j += 16) {
+		acc0 = impact_step_sse2(acc0, weight + j, p + j, s + j, o + j,
+					voi);
+		acc1 = impact_step_sse2(acc1, weight + j + 4, p + j + 4,
+					s + j + 4, o + j + 4, voi);
+		acc2 = impact_step_sse2(acc2, weight + j + 8, p + j + 8,
+					s + j + 8, o + j + 8, voi);
+		acc3 = impact_step_sse2(acc3, weight + j + 12, p + j + 12,
+					s + j + 12, o + j + 12, voi);
+	}
+	for (; j + 4 <= n; j += 4)
+		acc0 = impact_step_sse2(acc0, weight + j, p + j, s + j, o + j,
+					voi);
+	__m128 acc = _mm_add_ps(_mm_add_ps(acc0, acc1),
+				_mm_add_ps(acc2, acc3));
+	return hsum_sse2(acc) + impact_sum_scalar(weight + j, p + j, s + j,
+						  o + j, oi, n - j);
+}
+
+__attribute__((target("avx2,fma")))
+static inline __m256 impact_step_avx2(__m256 acc, const float *weight,
+				      const float *p, const float *s,
+				      const float *o, __m256 oi)
+{
+	__m256 vp = _mm256_loadu_ps(p), vs = _mm256_loadu_ps(s);
+	__m256 x = _mm256_fnmadd_ps(_mm256_mul_ps(oi, _mm256_loadu_ps(o)),
+				    _mm256_add_ps(vp, vs),
+				    _mm256_sub_ps(vp, vs));
+	return _mm256_fmadd_ps(_mm256_loadu_ps(weight), x, acc);
+}
+
+__attribute__((target("avx2,fma")))
+static float impact_sum_avx2(const float *weight, const float *p,
+			     const float *s, const float *o, float oi,
+			     size_t n)
+{
+	const __m256 voi = _mm256_set1_ps(oi);
+	__m256 acc0 = _mm256_setzero_ps(), acc1 = acc0, acc2 = acc0,
+	    acc3 = acc0;
+	size_t j = 0;
+	for (; j + 32 <= n; j += 32) {
+		acc0 = impact_step_avx2(acc0, weight + j, p + j, s + j, o + j,
+					voi);
+		acc1 = impact_step_avx2(acc1, weight + j + 8, p + j + 8,
+					s + j + 8, o + j + 8, voi);
+		acc2 = impact_step_avx2(acc2, weight + j + 16, p + j + 16,
+					s + j + 16, o + j + 16, voi);
+		acc3 = impact_step_avx2(acc3, weight + j + 24, p + j + 24,
+					s + j + 24, o + j + 24, voi);
+	}
+	for (; j + 8 <= n; j += 8)
+		acc0 = impact_step_avx2(acc0, weight + j, p + j, s + j, o + j,
+					voi);
+	__m256 acc = _mm256_add_ps(_mm256_add_ps(acc0, acc1),
+				   _mm256_add_ps(acc2, acc3));
+	__m128 half = _mm_add_ps(_mm256_castps256_ps128(acc),
+				 _mm256_extractf128_ps(acc, 1));
+	return hsum_sse2(half) + impact_sum_scalar(weight + j, p + j, s + j,
+						   o + j, oi, n - j);
+}
+
+__attribute__((target("avx512f")))
+static inline __m512 impact_step_avx512(__m512 acc, __mmask16 m,
+					const float *weight, const float *p,
+					const float *s, const float *o,
+					__m512 oi)
+{
+	__m512 vp = _mm512_maskz_loadu_ps(m, p);
+	__m512 vs = _mm512_maskz_loadu_ps(m, s);
+	__m512 x = _mm512_fnmadd_ps(_mm512_mul_ps(oi,
+						  _mm512_maskz_loadu_ps(m, o)),
+				    _mm512_add_ps(vp, vs),
+				    _mm512_sub_ps(vp, vs));
+	return _mm512_fmadd_ps(_mm512_maskz_loadu_ps(m, weight), x, acc);
+}
+
+__attribute__((target("avx512f")))
+static float impact_sum_avx512(const float *weight, const float *p,
+			       const float *s, const float *o, float oi,
+			       size_t n)
+{
+	const __m512 voi = _mm512_set1_ps(oi);
+	const __mmask16 all = 0xffff;
+	__m512 acc0 = _mm512_setzero_ps(), acc1 = acc0, acc2 = acc0,
+	    acc3 = acc0;
+	size_t j = 0;
+	for (; j + 64 <= n; j += 64) {
+		acc0 = impact_step_avx512(acc0, all, weight + j, p + j, s + j,
+					  o + j, voi);
+		acc1 = impact_step_avx512(acc1, all, weight + j + 16,
+					  p + j + 16, s + j + 16, o + j + 16,
+					  voi);
+		acc2 = impact_step_avx512(acc2, all, weight + j + 32,
+					  p + j + 32, s + j + 32, o + j + 32,
+					  voi);
+		acc3 = impact_step_avx512(acc3, all, weight + j + 48,
+					  p + j + 48, s + j + 48, o + j + 48,
+					  voi);
+	}
+	// Masked-off lanes load zeros and add nothing
+	for (; j < n; j += 16) {
+		__mmask16 m = n - j >= 16 ? all
+		    : (__mmask16) ((1u << (n - j)) - 1);
+		acc0 = impact_step_avx512(acc0, m, weight + j, p + j, s + j,
+					  o + j, voi);
+	}
+	return _mm512_reduce_add_ps(_mm512_add_ps(_mm512_add_ps(acc0, acc1),
+						  _mm512_add_ps(acc2, acc3)));
+}
+#endif
+
+float impact_sum(const float *weight, const float *persuasiveness,
+		 const float *support, const float *opinions, float oi,
+		 size_t n)
+{
+#ifdef HAVE_X86_KERNELS
+	switch (cpu_simd_isa()) {
+	case SIMD_AVX512:
+		return impact_sum_avx512(weight, persuasiveness, support,
+					 opinions, oi, n);
+	case SIMD_AVX2:
+		return impact_sum_avx2(weight, persuasiveness, support,
+				       opinions, oi, n);
+	case SIMD_SSE2:
+		return impact_sum_sse2(weight, persuasiveness, support,
+				       opinions, oi, n);
+	default:
+		break;
+	}
+#endif
+	return impact_sum_scalar(weight, persuasiveness, support, opinions,
+				 oi, n);
+}
+
+const char *impact_sum_kernel(void)
+{
+#ifdef HAVE_X86_KERNELS
+	return simd_isa_name(cpu_simd_isa());
+#else
+	return simd_isa_name(SIMD_SCALAR);
+#endif
+}
+
+float impact_sum_gather(const float *weight, const int *node,
+			const float *persuasiveness, const float *support,
+			const float *opinions, float oi, size_t count)
+{
+	float impact = 0.0f;
+	for (size_t k = 0; k < count; k++) {
+		int j = node[k];
+		float p = persuasiveness[j], s = support[j];
+		impact += weight[k] * ((p - s) - oi * opinions[j] * (p + s));
+	}
+	return impact;
+}
@@ -0,0 +1,94 @@
+#ifndef IMPACT_WEIGHTS_H
+#define IMPACT_WEIGHTS_H
+
+#include "../01-graph/distance_matrix.h"
+#include "../01-graph/distance_ball.h"
+#include <stddef.h>
+
+// Influence weights of the social impact model,
+//
+//	w_ij = 1 / max(d_ij, IMPACT_MIN_DIST)^alpha,
+//
+// 0 for j = i and for unreachable pairs, so that the impact on i is one
+// multiply-add per node with no test on the pair:
+//
+//	impact_i = sum_j w_ij ((p_j - s_j) - o_i o_j (p_j + s_j))
+//
+// Integer distances below IMPACT_HOP_LUT (hop counts) read their weight
+// from a table; other distances are raised by repeated multiplication
+// when alpha is a small integer and by powf otherwise.
+
+#define IMPACT_MIN_DIST 1e-6f
+#define IMPACT_HOP_LUT 256
+
+typedef struct {
+	int num_nodes;
+	float alpha;
+	int int_alpha;		// alpha if it is an integer in [0, 32], else -1
+	float hop_weight[IMPACT_HOP_LUT];
+
+	// Full float distance matrix: row i of the weights at rows + i *
+	// stride, 64-byte aligned, zero past column n. A packed or quantized
+	// matrix is kept that way to save memory and its rows are turned
+	// into weights on demand in scratch (rows is then NULL).
+	float *rows;
+	size_t stride;
+	float *scratch;
+
+	// Distance balls: the weight of each ball entry, next to ball->dists
+	float *ball_weights;
+} impact_weights;
+
+// Weights for every pair of d. Returns 0 if out of memory.
+int impact_weights_init(impact_weights * w, const distance_matrix * d,
+			float alpha);
+// Weights for the entries of the balls of b. Returns 0 if out of memory.
+int impact_weights_init_ball(impact_weights * w, const distance_ball * b,
+			     float alpha);
+void impact_weights_free(impact_weights * w);
+
+// Recomputes from d the cached rows i with changed[i] set, every row if
+// changed is NULL (after a renumbering or a new matrix).
+void impact_weights_update(impact_weights * w, const distance_matrix * d,
+			   const unsigned char *changed);
+// Recomputes every ball weight, after distance_ball_permute
+void impact_weights_update_ball(impact_weights * w,
+				const distance_ball * b);
+
+// Weight of one distance
+float impact_weight(const impact_weights * w, float dist);
+
+// Weights of row i, n floats. Valid until the next call for compressed
+// matrices.
+const float *impact_weights_row(impact_weights * w,
+				const distance_matrix * d, int i);
+
+// sum_j weight[j] ((p_j - s_j) - oi o_j (p_j + s_j)) over j < n, on the
+// widest of the SSE2, AVX2 and AVX-512 kernels the CPU supports (see
+// cpu_features.h). There is no test on j: the diagonal and unreachable
+// pairs are masked by their zero weights.
+//
+// The vector kernels add the terms in another order than the scalar
+// loop. With u = 2^-24 and A = sum_j weight[j] (|p_j - s_j| + |oi o_j
+// (p_j + s_j)|), each result is within (n + 4) u A of the exact sum, so
+// any two kernels differ by at most 2 (n + 4) ulp(A). The rounding
+// errors mostly cancel, and the vector kernels split the sum 16 to 64
+// ways: the differences seen are a few ulp(A) (impact_bench reports
+// them).
+float impact_sum(const float *weight, const float *persuasiveness,
+		 const float *support, const float *opinions, float oi,
+		 size_t n);
+// The scalar reference, in index order
+float impact_sum_scalar(const float *weight, const float *persuasiveness,
+			const float *support, const float *opinions, float oi,
+			size_t n);
+// Same sum over the nodes node[0 .. count), weight[k] going with node[k]
+// (scalar: the gathers would cost more than the arithmetic)
+float impact_sum_gather(const float *weight, const int *node,
+			const float *persuasiveness, const float *support,
+			const float *opinions, float oi, size_t count);
+
+// Name of the kernel impact_sum dispatches to on this CPU
+const char *impact_sum_kernel(void);
+
+#endif				// IMPACT_WEIGHTS_H
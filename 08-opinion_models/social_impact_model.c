@@ -1,129 +1,318 @@
 #include "social_impact_model.h"
-#include "../11-helpers/get_urandom.h"
 #include "../01-graph/graph.h"
+#include "../01-graph/shortest_paths.h"
+#include "../01-graph/distance_ball.h"
+#include "../01-graph/distance_matrix.h"
+#include "impact_weights.h"
+#include "../04-abstract_opinion_space/opinion_vector.h"
+#include "../11-helpers/rng_batch.h"
 #include<string.h>
-#define INF 1e9f
 
 typedef struct {
 	float alpha;
 	float beta;
-	float *distances;	// flattened size n * n
+	distance_matrix *distances;	// NULL when ball is set
+	distance_ball *ball;	// optional sparse distances, see distance_ball.h
 	float *persuasiveness;	// size n
 	float *support;		// size n
+	// 1 / d^alpha for distances or ball, see impact_weights.h
+	impact_weights weights;
+	// Temporal model: topology changes of the current step, replayed
+	// onto distances so it tracks the live network, and the rows of
+	// distances the replay changed, whose weights are then recomputed.
+	graph_change_log changes;
+	unsigned char *changed_rows;
 } social_impact_params;
 
 void free_params(opinion_model *sim)
 {
 	social_impact_params *params =
 	    (social_impact_params *) sim->params;
-	free(params->distances);
+	free_distance_matrix(params->distances);
+	free_distance_ball(params->ball);
 	free(params->persuasiveness);
 	free(params->support);
+	impact_weights_free(&params->weights);
+	graph_change_log_free(&params->changes);
+	free(params->changed_rows);
 	free(params);
 }
 
+// sum_j (p_j (1 - o_i o_j) - s_j (1 + o_i o_j)) / d_ij^alpha over the
+// nodes j != i reachable from i, or within its ball
 float mult_impact_i(size_t i, social_impact_params *params, float *os,
 		    size_t num_nodes)
 {
-	float impact = 0.0f;
-
-	for (size_t j = 0; j < num_nodes; j++) {
-		float dist = params->distances[num_nodes * i + j];
-		if (i == j || dist >= INF * 0.9f)
-			continue;
-		// Prevent zero or very small distances to avoid division by zero
-		if (dist < 1e-6f)
-			dist = 1e-6f;
-		float dij_alpha = powf(dist, params->alpha);
-		impact +=
-		    (params->persuasiveness[j] / dij_alpha) * (1 -
-							       os[i] *
-							       os[j])
-		    - (params->support[j] / dij_alpha) * (1 +
-							  os[i] * os[j]);
-	}
-	return impact;
+	const distance_ball *b = params->ball;
+	if (b)
+		return impact_sum_gather(params->weights.ball_weights
+					 + b->offsets[i],
+					 b->nodes + b->offsets[i],
+					 params->persuasiveness,
+					 params->support, os, os[i],
+					 b->offsets[i + 1] - b->offsets[i]);
+	return impact_sum(impact_weights_row(&params->weights,
+					     params->distances, (int)i),
+			  params->persuasiveness, params->support, os, os[i],
+			  num_nodes);
+}
+
+// Weights for whichever of distances and ball the model uses
+static int init_weights(social_impact_params *params)
+{
+	if (params->ball)
+		return impact_weights_init_ball(&params->weights, params->ball,
+						params->alpha);
+	return impact_weights_init(&params->weights, params->distances,
+				   params->alpha);
 }
 
 void social_impact_async_mult_update(opinion_model *model)
 {
-	float *opinions = (float *)model->opinion_space->opinions;
+	float *opinions = float_opinions(model->opinion_space);
 	size_t n = model->network->num_nodes;
 	social_impact_params *params =
 	    (social_impact_params *) model->params;
 	float beta = params->beta;
-	size_t i = (size_t)get_urandom(0.0f, (float)n);
+	size_t i = (size_t)rng_below(&model->rng, n);
 	float impact = mult_impact_i(i, params, opinions, n);
 	opinions[i] = tanhf(beta * (opinions[i] * impact));
 }
 
-opinion_model *create_si_async_mult_model(graph *topology,
-					  float alpha, float beta)
+// Distances go first: they are the largest allocation, so running out of
+// memory most likely happens before anything has moved.
+static int permute_si_params(opinion_model *model, const int *new_id)
 {
-	if (!topology)
+	social_impact_params *params =
+	    (social_impact_params *) model->params;
+	int n = model->network->num_nodes;
+	int *old_id = invert_permutation(new_id, n);
+	if (!old_id)
+		return 0;
+	if (params->distances
+	    && !distance_matrix_permute(params->distances, new_id))
+		goto fail;
+	if (params->ball && !distance_ball_permute(params->ball, new_id))
+		goto undo_distances;
+	if (!permute_array(params->persuasiveness, sizeof(float), new_id, n))
+		goto undo_ball;
+	if (!permute_array(params->support, sizeof(float), new_id, n))
+		goto undo_persuasiveness;
+	free(old_id);
+	// Recomputed rather than moved: no allocation, nothing to undo
+	if (params->ball)
+		impact_weights_update_ball(&params->weights, params->ball);
+	else
+		impact_weights_update(&params->weights, params->distances,
+				      NULL);
+	return 1;
+
+undo_persuasiveness:
+	permute_array(params->persuasiveness, sizeof(float), old_id, n);
+undo_ball:
+	if (params->ball)
+		distance_ball_permute(params->ball, old_id);
+undo_distances:
+	if (params->distances)
+		distance_matrix_permute(params->distances, old_id);
+fail:
+	free(old_id);
+	return 0;
+}
+
+// Draws the initial state from rng (seeded from rand() when NULL) and
+// hands the model the stream that follows; the caller's rng then jumps
+// past it.
+static int init_si_model(opinion_model *model, social_impact_params *params,
+			 int n, rng_state *rng)
+{
+	rng_state own;
+	if (!rng) {
+		rng_seed(&own, rng_seed_from_rand());
+		rng = &own;
+	}
+	opinion_space *persuasiveness =
+	    create_opinions_in_real_ball_of_radius_one(n, rng);
+	opinion_space *support =
+	    create_opinions_in_real_ball_of_radius_one(n, rng);
+	model->opinion_space = create_opinions_in_real_ball_of_radius_one(n,
+									  rng);
+	params->persuasiveness = persuasiveness ? persuasiveness->opinions
+	    : NULL;
+	params->support = support ? support->opinions : NULL;
+	// Only the arrays are kept
+	free(persuasiveness);
+	free(support);
+	if (!params->persuasiveness || !params->support
+	    || !model->opinion_space) {
+		free(params->persuasiveness);
+		free(params->support);
+		free_opinion_space(model->opinion_space);
+		return 0;
+	}
+	model->rng = *rng;
+	rng_jump(rng);
+	return 1;
+}
+
+// Takes ownership of distances and ball. With neither, the full float
+// distance matrix is computed.
+static opinion_model *create_si_mult_model(graph *topology, float alpha,
+					   float beta,
+					   distance_matrix *distances,
+					   distance_ball *ball, rng_state *rng)
+{
+	if (!topology) {
+		free_distance_matrix(distances);
+		free_distance_ball(ball);
 		return NULL;
+	}
 	opinion_model *model = malloc(sizeof(opinion_model));
-	if (!model)
+	if (!model) {
+		free_distance_matrix(distances);
+		free_distance_ball(ball);
 		return NULL;
+	}
 
 	social_impact_params *params =
 	    malloc(sizeof(social_impact_params));
 	if (!params) {
+		free_distance_matrix(distances);
+		free_distance_ball(ball);
 		free(model);
 		return NULL;
 	}
 
 	params->alpha = alpha;
 	params->beta = beta;
-	params->distances = compute_all_pairs_distances(topology);
-	params->persuasiveness =
-	    create_opinions_in_real_ball_of_radius_one(topology->
-						       num_nodes)->
-	    opinions;
-	params->support =
-	    create_opinions_in_real_ball_of_radius_one(topology->
-						       num_nodes)->
-	    opinions;
-
-	if (!params->persuasiveness || !params->support) {
-		free(params->persuasiveness);
-		free(params->support);
+	params->changes = (graph_change_log) {
+	0};
+	params->weights = (impact_weights) {
+	0};
+	params->changed_rows = NULL;
+	params->ball = ball;
+	params->distances = distances;
+	if (!distances && !ball)
+		params->distances =
+		    distance_matrix_wrap(compute_all_pairs_distances
+					 (topology), topology->num_nodes);
+
+	if (!(params->distances || params->ball) || !init_weights(params)
+	    || !init_si_model(model, params, topology->num_nodes, rng)) {
+		impact_weights_free(&params->weights);
+		free_distance_matrix(params->distances);
+		free_distance_ball(params->ball);
 		free(params);
 		free(model);
 		return NULL;
 	}
 
 	model->network = topology;
-	model->opinion_space =
-	    create_opinions_in_real_ball_of_radius_one(topology->
-						       num_nodes);
-
-	if (!model->opinion_space) {
-		free(params->persuasiveness);
-		free(params->support);
-		free(params);
-		free(model);
-		return NULL;
-	}
 
 	model->params = params;
 	model->update = social_impact_async_mult_update;
+	model->permute_params = permute_si_params;
+	model->original_id = NULL;
+	model->current_id = NULL;
 
 	return model;
 }
 
+opinion_model *create_si_async_mult_model(graph *topology,
+					  float alpha, float beta,
+					  rng_state *rng)
+{
+	return create_si_mult_model(topology, alpha, beta, NULL, NULL, rng);
+}
+
+opinion_model *create_si_async_mult_model_with_distances(graph *topology,
+							 distance_matrix *
+							 distances,
+							 float alpha,
+							 float beta,
+							 rng_state *rng)
+{
+	if (!distances)
+		return NULL;
+	return create_si_mult_model(topology, alpha, beta, distances, NULL,
+				    rng);
+}
+
+opinion_model *create_si_async_mult_model_with_ball(graph *topology,
+						    distance_ball *ball,
+						    float alpha, float beta,
+						    rng_state *rng)
+{
+	if (!ball)
+		return NULL;
+	return create_si_mult_model(topology, alpha, beta, NULL, ball, rng);
+}
+
+int si_set_initial_values(opinion_model *model,
+			  const opinion_distribution *opinions,
+			  const opinion_distribution *persuasiveness,
+			  const opinion_distribution *support, uint64_t seed)
+{
+	social_impact_params *params =
+	    (social_impact_params *) model->params;
+	size_t n = model->opinion_space->num_agents;
+	rng_state seeds;
+	rng_seed(&seeds, seed);
+	uint64_t opinion_seed = rng_next(&seeds);
+	uint64_t persuasiveness_seed = rng_next(&seeds);
+	uint64_t support_seed = rng_next(&seeds);
+
+	if (opinions && !fill_opinion_values(float_opinions
+					     (model->opinion_space), n,
+					     opinions, opinion_seed))
+		return 0;
+	if (persuasiveness
+	    && !fill_opinion_values(params->persuasiveness, n,
+				    persuasiveness, persuasiveness_seed))
+		return 0;
+	if (support && !fill_opinion_values(params->support, n, support,
+					    support_seed))
+		return 0;
+	return 1;
+}
+
+float si_impact_tail_bound(opinion_model *model)
+{
+	social_impact_params *params =
+	    (social_impact_params *) model->params;
+	if (!params->ball)
+		return 0.0f;
+
+	// |p_j (1 - o_i o_j) - s_j (1 + o_i o_j)| <= 2 (|p_j| + |s_j|)
+	int n = model->network->num_nodes;
+	float max_weight = 0.0f;
+	for (int j = 0; j < n; j++) {
+		float w = 2.0f * (fabsf(params->persuasiveness[j])
+				  + fabsf(params->support[j]));
+		if (w > max_weight)
+			max_weight = w;
+	}
+
+	float bound = 0.0f;
+	for (int i = 0; i < n; i++) {
+		float b = distance_ball_tail_bound(params->ball, i,
+						   params->alpha, max_weight,
+						   IMPACT_MIN_DIST);
+		if (b > bound)
+			bound = b;
+	}
+	return bound;
+}
+
 float *compute_all_pairs_opinion_differences(float *opinions,
 					     int num_nodes)
 {
-	float *differences = malloc(sizeof(float) * num_nodes * num_nodes);
+	float *differences =
+	    malloc(sizeof(float) * (size_t)num_nodes * num_nodes);
 	if (!differences)
 		return NULL;
-	for (int i = 0; i < num_nodes; i++) {
-		for (int j = 0; j < num_nodes; j++) {
-			differences[i * num_nodes + j] =
-			    fabsf(opinions[i] - opinions[j]);
-		}
-	}
+	opinion_space view = float_opinion_view(opinions, num_nodes);
+	opinion_pairwise_distances(&view, OPINION_L1, differences);
 	return differences;
 }
 
@@ -144,20 +333,19 @@ void apply_natural_decay(graph *topology, float decay_rate,
 {
 	int num_nodes = topology->num_nodes;
 	for (int i = 0; i < num_nodes; i++) {
-		for (int j = 0; j < num_nodes; j++) {
+		for (neighbor_iter it = graph_neighbors(topology, i);
+		     neighbor_next(&it);) {
+			int j = it.v;
 			if (i == j)
 				continue;
-			if (!topology->edges[i * num_nodes + j])
-				continue;
-			float edge_weight =
-			    topology->edge_weights[i * num_nodes + j];
+			float edge_weight = it.weight;
 			float bond_strength = 1.0f - edge_weight;
 			// Apply decay to bond strength
 			bond_strength *= (1.0f - decay_rate);
 			// Remove edge if bond strength below threshold
 			if (bond_strength < min_bond_strength) {
 				bond_strength = 0.0f;
-				topology->edges[i * num_nodes + j] = 0;	// Remove edge
+				neighbor_remove(&it);	// Remove edge
 			}
 			edge_weight = 1.0f - bond_strength;
 			// Clamp edge weight between 0 and 1
@@ -165,12 +353,11 @@ void apply_natural_decay(graph *topology, float decay_rate,
 				edge_weight = 0.0f;
 			if (edge_weight > 1.0f)
 				edge_weight = 1.0f;
-			topology->edge_weights[i * num_nodes + j] =
-			    edge_weight;
+			neighbor_set_weight(&it, edge_weight);
 			if (topology->is_directed)
-				topology->edge_weights[i * num_nodes + j] =
-				    topology->edge_weights[j * num_nodes +
-							   i];
+				neighbor_set_weight(&it,
+						    get_weight(topology, j,
+							       i));
 		}
 	}
 }
@@ -184,17 +371,15 @@ void update_topology_homophily(graph *topology, float *opinions,
 	int num_nodes = topology->num_nodes;
 
 	for (int node_i = 0; node_i < num_nodes; node_i++) {
-		for (int node_j = 0; node_j < num_nodes; node_j++) {
+		for (neighbor_iter it = graph_neighbors(topology, node_i);
+		     neighbor_next(&it);) {
+			int node_j = it.v;
 			if (node_i == node_j)
 				continue;
-			if (!topology->edges[node_i * num_nodes + node_j])
-				continue;
 
 			float opinion_difference =
 			    fabsf(opinions[node_i] - opinions[node_j]);
-			float edge_weight =
-			    topology->edge_weights[node_i * num_nodes +
-						   node_j];
+			float edge_weight = it.weight;
 			float bond_strength = 1.0f - edge_weight;
 
 			// Reinforce bond if opinions are similar
@@ -217,7 +402,7 @@ void update_topology_homophily(graph *topology, float *opinions,
 				bond_strength = 1.0f;
 			if (bond_strength < minimum_bond_strength) {
 				bond_strength = 0.0f;
-				topology->edges[node_i * num_nodes + node_j] = 0;	// Remove edge
+				neighbor_remove(&it);	// Remove edge
 			}
 			// Convert bond strength back to edge weight
 			edge_weight = 1.0f - bond_strength;
@@ -226,54 +411,94 @@ void update_topology_homophily(graph *topology, float *opinions,
 			if (edge_weight > 1.0f)
 				edge_weight = 1.0f;
 
-			topology->edge_weights[node_i * num_nodes +
-					       node_j] = edge_weight;
+			neighbor_set_weight(&it, edge_weight);
 
-			if (topology->is_directed) {
-				topology->edge_weights[node_j * num_nodes +
-						       node_i] =
-				    edge_weight;
-			}
+			if (topology->is_directed)
+				set_weight(topology, node_j, node_i,
+					   edge_weight);
 		}
 	}
 }
 
-void create_edges_by_distance_and_opinion_similarity(graph *topology, float *opinions, float *distances,	// shortest path distances, INF if no path
+void create_edges_by_distance_and_opinion_similarity(graph *topology, float *opinions, const distance_matrix *distances,	// shortest path distances, SP_INF if no path
 						     float base_creation_probability,	// minimum base prob, > 0
 						     float similarity_factor,	// multiplier for opinion similarity effect
 						     float distance_factor_scale,	// multiplier for distance effect
 						     float
-						     initial_bond_strength)
+						     initial_bond_strength,
+						     rng_state *rng)
 {
 	int num_nodes = topology->num_nodes;
-	float *differences =
-	    compute_all_pairs_opinion_differences(opinions, num_nodes);
-	if (!differences)
-		return;
 
-	float max_opinion_diff =
-	    return_max(differences, num_nodes * num_nodes);
-	if (max_opinion_diff == 0)
-		max_opinion_diff = 1.0f;	// avoid div by zero
+	// Every missing arc (i, j) is created with probability
+	//   p_ij = base * (1 + scale * similarity * f(d_ij) * g(o_i - o_j))
+	// where f = 1 / (1 + d) <= 1 on a path, 0 without, and g <= 1 is the
+	// opinion similarity. Rather than a draw per pair, the columns of a
+	// row are sampled with the bound p_max >= p_ij by geometric skips and
+	// each candidate is kept with probability p_ij / p_max: the created
+	// arcs have the same distribution as independent draws per pair, at
+	// a cost proportional to p_max * n^2 candidates.
+	float boost = distance_factor_scale * similarity_factor;
+	float candidate_prob = base_creation_probability
+	    * (1.0f + (boost > 0.0f ? boost : 0.0f));
+	if (!(candidate_prob > 0.0f))
+		return;
+	if (candidate_prob > 1.0f)
+		candidate_prob = 1.0f;
+	double log_q = candidate_prob >= 1.0f ? -INFINITY
+	    : log1p(-(double)candidate_prob);
+
+	// New edges are collected and added after the scan so the rows stay
+	// stable while they are iterated. For undirected graphs created[j]
+	// chains the nodes i < j that already got the edge (i, j) in this
+	// pass, so the pair is not tried again from row j. Existing arcs are
+	// marked in is_neighbor, except on bit storage where each candidate
+	// is one bit test and marking a dense row would cost more.
+	int bits = topology->storage == GRAPH_BITMATRIX;
+	char *is_neighbor = calloc(num_nodes, sizeof(char));
+	int *created_head = malloc(num_nodes * sizeof(int));
+	graph_edge *created = NULL;
+	int *created_next = NULL;
+	size_t num_created = 0, created_capacity = 0;
+	if (!is_neighbor || !created_head) {
+		free(is_neighbor);
+		free(created_head);
+		return;
+	}
+	for (int i = 0; i < num_nodes; i++)
+		created_head[i] = -1;
+	rng_buffer draws;
+	rng_buffer_seed(&draws, rng_next(rng), 0);
 
 	for (int i = 0; i < num_nodes; i++) {
-		for (int j = 0; j < num_nodes; j++) {
+		for (neighbor_iter it = graph_neighbors(topology, i);
+		     !bits && neighbor_next(&it);)
+			is_neighbor[it.v] = 1;
+		for (int c = created_head[i]; c >= 0; c = created_next[c])
+			is_neighbor[created[c].u] = 1;
+
+		double pos = -1;	// current candidate column
+		for (;;) {
+			pos += 1 + floor(log1p(-rng_buffer_uniform(&draws))
+					 / log_q);
+			if (pos >= num_nodes)
+				break;
+			int j = (int)pos;
 			if (i == j)
 				continue;
-			if (topology->edges[i * num_nodes + j])
+			if (is_neighbor[j]
+			    || (bits && is_connected(topology, i, j)))
 				continue;	// Skip existing edges
 
-			float dist = distances[i * num_nodes + j];
-			float opinion_diff =
-			    differences[i * num_nodes + j];
-			float sigma = 0.2f;	// tune this parameter to control width of similarity decay
-			float opinion_similarity =
-			    expf(-(opinion_diff * opinion_diff) /
-				 (sigma * sigma));
-
+			float dist = distance_get(distances, i, j);
 			float creation_prob = base_creation_probability;	// start from base
 
-			if (!isinf(dist)) {
+			if (dist < SP_INF) {
+				float opinion_diff = fabsf(opinions[i] - opinions[j]);
+				float sigma = 0.2f;	// tune this parameter to control width of similarity decay
+				float opinion_similarity =
+				    expf(-(opinion_diff * opinion_diff) /
+					 (sigma * sigma));
 				// if path exists, scale creation prob up depending on distance (closer -> higher prob)
 				float distance_factor = 1.0f / (1.0f + dist);	// distance factor decreases with dist
 				creation_prob +=
@@ -283,31 +508,59 @@ void create_edges_by_distance_and_opinion_similarity(graph *topology, float *opi
 				    opinion_similarity;
 			}
 			// else: no path => creation_prob = base_creation_probability (already set)
-			float rand_val = get_urandom(0, 1);
+			// Thinning: keep the candidate with creation_prob / candidate_prob
+			float rand_val = rng_buffer_float(&draws) * candidate_prob;
 			if (rand_val < creation_prob) {
-				topology->edges[i * num_nodes + j] = 1;
-				topology->edge_weights[i * num_nodes + j] =
-				    initial_bond_strength;
-
-				if (!topology->is_directed) {
-					topology->edges[j * num_nodes +
-							i] = 1;
-					topology->edge_weights[j *
-							       num_nodes +
-							       i] =
-					    initial_bond_strength;
+				if (num_created == created_capacity) {
+					size_t cap = created_capacity ?
+					    2 * created_capacity : 64;
+					graph_edge *grown_edges =
+					    realloc(created,
+						    cap * sizeof(graph_edge));
+					if (!grown_edges)
+						break;
+					created = grown_edges;
+					int *grown_next =
+					    realloc(created_next,
+						    cap * sizeof(int));
+					if (!grown_next)
+						break;
+					created_next = grown_next;
+					created_capacity = cap;
+				}
+				created[num_created] = (graph_edge) {
+				i, j, initial_bond_strength};
+				if (!topology->is_directed && j > i) {
+					created_next[num_created] =
+					    created_head[j];
+					created_head[j] = (int)num_created;
 				}
+				num_created++;
 				//printf("Created edge between %d and %d with probability %.3f\n", i, j, creation_prob);
 			}
 		}
+
+		for (neighbor_iter it = graph_neighbors(topology, i);
+		     !bits && neighbor_next(&it);)
+			is_neighbor[it.v] = 0;
+		for (int c = created_head[i]; c >= 0; c = created_next[c])
+			is_neighbor[created[c].u] = 0;
 	}
 
-	free(differences);
+	// add_edge mirrors the edge for undirected graphs
+	for (size_t c = 0; c < num_created; c++)
+		add_edge(topology, created[c].u, created[c].v,
+			 created[c].weight);
+
+	free(created);
+	free(created_next);
+	free(created_head);
+	free(is_neighbor);
 }
 
 void update_topology_mixed(graph *topology,
 			   float *opinions,
-			   float *shortest_path_distances,
+			   const distance_matrix *shortest_path_distances,
 			   float opinion_similarity_threshold,
 			   float bond_reinforcement_rate,
 			   float bond_weakening_rate,
@@ -316,7 +569,7 @@ void update_topology_mixed(graph *topology,
 			   float base_creation_probability,
 			   float similarity_factor,
 			   float distance_factor_scale,
-			   float initial_bond_strength)
+			   float initial_bond_strength, rng_state *rng)
 {
 	/* Step 1: Apply homophily-based bond reinforcement/weakening */
 	update_topology_homophily(topology,
@@ -336,24 +589,27 @@ void update_topology_mixed(graph *topology,
 							base_creation_probability,
 							similarity_factor,
 							distance_factor_scale,
-							initial_bond_strength);
+							initial_bond_strength,
+							rng);
 }
 
 void social_impact_async_mult_update_temporal_topology(opinion_model
 						       *model)
 {
-	float *opinions = (float *)model->opinion_space->opinions;
+	float *opinions = float_opinions(model->opinion_space);
 	size_t n = model->network->num_nodes;
 	social_impact_params *params =
 	    (social_impact_params *) model->params;
 	float beta = params->beta;
-	size_t i = (size_t)get_urandom(0.0f, (float)n);
+	size_t i = (size_t)rng_below(&model->rng, n);
 	float impact = mult_impact_i(i, params, opinions, n);
-	float noise_strength = 0.01f;	// small magnitude of noise, tune as needed
-	float noise = noise_strength * (get_urandom(0, 1) - 0.5f) * 2.0f;
 	opinions[i] = tanhf(beta * (impact * opinions[i]));
-	float *dist = compute_all_pairs_distances(model->network);
-	update_topology_mixed(model->network, opinions, dist, 0.6f,	// opinion_similarity_threshold
+
+	// params->distances matches the network before the update; record
+	// what the update changes and repair only the rows it affects.
+	graph_change_log *log = &params->changes;
+	model->network->change_log = log;
+	update_topology_mixed(model->network, opinions, params->distances, 0.6f,	// opinion_similarity_threshold
 			      0.15f,	// bond_reinforcement_rate
 			      0.07f,	// bond_weakening_rate
 			      0.015f,	// decay_rate
@@ -361,13 +617,30 @@ void social_impact_async_mult_update_temporal_topology(opinion_model
 			      0.005f,	// base_creation_probability
 			      4.0f,	// similarity_factor
 			      2.0f,	// distance_factor_scale
-			      0.5f	// initial_bond_strength
-	    );
-	free(dist);
+			      0.5f,	// initial_bond_strength
+			      &model->rng);
+	model->network->change_log = NULL;
+	if (apsp_repair_rows(model->network,
+			     distance_matrix_floats(params->distances), log,
+			     params->changed_rows)) {
+		impact_weights_update(&params->weights, params->distances,
+				      params->changed_rows);
+	} else {
+		distance_matrix *fresh =
+		    distance_matrix_wrap(compute_all_pairs_distances
+					 (model->network), (int)n);
+		if (fresh) {
+			free_distance_matrix(params->distances);
+			params->distances = fresh;
+			impact_weights_update(&params->weights,
+					      params->distances, NULL);
+		}
+	}
+	graph_change_log_clear(log);
 }
 
 opinion_model *create_si_async_temporal(graph *topology,
-					float alpha, float beta)
+					float alpha, float beta, rng_state *rng)
 {
 	if (!topology)
 		return NULL;
@@ -384,39 +657,47 @@ opinion_model *create_si_async_temporal(graph *topology,
 
 	params->alpha = alpha;
 	params->beta = beta;
-	params->distances = compute_all_pairs_distances(topology);
-	params->persuasiveness =
-	    create_opinions_in_real_ball_of_radius_one(topology->
-						       num_nodes)->
-	    opinions;
-	params->support =
-	    create_opinions_in_real_ball_of_radius_one(topology->
-						       num_nodes)->
-	    opinions;
-
-	if (!params->persuasiveness || !params->support) {
-		free(params->persuasiveness);
-		free(params->support);
+	params->changes = (graph_change_log) {
+	0};
+	params->weights = (impact_weights) {
+	0};
+	params->ball = NULL;
+	// Kept as plain floats: apsp_repair updates them in place.
+	params->distances =
+	    distance_matrix_wrap(compute_all_pairs_distances(topology),
+				 topology->num_nodes);
+	params->changed_rows = malloc(topology->num_nodes > 0
+				      ? (size_t)topology->num_nodes : 1);
+
+	if (!params->distances || !params->changed_rows
+	    || !init_weights(params)
+	    || !init_si_model(model, params, topology->num_nodes, rng)) {
+		impact_weights_free(&params->weights);
+		free(params->changed_rows);
+		free_distance_matrix(params->distances);
 		free(params);
 		free(model);
 		return NULL;
 	}
-
-	model->network = topology;
-	model->opinion_space =
-	    create_opinions_in_real_ball_of_radius_one(topology->
-						       num_nodes);
-
-	if (!model->opinion_space) {
-		free(params->persuasiveness);
-		free(params->support);
-		free(params);
+	model->params = params;
+	// The topology is rewired on every step: move CSR and dense graphs
+	// to hash-set storage so edge insert/delete is O(1) instead of a CSR
+	// rebuild. A bit matrix is kept, its edge tests are bit tests.
+	// Converted last so that a failure leaves the caller's graph as it
+	// was.
+	if (topology->storage != GRAPH_BITMATRIX
+	    && !graph_convert(topology, GRAPH_DYNAMIC)) {
+		free_params(model);
+		free_opinion_space(model->opinion_space);
 		free(model);
 		return NULL;
 	}
 
-	model->params = params;
+	model->network = topology;
 	model->update = social_impact_async_mult_update_temporal_topology;
+	model->permute_params = permute_si_params;
+	model->original_id = NULL;
+	model->current_id = NULL;
 
 	return model;
 }
@@ -1,11 +1,51 @@
 #include "../05-abstract_opinion_model/abstract_opinion_model.h"
 #include "../06-real_opinion_space_[-1,1]/real_opinion_space_[-1,1].h"
+#include "../01-graph/distance_ball.h"
+#include "../01-graph/distance_matrix.h"
+#include "../04-abstract_opinion_space/opinion_init.h"
 #include <stdlib.h>
 #include <math.h>
 
 void free_params(opinion_model * sim);
 void social_impact_async_mult_update(opinion_model * model);
+// The initial opinions, persuasiveness and support are drawn from rng,
+// which then jumps past the stream the model keeps for its updates. With
+// rng NULL a generator seeded from rand() is used. The same holds for
+// the constructors below.
 opinion_model *create_si_async_mult_model(graph * topology,
-					  float alpha, float beta);
+					  float alpha, float beta,
+					  rng_state * rng);
+// Same model on precomputed, possibly packed or quantized distances (see
+// distance_matrix.h). The model takes ownership of distances.
+opinion_model *create_si_async_mult_model_with_distances(graph * topology,
+							 distance_matrix *
+							 distances,
+							 float alpha,
+							 float beta,
+							 rng_state * rng);
+// Same model with impacts summed over the ball of each node only, see
+// distance_ball.h. The model takes ownership of ball.
+opinion_model *create_si_async_mult_model_with_ball(graph * topology,
+						    distance_ball * ball,
+						    float alpha, float beta,
+						    rng_state * rng);
+// Redraws the initial opinions, persuasiveness and support of a social
+// impact model from the given distributions (see opinion_init.h), in
+// parallel, each from its own seed derived from seed. A NULL
+// distribution leaves that array as it is. Returns 0, with the arrays
+// possibly partly redrawn, if a distribution is invalid or its file
+// unreadable.
+int si_set_initial_values(opinion_model * model,
+			  const opinion_distribution * opinions,
+			  const opinion_distribution * persuasiveness,
+			  const opinion_distribution * support,
+			  uint64_t seed);
+// Largest error any single impact can get from the nodes left out of
+// the balls, 0 for models that use the full distance matrix.
+float si_impact_tail_bound(opinion_model * model);
+// Rewires topology on every step. The model keeps the graph and
+// switches CSR and dense storage to GRAPH_DYNAMIC; GRAPH_BITMATRIX is
+// kept. On failure (NULL) the graph is left unchanged.
 opinion_model *create_si_async_temporal(graph * topology,
-					float alpha, float beta);
+					float alpha, float beta,
+					rng_state * rng);
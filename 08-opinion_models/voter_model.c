@@ -0,0 +1,377 @@
+#include "voter_model.h"
+#include <string.h>
+
+#define NO_SLOT SIZE_MAX
+
+typedef enum {
+	VOTER_RULE = 0,
+	MAJORITY_RULE,
+	SZNAJD_RULE
+} discrete_rule;
+
+// Copy of the neighbor lists, and for the active-link voter model the
+// arcs whose ends disagree
+typedef struct {
+	size_t *offsets;	// arcs of u: targets[offsets[u] .. offsets[u + 1])
+	int *targets;
+	size_t num_arcs;
+
+	int *sources;		// source of each arc
+	size_t *in_offsets;	// arcs into v: in_arcs[in_offsets[v] ..]
+	size_t *in_arcs;
+	int *in_sources;	// in_sources[k]: source of in_arcs[k]
+	size_t *active;		// active arcs, in no order
+	size_t *slot;		// index in active, NO_SLOT if inactive
+	size_t num_active;
+} discrete_links;
+
+typedef struct {
+	discrete_rule rule;
+	bool track_active;
+	discrete_links links;	// unused by the majority rule
+	size_t *count;		// majority rule: neighbors per state
+	double link_time;
+} discrete_params;
+
+static void free_links(discrete_links *links)
+{
+	free(links->offsets);
+	free(links->targets);
+	free(links->sources);
+	free(links->in_offsets);
+	free(links->in_arcs);
+	free(links->in_sources);
+	free(links->active);
+	free(links->slot);
+	memset(links, 0, sizeof(*links));
+}
+
+void free_discrete_params(opinion_model *model)
+{
+	discrete_params *params = model->params;
+	if (!params)
+		return;
+	free_links(&params->links);
+	free(params->count);
+	free(params);
+}
+
+static bool arc_disagrees(const discrete_links *links,
+			  const opinion_space *os, size_t a)
+{
+	return get_discrete_opinion(os, (size_t)links->sources[a])
+	    != get_discrete_opinion(os, (size_t)links->targets[a]);
+}
+
+// Copies the out-neighbors of every node; with track_active also the
+// arcs into every node and the active arcs for the current states.
+// Returns 0 if out of memory, leaving links empty.
+static int build_links(discrete_links *links, graph *g,
+		       const opinion_space *os, bool track_active)
+{
+	int n = g->num_nodes;
+	memset(links, 0, sizeof(*links));
+	links->offsets = malloc(((size_t)n + 1) * sizeof(size_t));
+	if (!links->offsets)
+		return 0;
+	links->offsets[0] = 0;
+	for (int u = 0; u < n; u++) {
+		size_t degree = 0;
+		for (neighbor_iter it = graph_neighbors(g, u);
+		     neighbor_next(&it);)
+			degree++;
+		links->offsets[u + 1] = links->offsets[u] + degree;
+	}
+	size_t m = links->offsets[n];
+	links->num_arcs = m;
+	links->targets = malloc((m ? m : 1) * sizeof(int));
+	if (!links->targets)
+		goto fail;
+	for (int u = 0; u < n; u++) {
+		size_t a = links->offsets[u];
+		for (neighbor_iter it = graph_neighbors(g, u);
+		     neighbor_next(&it);)
+			links->targets[a++] = it.v;
+	}
+	if (!track_active)
+		return 1;
+
+	links->sources = malloc((m ? m : 1) * sizeof(int));
+	links->in_offsets = calloc((size_t)n + 1, sizeof(size_t));
+	links->in_arcs = malloc((m ? m : 1) * sizeof(size_t));
+	links->in_sources = malloc((m ? m : 1) * sizeof(int));
+	links->active = malloc((m ? m : 1) * sizeof(size_t));
+	links->slot = malloc((m ? m : 1) * sizeof(size_t));
+	if (!links->sources || !links->in_offsets || !links->in_arcs
+	    || !links->in_sources || !links->active || !links->slot)
+		goto fail;
+	for (int u = 0; u < n; u++)
+		for (size_t a = links->offsets[u]; a < links->offsets[u + 1];
+		     a++) {
+			links->sources[a] = u;
+			links->in_offsets[links->targets[a] + 1]++;
+		}
+	for (int v = 0; v < n; v++)
+		links->in_offsets[v + 1] += links->in_offsets[v];
+	// in_offsets[v] walks up to in_offsets[v + 1] while filling and is
+	// shifted back afterwards
+	for (size_t a = 0; a < m; a++) {
+		size_t k = links->in_offsets[links->targets[a]]++;
+		links->in_arcs[k] = a;
+		links->in_sources[k] = links->sources[a];
+	}
+	for (int v = n; v > 0; v--)
+		links->in_offsets[v] = links->in_offsets[v - 1];
+	links->in_offsets[0] = 0;
+
+	for (size_t a = 0; a < m; a++) {
+		links->slot[a] = NO_SLOT;
+		if (arc_disagrees(links, os, a)) {
+			links->slot[a] = links->num_active;
+			links->active[links->num_active++] = a;
+		}
+	}
+	return 1;
+
+fail:
+	free_links(links);
+	return 0;
+}
+
+// Puts arc a in or out of the active array after a change of one end
+static void refresh_arc(discrete_links *links, size_t a, bool disagrees)
+{
+	if (disagrees && links->slot[a] == NO_SLOT) {
+		links->slot[a] = links->num_active;
+		links->active[links->num_active++] = a;
+	} else if (!disagrees && links->slot[a] != NO_SLOT) {
+		size_t last = links->active[--links->num_active];
+		links->active[links->slot[a]] = last;
+		links->slot[last] = links->slot[a];
+		links->slot[a] = NO_SLOT;
+	}
+}
+
+// Random out-neighbor of u, -1 if it has none
+static int random_neighbor(const discrete_links *links, int u,
+			   rng_state *rng)
+{
+	size_t degree = links->offsets[u + 1] - links->offsets[u];
+	if (degree == 0)
+		return -1;
+	return links->targets[links->offsets[u] + rng_below(rng, degree)];
+}
+
+static void voter_update(opinion_model *model)
+{
+	discrete_params *params = model->params;
+	opinion_space *os = model->opinion_space;
+	if (os->num_agents == 0)
+		return;
+	int i = (int)rng_below(&model->rng, os->num_agents);
+	int j = random_neighbor(&params->links, i, &model->rng);
+	if (j >= 0)
+		set_discrete_opinion(os, (size_t)i,
+				     get_discrete_opinion(os, (size_t)j));
+}
+
+static void voter_active_update(opinion_model *model)
+{
+	discrete_params *params = model->params;
+	discrete_links *links = &params->links;
+	opinion_space *os = model->opinion_space;
+	if (links->num_active == 0)
+		return;
+
+	params->link_time += (double)links->num_arcs / links->num_active;
+	size_t a = links->active[rng_below(&model->rng, links->num_active)];
+	int i = links->sources[a];
+	int state = get_discrete_opinion(os, (size_t)links->targets[a]);
+	set_discrete_opinion(os, (size_t)i, state);
+	// Only the arcs at i change, and the state of that end is known:
+	// the other ends are read from the contiguous lists of i
+	for (size_t b = links->offsets[i]; b < links->offsets[i + 1]; b++)
+		refresh_arc(links, b,
+			    get_discrete_opinion(os, (size_t)links->targets[b])
+			    != state);
+	for (size_t k = links->in_offsets[i]; k < links->in_offsets[i + 1];
+	     k++)
+		refresh_arc(links, links->in_arcs[k],
+			    get_discrete_opinion(os,
+						 (size_t)links->in_sources[k])
+			    != state);
+}
+
+static void majority_update(opinion_model *model)
+{
+	discrete_params *params = model->params;
+	opinion_space *os = model->opinion_space;
+	size_t *count = params->count;
+	if (os->num_agents == 0)
+		return;
+	int i = (int)rng_below(&model->rng, os->num_agents);
+	discrete_neighbor_counts(os, model->network, i, count);
+
+	int own = get_discrete_opinion(os, (size_t)i);
+	size_t best = count[own];
+	int state = own, ties = 0;
+	for (unsigned s = 0; s < os->num_states; s++) {
+		if (count[s] < best || (int)s == own)
+			continue;
+		if (count[s] > best) {
+			best = count[s];
+			state = (int)s;
+			ties = 1;
+		} else if (state != own
+			   && rng_below(&model->rng, ++ties) == 0) {
+			// A tie between other states: uniform among them
+			state = (int)s;
+		}
+	}
+	set_discrete_opinion(os, (size_t)i, state);
+}
+
+static void sznajd_update(opinion_model *model)
+{
+	discrete_params *params = model->params;
+	const discrete_links *links = &params->links;
+	opinion_space *os = model->opinion_space;
+	if (os->num_agents == 0)
+		return;
+	int i = (int)rng_below(&model->rng, os->num_agents);
+	int j = random_neighbor(links, i, &model->rng);
+	if (j < 0)
+		return;
+	int state = get_discrete_opinion(os, (size_t)i);
+	if (get_discrete_opinion(os, (size_t)j) != state)
+		return;
+	for (size_t a = links->offsets[i]; a < links->offsets[i + 1]; a++)
+		set_discrete_opinion(os, (size_t)links->targets[a], state);
+	for (size_t a = links->offsets[j]; a < links->offsets[j + 1]; a++)
+		set_discrete_opinion(os, (size_t)links->targets[a], state);
+}
+
+static void (*const rule_update[])(opinion_model *) = {
+	[VOTER_RULE] = voter_update,
+	[MAJORITY_RULE] = majority_update,
+	[SZNAJD_RULE] = sznajd_update
+};
+
+// The nodes have been renumbered: the copied lists are rebuilt from the
+// network, which permute_model has already renumbered, as are the states
+static int permute_discrete_params(opinion_model *model, const int *new_id)
+{
+	(void)new_id;
+	discrete_params *params = model->params;
+	if (params->rule == MAJORITY_RULE)
+		return 1;
+	discrete_links links;
+	if (!build_links(&links, model->network, model->opinion_space,
+			 params->track_active))
+		return 0;
+	free_links(&params->links);
+	params->links = links;
+	return 1;
+}
+
+static opinion_model *create_discrete_model(graph *topology,
+					    unsigned num_states,
+					    discrete_rule rule,
+					    bool track_active, rng_state *rng)
+{
+	if (!topology)
+		return NULL;
+	rng_state own;
+	if (!rng) {
+		rng_seed(&own, rng_seed_from_rand());
+		rng = &own;
+	}
+	size_t n = (size_t)topology->num_nodes;
+	opinion_space *os = create_discrete_opinion_space(n, num_states);
+	discrete_params *params = calloc(1, sizeof(discrete_params));
+	opinion_model *model = NULL;
+	if (!os || !params)
+		goto fail;
+
+	for (size_t i = 0; i < n; i++)
+		set_discrete_opinion(os, i, (int)rng_below(rng, num_states));
+	params->rule = rule;
+	params->track_active = track_active;
+	if (rule == MAJORITY_RULE) {
+		params->count = malloc(num_states * sizeof(size_t));
+		if (!params->count)
+			goto fail;
+	} else if (!build_links(&params->links, topology, os,
+				track_active)) {
+		goto fail;
+	}
+
+	model = create_model(topology, os, params,
+			     track_active ? voter_active_update
+			     : rule_update[rule]);
+	if (!model)
+		goto fail;
+	model->permute_params = permute_discrete_params;
+	model->rng = *rng;
+	rng_jump(rng);
+	return model;
+
+fail:
+	if (params) {
+		free_links(&params->links);
+		free(params->count);
+		free(params);
+	}
+	free_opinion_space(os);
+	return NULL;
+}
+
+opinion_model *create_voter_model(graph *topology, unsigned num_states,
+				  rng_state *rng)
+{
+	return create_discrete_model(topology, num_states, VOTER_RULE, false,
+				     rng);
+}
+
+opinion_model *create_voter_model_active_links(graph *topology,
+					       unsigned num_states,
+					       rng_state *rng)
+{
+	return create_discrete_model(topology, num_states, VOTER_RULE, true,
+				     rng);
+}
+
+opinion_model *create_majority_rule_model(graph *topology,
+					  unsigned num_states,
+					  rng_state *rng)
+{
+	return create_discrete_model(topology, num_states, MAJORITY_RULE,
+				     false, rng);
+}
+
+opinion_model *create_sznajd_model(graph *topology, unsigned num_states,
+				   rng_state *rng)
+{
+	return create_discrete_model(topology, num_states, SZNAJD_RULE,
+				     false, rng);
+}
+
+size_t voter_active_links(const opinion_model *model)
+{
+	const discrete_params *params = model->params;
+	return params->track_active ? params->links.num_active : 0;
+}
+
+double voter_link_time(const opinion_model *model)
+{
+	const discrete_params *params = model->params;
+	return params->link_time;
+}
+
+bool discrete_model_absorbed(const opinion_model *model)
+{
+	const discrete_params *params = model->params;
+	if (params->track_active)
+		return params->links.num_active == 0;
+	return discrete_consensus(model->opinion_space);
+}
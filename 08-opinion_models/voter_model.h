@@ -0,0 +1,60 @@
+#ifndef VOTER_MODEL_H
+#define VOTER_MODEL_H
+
+#include "../05-abstract_opinion_model/abstract_opinion_model.h"
+#include "../04-abstract_opinion_space/discrete_opinion_space.h"
+#include <stdbool.h>
+#include <stdlib.h>
+
+// Discrete opinion dynamics on a discrete_opinion_space of num_states
+// states (2 for the binary models). Each update is one event:
+//
+//	voter		a random agent copies a random out-neighbor
+//	majority rule	a random agent takes the most common state among
+//			its out-neighbors, keeping its own if that is
+//			one of the most common (word-parallel counting
+//			on bit matrix storage, see discrete_neighbor_counts)
+//	Sznajd		a random agent and a random out-neighbor that
+//			agree convince every out-neighbor of both
+//
+// The initial states are drawn uniformly from rng, which then jumps past
+// the stream the model keeps for its updates; with rng NULL a generator
+// seeded from rand() is used. The voter and Sznajd engines copy the
+// neighbor lists at creation to pick random neighbors in O(1): later
+// changes to the network are not seen. run_simulation stops at
+// consensus for any convergence threshold in (0, 1].
+opinion_model *create_voter_model(graph * topology, unsigned num_states,
+				  rng_state * rng);
+opinion_model *create_majority_rule_model(graph * topology,
+					  unsigned num_states,
+					  rng_state * rng);
+opinion_model *create_sznajd_model(graph * topology, unsigned num_states,
+				   rng_state * rng);
+
+// Voter model that keeps the active links, the arcs (i, j) whose ends
+// disagree, in an array and makes i copy j along a random one of them:
+// the link-update voter model without the updates that change nothing.
+// An update costs the degree of the agent that changes, however rare
+// the active links have become, so the run to the absorbing state takes
+// as many updates as there are opinion changes. That pays off where the
+// active links thin out, as on lattices and clustered networks (50x on
+// a ring); on random graphs a large share of the links stays active
+// until the end and the plain voter model is faster.
+opinion_model *create_voter_model_active_links(graph * topology,
+					       unsigned num_states,
+					       rng_state * rng);
+// Active links left, 0 for the other engines
+size_t voter_active_links(const opinion_model * model);
+// Expected number of updates the link-update voter model would have
+// needed for the updates made so far (each one stands for arcs / active
+// links of them), 0 for the other engines
+double voter_link_time(const opinion_model * model);
+
+// No update can change anything any more: every agent agrees or, for
+// the active-link voter model, no active link is left (which also
+// covers consensus within each component of a disconnected graph).
+bool discrete_model_absorbed(const opinion_model * model);
+
+void free_discrete_params(opinion_model * model);
+
+#endif				// VOTER_MODEL_H
@@ -10,8 +10,7 @@ void write_current_state(opinion_model *model, size_t current_step,
 
 	char filepath[300];
 	size_t n = model->network->num_nodes;
-	size_t esize = model->opinion_space->element_size;
-	float *opinions = (float *)(model->opinion_space->opinions);
+	const opinion_space *os = model->opinion_space;
 
 	// Write opinions
 	snprintf(filepath, sizeof(filepath), "%s/%zu.opinions",
@@ -22,9 +21,21 @@ void write_current_state(opinion_model *model, size_t current_step,
 		return;
 	}
 
-	for (size_t i = 0; i < n; i++) {
-		float *op = (float *)((char *)opinions + i * esize);
-		fprintf(opinions_file, "%zu %.6f\n", i, *op);
+	// Lines are in original id order, whatever order the model keeps
+	// its nodes in (see reorder_model): the id, then one value per topic.
+	for (size_t k = 0; k < n; k++) {
+		size_t i = model->current_id ? (size_t)model->current_id[k] : k;
+		fprintf(opinions_file, "%zu", k);
+		if (os->type == OPINION_DISCRETE)
+			fprintf(opinions_file, " %d",
+				get_discrete_opinion(os, i));
+		else if (os->dim == 0)
+			fprintf(opinions_file, " %.6f",
+				*(const float *)os->get_opinion(os, (int)i));
+		for (size_t t = 0; t < os->dim; t++)
+			fprintf(opinions_file, " %.6f",
+				opinion_column(os, t)[i]);
+		fputc('\n', opinions_file);
 	}
 
 	fclose(opinions_file);
@@ -32,7 +43,7 @@ void write_current_state(opinion_model *model, size_t current_step,
 	// Write graph
 	snprintf(filepath, sizeof(filepath), "%s/%zu.graph", directoryname,
 		 current_step);
-	save_graph(model->network, filepath);
+	save_graph_with_ids(model->network, filepath, model->original_id);
 }
 
 int run_simulation(opinion_model *model, size_t max_steps,
@@ -66,8 +77,7 @@ int run_simulation(opinion_model *model, size_t max_steps,
 	}
 
 	size_t n = model->network->num_nodes;
-	void *opinions = model->opinion_space->opinions;
-	size_t esize = model->opinion_space->element_size;
+	opinion_space *os = model->opinion_space;
 	int current_step = 0;
 	for (size_t step = 0; step < max_steps; step++) {
 		model->update(model);
@@ -75,13 +85,20 @@ int run_simulation(opinion_model *model, size_t max_steps,
 		float max_opinion = -1e9f;
 		float min_opinion = 1e9f;
 
-		for (size_t i = 0; i < n; i++) {
-			float *current_op =
-			    (float *)((char *)opinions + i * esize);
-			if (*current_op > max_opinion)
-				max_opinion = *current_op;
-			if (*current_op < min_opinion)
-				min_opinion = *current_op;
+		if (os->dim > 0 || os->type == OPINION_DISCRETE) {
+			// Float or vector space: widest topic. Discrete
+			// space: 0 once every agent agrees.
+			min_opinion = 0.0f;
+			max_opinion = opinion_spread(os);
+		} else {
+			for (size_t i = 0; i < n; i++) {
+				const float *current_op =
+				    os->get_opinion(os, (int)i);
+				if (*current_op > max_opinion)
+					max_opinion = *current_op;
+				if (*current_op < min_opinion)
+					min_opinion = *current_op;
+			}
 		}
 
 		float diff = max_opinion - min_opinion;
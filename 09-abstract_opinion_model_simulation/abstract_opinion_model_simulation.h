@@ -1,4 +1,5 @@
 #include "../05-abstract_opinion_model/abstract_opinion_model.h"
+#include "../04-abstract_opinion_space/discrete_opinion_space.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
@@ -0,0 +1,52 @@
+// cpu_features.c
+#include "cpu_features.h"
+
+static simd_isa detected = SIMD_SCALAR;
+static int detection_done = 0;
+static simd_isa limit = SIMD_AVX512;
+
+static simd_isa detect(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f")
+	    && __builtin_cpu_supports("avx512bw")
+	    && __builtin_cpu_supports("avx512dq")
+	    && __builtin_cpu_supports("avx512vl"))
+		return SIMD_AVX512;
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+		return SIMD_AVX2;
+	if (__builtin_cpu_supports("sse2"))
+		return SIMD_SSE2;
+#endif
+	return SIMD_SCALAR;
+}
+
+simd_isa cpu_simd_isa(void)
+{
+	if (!detection_done) {
+		detected = detect();
+		detection_done = 1;
+	}
+	return detected < limit ? detected : limit;
+}
+
+void simd_isa_limit(simd_isa max)
+{
+	limit = max;
+}
+
+const char *simd_isa_name(simd_isa isa)
+{
+	switch (isa) {
+	case SIMD_SCALAR:
+		return "scalar";
+	case SIMD_SSE2:
+		return "sse2";
+	case SIMD_AVX2:
+		return "avx2";
+	case SIMD_AVX512:
+		return "avx512";
+	}
+	return "unknown";
+}
@@ -0,0 +1,23 @@
+// cpu_features.h
+#ifndef CPU_FEATURES_H
+#define CPU_FEATURES_H
+
+// Instruction set levels the SIMD kernels are compiled for, in order.
+typedef enum {
+	SIMD_SCALAR = 0,
+	SIMD_SSE2,
+	SIMD_AVX2,		// AVX2 + FMA
+	SIMD_AVX512		// AVX-512 F/BW/DQ/VL
+} simd_isa;
+
+// Best level supported by this CPU (detected once), capped by
+// simd_isa_limit().
+simd_isa cpu_simd_isa(void);
+
+// Caps the level returned by cpu_simd_isa(), e.g. to benchmark or test
+// the narrower kernels on a wider machine.
+void simd_isa_limit(simd_isa max);
+
+const char *simd_isa_name(simd_isa isa);
+
+#endif				// CPU_FEATURES_H
@@ -0,0 +1,74 @@
+// rng.c
+#include "rng.h"
+#include <stdlib.h>
+
+static uint64_t splitmix64(uint64_t *x)
+{
+	uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+void rng_seed(rng_state *rng, uint64_t seed)
+{
+	for (int i = 0; i < 4; i++)
+		rng->s[i] = splitmix64(&seed);
+}
+
+void rng_seed_stream(rng_state *rng, uint64_t seed, uint64_t stream)
+{
+	// Hash the pair first so that nearby seeds and streams do not give
+	// overlapping splitmix64 sequences.
+	uint64_t x = seed;
+	uint64_t key = splitmix64(&x) ^ stream;
+	rng_seed(rng, splitmix64(&key));
+}
+
+// Applies the xoshiro256** jump polynomial: the state after the jump is
+// the xor of the states at the set bits of the polynomial.
+static void jump_by(rng_state *rng, const uint64_t polynomial[4])
+{
+	uint64_t s[4] = { 0, 0, 0, 0 };
+	for (int w = 0; w < 4; w++)
+		for (int b = 0; b < 64; b++) {
+			if (polynomial[w] & ((uint64_t)1 << b))
+				for (int i = 0; i < 4; i++)
+					s[i] ^= rng->s[i];
+			rng_next(rng);
+		}
+	for (int i = 0; i < 4; i++)
+		rng->s[i] = s[i];
+}
+
+void rng_jump(rng_state *rng)
+{
+	static const uint64_t polynomial[4] = {
+		0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+		0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL
+	};
+	jump_by(rng, polynomial);
+}
+
+void rng_long_jump(rng_state *rng)
+{
+	static const uint64_t polynomial[4] = {
+		0x76e15d3efefdcbbfULL, 0xc5004e441c522fb3ULL,
+		0x77710069854ee241ULL, 0x39109bb02acbe635ULL
+	};
+	jump_by(rng, polynomial);
+}
+
+void rng_seed_run(rng_state *rng, uint64_t master_seed, uint64_t model,
+		  uint64_t run, int thread)
+{
+	uint64_t x = model;
+	rng_seed_stream(rng, master_seed ^ splitmix64(&x), run);
+	for (int t = 0; t < thread; t++)
+		rng_jump(rng);
+}
+
+uint64_t rng_seed_from_rand(void)
+{
+	return ((uint64_t)rand() << 32) ^ (uint64_t)rand();
+}
@@ -0,0 +1,87 @@
+// rng.h
+#ifndef RNG_H
+#define RNG_H
+#include <stdint.h>
+
+// xoshiro256** pseudo-random generator. Unlike rand() its state is an
+// explicit value, so a generator run can be repeated from its seed and
+// several generators never share state.
+typedef struct {
+	uint64_t s[4];
+} rng_state;
+
+// Expands seed into a full state with splitmix64; every seed, including
+// 0, gives a valid generator.
+void rng_seed(rng_state * rng, uint64_t seed);
+
+// Seeds generator number stream of a family sharing one seed. Work split
+// into chunks that each draw from rng_seed_stream(&rng, seed, chunk)
+// gives the same result no matter which thread runs which chunk.
+void rng_seed_stream(rng_state * rng, uint64_t seed, uint64_t stream);
+
+// Advances rng by 2^128 draws (rng_long_jump: 2^192). Generators split
+// off by jumping never overlap: each of 2^64 jumps gets 2^128 draws.
+void rng_jump(rng_state * rng);
+void rng_long_jump(rng_state * rng);
+
+// Generator of one thread of one run of one model, all derived from a
+// single master seed. Every (model, run) pair gets its own hashed stream
+// and the threads of a run take consecutive jumps of it. The result
+// depends on these four numbers only, so an ensemble repeats bit for bit
+// however its runs are spread over threads.
+void rng_seed_run(rng_state * rng, uint64_t master_seed, uint64_t model,
+		  uint64_t run, int thread);
+
+// Seed from rand(), for code that predates explicit generators: srand()
+// keeps making its runs repeatable.
+uint64_t rng_seed_from_rand(void);
+
+static inline uint64_t rng_rotl(uint64_t x, int k)
+{
+	return (x << k) | (x >> (64 - k));
+}
+
+static inline uint64_t rng_next(rng_state * rng)
+{
+	uint64_t *s = rng->s;
+	uint64_t result = rng_rotl(s[1] * 5, 7) * 9;
+	uint64_t t = s[1] << 17;
+
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+	s[2] ^= t;
+	s[3] = rng_rotl(s[3], 45);
+	return result;
+}
+
+// Uniform double in [0, 1) with 53 random bits
+static inline double rng_uniform(rng_state * rng)
+{
+	return (double)(rng_next(rng) >> 11) * 0x1.0p-53;
+}
+
+// Uniform float in [0, 1) with 24 random bits
+static inline float rng_uniform_float(rng_state * rng)
+{
+	return (float)(rng_next(rng) >> 40) * 0x1.0p-24f;
+}
+
+// Uniform integer in [0, bound) for bound > 0, without modulo bias
+// (Lemire's multiply-and-reject method).
+static inline uint64_t rng_below(rng_state * rng, uint64_t bound)
+{
+	unsigned __int128 product = (unsigned __int128)rng_next(rng) * bound;
+	uint64_t low = (uint64_t)product;
+	if (low < bound) {
+		uint64_t threshold = -bound % bound;
+		while (low < threshold) {
+			product = (unsigned __int128)rng_next(rng) * bound;
+			low = (uint64_t)product;
+		}
+	}
+	return (uint64_t)(product >> 64);
+}
+
+#endif				// RNG_H
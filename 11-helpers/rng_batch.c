@@ -0,0 +1,249 @@
+// rng_batch.c
+#include "rng_batch.h"
+#include "cpu_features.h"
+#include <math.h>
+#include <string.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_KERNELS 1
+#endif
+
+// Words drawn per block by the fill functions: out[k * RNG_LANES + j] is
+// step k of lane j.
+#define BLOCK_STEPS 32
+#define BLOCK_WORDS (BLOCK_STEPS * RNG_LANES)
+
+void rng_lanes_seed(rng_lanes *lanes, uint64_t seed, uint64_t stream)
+{
+	rng_state rng, lane;
+	rng_seed_stream(&rng, seed, stream);
+	for (int j = 0; j < RNG_LANES; j++) {
+		rng_seed(&lane, rng_next(&rng));
+		for (int i = 0; i < 4; i++)
+			lanes->s[i][j] = lane.s[i];
+	}
+}
+
+// The xoshiro256** step of rng_next, on every lane
+static void steps_scalar(rng_lanes *lanes, uint64_t *out, size_t steps)
+{
+	for (int j = 0; j < RNG_LANES; j++) {
+		rng_state lane = { { lanes->s[0][j], lanes->s[1][j],
+				     lanes->s[2][j], lanes->s[3][j] } };
+		for (size_t k = 0; k < steps; k++)
+			out[k * RNG_LANES + j] = rng_next(&lane);
+		for (int i = 0; i < 4; i++)
+			lanes->s[i][j] = lane.s[i];
+	}
+}
+
+#ifdef HAVE_X86_KERNELS
+// No 64-bit rotate or multiply before AVX-512: x * 5 and x * 9 are a
+// shift and an add.
+#define ROTL256(x, k) \
+	_mm256_or_si256(_mm256_slli_epi64((x), (k)), \
+			_mm256_srli_epi64((x), 64 - (k)))
+#define TIMES5_256(x) _mm256_add_epi64((x), _mm256_slli_epi64((x), 2))
+#define TIMES9_256(x) _mm256_add_epi64((x), _mm256_slli_epi64((x), 3))
+
+__attribute__((target("avx2")))
+static void steps_avx2(rng_lanes *lanes, uint64_t *out, size_t steps)
+{
+	// Lanes 0-3 and 4-7 as two independent chains. Unaligned access: a
+	// malloc'ed rng_lanes may not have the alignment of its type.
+	__m256i s[2][4];
+	for (int h = 0; h < 2; h++)
+		for (int i = 0; i < 4; i++)
+			s[h][i] = _mm256_loadu_si256((const __m256i *)
+						    &lanes->s[i][4 * h]);
+	for (size_t k = 0; k < steps; k++)
+		for (int h = 0; h < 2; h++) {
+			__m256i result = TIMES9_256(ROTL256(TIMES5_256(s[h][1]),
+							    7));
+			_mm256_storeu_si256((__m256i *)
+					    (out + k * RNG_LANES + 4 * h),
+					    result);
+			__m256i t = _mm256_slli_epi64(s[h][1], 17);
+			s[h][2] = _mm256_xor_si256(s[h][2], s[h][0]);
+			s[h][3] = _mm256_xor_si256(s[h][3], s[h][1]);
+			s[h][1] = _mm256_xor_si256(s[h][1], s[h][2]);
+			s[h][0] = _mm256_xor_si256(s[h][0], s[h][3]);
+			s[h][2] = _mm256_xor_si256(s[h][2], t);
+			s[h][3] = ROTL256(s[h][3], 45);
+		}
+	for (int h = 0; h < 2; h++)
+		for (int i = 0; i < 4; i++)
+			_mm256_storeu_si256((__m256i *) & lanes->s[i][4 * h],
+					   s[h][i]);
+}
+
+#define TIMES5_512(x) _mm512_add_epi64((x), _mm512_slli_epi64((x), 2))
+#define TIMES9_512(x) _mm512_add_epi64((x), _mm512_slli_epi64((x), 3))
+
+__attribute__((target("avx512f")))
+static void steps_avx512(rng_lanes *lanes, uint64_t *out, size_t steps)
+{
+	__m512i s0 = _mm512_loadu_si512(lanes->s[0]);
+	__m512i s1 = _mm512_loadu_si512(lanes->s[1]);
+	__m512i s2 = _mm512_loadu_si512(lanes->s[2]);
+	__m512i s3 = _mm512_loadu_si512(lanes->s[3]);
+	for (size_t k = 0; k < steps; k++) {
+		__m512i result =
+		    TIMES9_512(_mm512_rol_epi64(TIMES5_512(s1), 7));
+		_mm512_storeu_si512(out + k * RNG_LANES, result);
+		__m512i t = _mm512_slli_epi64(s1, 17);
+		s2 = _mm512_xor_si512(s2, s0);
+		s3 = _mm512_xor_si512(s3, s1);
+		s1 = _mm512_xor_si512(s1, s2);
+		s0 = _mm512_xor_si512(s0, s3);
+		s2 = _mm512_xor_si512(s2, t);
+		s3 = _mm512_rol_epi64(s3, 45);
+	}
+	_mm512_storeu_si512(lanes->s[0], s0);
+	_mm512_storeu_si512(lanes->s[1], s1);
+	_mm512_storeu_si512(lanes->s[2], s2);
+	_mm512_storeu_si512(lanes->s[3], s3);
+}
+#endif
+
+// count steps of every lane, count * RNG_LANES words into out
+static void step_lanes(rng_lanes *lanes, uint64_t *out, size_t count)
+{
+#ifdef HAVE_X86_KERNELS
+	simd_isa isa = cpu_simd_isa();
+	if (isa >= SIMD_AVX512) {
+		steps_avx512(lanes, out, count);
+		return;
+	}
+	if (isa >= SIMD_AVX2) {
+		steps_avx2(lanes, out, count);
+		return;
+	}
+#endif
+	steps_scalar(lanes, out, count);
+}
+
+void rng_fill_u64(rng_lanes *lanes, uint64_t *out, size_t count)
+{
+	size_t whole = count / RNG_LANES;
+	step_lanes(lanes, out, whole);
+	if (count % RNG_LANES) {
+		uint64_t last[RNG_LANES];
+		step_lanes(lanes, last, 1);
+		memcpy(out + whole * RNG_LANES, last,
+		       (count % RNG_LANES) * sizeof(uint64_t));
+	}
+}
+
+// The top 24 bits of each 32-bit word, scaled to [0, 1)
+static void words_to_floats(const uint32_t *words, float *out, size_t count)
+{
+	for (size_t k = 0; k < count; k++)
+		out[k] = (float)(int32_t)(words[k] >> 8) * 0x1.0p-24f;
+}
+
+#ifdef HAVE_X86_KERNELS
+__attribute__((target("avx2")))
+static void words_to_floats_avx2(const uint32_t *words, float *out,
+				 size_t count)
+{
+	const __m256 scale = _mm256_set1_ps(0x1.0p-24f);
+	size_t k = 0;
+	for (; k + 8 <= count; k += 8) {
+		__m256i w = _mm256_loadu_si256((const __m256i *)(words + k));
+		__m256 f = _mm256_cvtepi32_ps(_mm256_srli_epi32(w, 8));
+		_mm256_storeu_ps(out + k, _mm256_mul_ps(f, scale));
+	}
+	words_to_floats(words + k, out + k, count - k);
+}
+#endif
+
+// Uniform floats come two to a word, one from each 32-bit half
+void rng_fill_uniform_float(rng_lanes *lanes, float *out, size_t count)
+{
+	union {
+		uint64_t w64[BLOCK_WORDS];
+		uint32_t w32[2 * BLOCK_WORDS];
+	} block;
+	for (size_t done = 0; done < count;) {
+		step_lanes(lanes, block.w64, BLOCK_STEPS);
+		size_t take = count - done < 2 * BLOCK_WORDS
+		    ? count - done : 2 * BLOCK_WORDS;
+#ifdef HAVE_X86_KERNELS
+		if (cpu_simd_isa() >= SIMD_AVX2)
+			words_to_floats_avx2(block.w32, out + done, take);
+		else
+#endif
+			words_to_floats(block.w32, out + done, take);
+		done += take;
+	}
+}
+
+void rng_fill_uniform(rng_lanes *lanes, double *out, size_t count)
+{
+	uint64_t block[BLOCK_WORDS];
+	for (size_t done = 0; done < count;) {
+		step_lanes(lanes, block, BLOCK_STEPS);
+		size_t take = count - done < BLOCK_WORDS
+		    ? count - done : BLOCK_WORDS;
+		for (size_t k = 0; k < take; k++)
+			out[done + k] = (double)(block[k] >> 11) * 0x1.0p-53;
+		done += take;
+	}
+}
+
+void rng_fill_below(rng_lanes *lanes, uint32_t *out, size_t count,
+		    uint32_t bound)
+{
+	union {
+		uint64_t w64[BLOCK_WORDS];
+		uint32_t w32[2 * BLOCK_WORDS];
+	} block;
+	uint32_t threshold = (uint32_t)-bound % bound;
+	size_t used = 2 * BLOCK_WORDS;
+	for (size_t k = 0; k < count; k++) {
+		uint64_t product;
+		do {
+			if (used == 2 * BLOCK_WORDS) {
+				step_lanes(lanes, block.w64, BLOCK_STEPS);
+				used = 0;
+			}
+			product = (uint64_t)block.w32[used++] * bound;
+		} while ((uint32_t)product < threshold);
+		out[k] = (uint32_t)(product >> 32);
+	}
+}
+
+void rng_fill_normal(rng_lanes *lanes, float *out, size_t count,
+		     float mean, float stddev)
+{
+	float uniform[2 * BLOCK_WORDS];
+	for (size_t done = 0; done < count;) {
+		rng_fill_uniform_float(lanes, uniform, 2 * BLOCK_WORDS);
+		size_t take = count - done < 2 * BLOCK_WORDS
+		    ? count - done : 2 * BLOCK_WORDS;
+		for (size_t k = 0; k < take; k += 2) {
+			// 1 - u is in (0, 1], so the log is finite
+			float r = sqrtf(-2.0f * logf(1.0f - uniform[k]));
+			float theta = 6.28318531f * uniform[k + 1];
+			out[done + k] = mean + stddev * r * cosf(theta);
+			if (k + 1 < take)
+				out[done + k + 1] = mean
+				    + stddev * r * sinf(theta);
+		}
+		done += take;
+	}
+}
+
+void rng_buffer_seed(rng_buffer *buffer, uint64_t seed, uint64_t stream)
+{
+	rng_lanes_seed(&buffer->lanes, seed, stream);
+	buffer->next = RNG_BUFFER_WORDS;
+}
+
+void rng_buffer_refill(rng_buffer *buffer)
+{
+	step_lanes(&buffer->lanes, buffer->words.w64,
+		   RNG_BUFFER_WORDS / 2 / RNG_LANES);
+	buffer->next = 0;
+}
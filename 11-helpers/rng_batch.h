@@ -0,0 +1,89 @@
+// rng_batch.h
+#ifndef RNG_BATCH_H
+#define RNG_BATCH_H
+#include <stddef.h>
+#include <stdint.h>
+#include "rng.h"
+
+// Random numbers in bulk from RNG_LANES xoshiro256** generators that are
+// stepped side by side, one SIMD instruction advancing all of them (AVX2
+// or AVX-512 when the CPU has it, see cpu_features.h). The lanes are
+// always interleaved in the same order, so the numbers depend on the
+// seed only, not on the instruction set that produced them.
+
+#define RNG_LANES 8
+
+typedef struct {
+	uint64_t s[4][RNG_LANES] __attribute__((aligned(64)));
+} rng_lanes;
+
+// Seeds every lane from generator number stream of seed (see
+// rng_seed_stream), so chunks of parallel work can each take a stream.
+void rng_lanes_seed(rng_lanes * lanes, uint64_t seed, uint64_t stream);
+
+// Fill out[0 .. count). Draws are taken in blocks: the numbers of one
+// call do not continue where the previous call stopped mid-block.
+void rng_fill_u64(rng_lanes * lanes, uint64_t * out, size_t count);
+// Uniform in [0, 1) with 24 (float) or 53 (double) random bits
+void rng_fill_uniform_float(rng_lanes * lanes, float *out, size_t count);
+void rng_fill_uniform(rng_lanes * lanes, double *out, size_t count);
+// Uniform in [0, bound) for bound > 0, without modulo bias (Lemire)
+void rng_fill_below(rng_lanes * lanes, uint32_t * out, size_t count,
+		    uint32_t bound);
+// Normal with the given mean and standard deviation (Box-Muller)
+void rng_fill_normal(rng_lanes * lanes, float *out, size_t count,
+		     float mean, float stddev);
+
+// Buffered single draws for loops that need one number at a time: the
+// buffer is refilled RNG_BUFFER_WORDS 32-bit words at a time, so a draw
+// is a load and a compare. A buffer belongs to one thread; parallel code
+// keeps one per worker or per chunk.
+
+#define RNG_BUFFER_WORDS 512
+
+typedef struct {
+	rng_lanes lanes;
+	union {
+		uint64_t w64[RNG_BUFFER_WORDS / 2];
+		uint32_t w32[RNG_BUFFER_WORDS];
+	} words;
+	size_t next;		// next unused word, RNG_BUFFER_WORDS if empty
+} rng_buffer;
+
+void rng_buffer_seed(rng_buffer * buffer, uint64_t seed, uint64_t stream);
+void rng_buffer_refill(rng_buffer * buffer);
+
+static inline uint32_t rng_buffer_next(rng_buffer * buffer)
+{
+	if (buffer->next == RNG_BUFFER_WORDS)
+		rng_buffer_refill(buffer);
+	return buffer->words.w32[buffer->next++];
+}
+
+// Uniform float in [0, 1) with 24 random bits
+static inline float rng_buffer_float(rng_buffer * buffer)
+{
+	return (float)(rng_buffer_next(buffer) >> 8) * 0x1.0p-24f;
+}
+
+// Uniform double in [0, 1) with 53 random bits, from two words
+static inline double rng_buffer_uniform(rng_buffer * buffer)
+{
+	uint64_t high = rng_buffer_next(buffer);
+	uint64_t low = rng_buffer_next(buffer);
+	return (double)((high << 21) | (low >> 11)) * 0x1.0p-53;
+}
+
+// Uniform integer in [0, bound) for bound > 0 (Lemire)
+static inline uint32_t rng_buffer_below(rng_buffer * buffer, uint32_t bound)
+{
+	uint64_t product = (uint64_t)rng_buffer_next(buffer) * bound;
+	if ((uint32_t)product < bound) {
+		uint32_t threshold = (uint32_t)-bound % bound;
+		while ((uint32_t)product < threshold)
+			product = (uint64_t)rng_buffer_next(buffer) * bound;
+	}
+	return (uint32_t)(product >> 32);
+}
+
+#endif				// RNG_BATCH_H
@@ -0,0 +1,168 @@
+// thread_pool.c
+#include "thread_pool.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static struct {
+	pthread_mutex_t lock;
+	pthread_cond_t work_ready;
+	pthread_cond_t work_done;
+	pthread_t *threads;
+	int num_threads;	// workers including the caller, 0 = not started
+	int shutdown;
+	unsigned long generation;	// bumped for every job
+	unsigned long spawn_generation;	// generation the workers start at
+
+	// Current job
+	parallel_fn fn;
+	void *ctx;
+	size_t count;
+	size_t grain;
+	atomic_size_t next;
+	int running;		// pool threads still working on the job
+} pool = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.work_ready = PTHREAD_COND_INITIALIZER,
+	.work_done = PTHREAD_COND_INITIALIZER,
+};
+
+// Set while a thread executes chunks, to run nested calls serially.
+static _Thread_local int inside_job = 0;
+
+static void run_chunks(int worker)
+{
+	inside_job = 1;
+	for (;;) {
+		size_t begin = atomic_fetch_add(&pool.next, pool.grain);
+		if (begin >= pool.count)
+			break;
+		size_t end = begin + pool.grain;
+		if (end > pool.count)
+			end = pool.count;
+		pool.fn(pool.ctx, begin, end, worker);
+	}
+	inside_job = 0;
+}
+
+static void *worker_main(void *arg)
+{
+	int worker = (int)(size_t)arg;
+	unsigned long seen;
+
+	pthread_mutex_lock(&pool.lock);
+	seen = pool.spawn_generation;
+	for (;;) {
+		while (pool.generation == seen && !pool.shutdown)
+			pthread_cond_wait(&pool.work_ready, &pool.lock);
+		if (pool.shutdown)
+			break;
+		seen = pool.generation;
+		pthread_mutex_unlock(&pool.lock);
+
+		run_chunks(worker);
+
+		pthread_mutex_lock(&pool.lock);
+		if (--pool.running == 0)
+			pthread_cond_signal(&pool.work_done);
+	}
+	pthread_mutex_unlock(&pool.lock);
+	return NULL;
+}
+
+// Called with pool.lock held
+static void start_locked(int num_threads)
+{
+	if (num_threads <= 0) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		num_threads = cpus > 0 ? (int)cpus : 1;
+	}
+
+	pool.shutdown = 0;
+	pool.spawn_generation = pool.generation;
+	pool.threads = malloc((size_t)num_threads * sizeof(pthread_t));
+	pool.num_threads = 1;
+	if (!pool.threads)
+		return;
+	for (int i = 1; i < num_threads; i++) {
+		if (pthread_create(&pool.threads[i], NULL, worker_main,
+				   (void *)(size_t)i) != 0)
+			break;
+		pool.num_threads++;
+	}
+}
+
+void thread_pool_init(int num_threads)
+{
+	pthread_mutex_lock(&pool.lock);
+	if (pool.num_threads == 0)
+		start_locked(num_threads);
+	pthread_mutex_unlock(&pool.lock);
+}
+
+int thread_pool_size(void)
+{
+	thread_pool_init(0);
+	return pool.num_threads;
+}
+
+void parallel_for(size_t count, size_t grain, parallel_fn fn, void *ctx)
+{
+	if (count == 0)
+		return;
+	if (grain == 0)
+		grain = 1;
+
+	thread_pool_init(0);
+	if (inside_job || pool.num_threads == 1 || count <= grain) {
+		fn(ctx, 0, count, 0);
+		return;
+	}
+
+	// One job at a time; concurrent callers queue up here.
+	static pthread_mutex_t job_lock = PTHREAD_MUTEX_INITIALIZER;
+	pthread_mutex_lock(&job_lock);
+
+	pthread_mutex_lock(&pool.lock);
+	pool.fn = fn;
+	pool.ctx = ctx;
+	pool.count = count;
+	pool.grain = grain;
+	atomic_store(&pool.next, 0);
+	pool.running = pool.num_threads - 1;
+	pool.generation++;
+	pthread_cond_broadcast(&pool.work_ready);
+	pthread_mutex_unlock(&pool.lock);
+
+	run_chunks(0);
+
+	pthread_mutex_lock(&pool.lock);
+	while (pool.running > 0)
+		pthread_cond_wait(&pool.work_done, &pool.lock);
+	pthread_mutex_unlock(&pool.lock);
+
+	pthread_mutex_unlock(&job_lock);
+}
+
+void thread_pool_shutdown(void)
+{
+	pthread_mutex_lock(&pool.lock);
+	if (pool.num_threads == 0) {
+		pthread_mutex_unlock(&pool.lock);
+		return;
+	}
+	pool.shutdown = 1;
+	pthread_cond_broadcast(&pool.work_ready);
+	int num_threads = pool.num_threads;
+	pthread_mutex_unlock(&pool.lock);
+
+	for (int i = 1; i < num_threads; i++)
+		pthread_join(pool.threads[i], NULL);
+
+	pthread_mutex_lock(&pool.lock);
+	free(pool.threads);
+	pool.threads = NULL;
+	pool.num_threads = 0;
+	pthread_mutex_unlock(&pool.lock);
+}
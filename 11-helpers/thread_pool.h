@@ -0,0 +1,28 @@
+// thread_pool.h
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+#include <stddef.h>
+
+// Work function for parallel_for: handles items [begin, end). worker is
+// in [0, thread_pool_size()) and is stable for the duration of the call,
+// so it can index per-thread scratch buffers.
+typedef void (*parallel_fn)(void *ctx, size_t begin, size_t end,
+			    int worker);
+
+// Starts the shared pool with num_threads workers (the calling thread
+// included). 0 means one per online CPU. Optional: the first
+// parallel_for starts the pool with the default size.
+void thread_pool_init(int num_threads);
+
+// Number of workers parallel_for may use, the caller included.
+int thread_pool_size(void);
+
+// Splits [0, count) into chunks of `grain` items handed out dynamically
+// to the pool and returns once every chunk is done. Calls made from
+// inside a running job execute serially on the calling worker.
+void parallel_for(size_t count, size_t grain, parallel_fn fn, void *ctx);
+
+// Joins the worker threads. The pool restarts on the next parallel_for.
+void thread_pool_shutdown(void);
+
+#endif				// THREAD_POOL_H
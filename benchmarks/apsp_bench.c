@@ -0,0 +1,148 @@
+// apsp_bench.c: scalar vs blocked Floyd-Warshall on random weighted
+// graphs. Usage: ./apsp_bench [n ...]   (default: 2048 8192 16384)
+//
+// The scalar loop runs in full up to SCALAR_FULL_MAX nodes. Above that
+// only its first SCALAR_PIVOTS pivots are timed and the total is
+// extrapolated (every pivot costs the same n^2 work), marked "(est.)".
+#include "shortest_paths.h"
+#include "thread_pool.h"
+#include "cpu_features.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#define SCALAR_FULL_MAX 2048
+#define SCALAR_PIVOTS 32
+#define EDGE_PROBABILITY 0.05
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static unsigned long long rng_state;
+
+static double next_uniform(void)
+{
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 7;
+	rng_state ^= rng_state << 17;
+	return (rng_state >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Same seed, same matrix: every method starts from identical input
+static float *random_weights(int n)
+{
+	float *dist = malloc((size_t)n * n * sizeof(float));
+	if (!dist)
+		return NULL;
+	rng_state = 0x9e3779b97f4a7c15ULL;
+	for (int i = 0; i < n; i++)
+		for (int j = 0; j < n; j++) {
+			float w = SP_INF;
+			if (next_uniform() < EDGE_PROBABILITY)
+				w = 1.0f + 9.0f * (float)next_uniform();
+			dist[(size_t)i * n + j] = (i == j) ? 0.0f : w;
+		}
+	return dist;
+}
+
+// The first `pivots` iterations of floyd_warshall_scalar's k loop
+static void scalar_pivots(float *dist, int n, int pivots)
+{
+	for (int k = 0; k < pivots; k++)
+		for (int i = 0; i < n; i++) {
+			float dik = dist[(size_t)i * n + k];
+			for (int j = 0; j < n; j++) {
+				float dkj = dist[(size_t)k * n + j];
+				if (dik < SP_INF && dkj < SP_INF) {
+					float alt = dik + dkj;
+					if (alt < dist[(size_t)i * n + j])
+						dist[(size_t)i * n + j] = alt;
+				}
+			}
+		}
+}
+
+static double max_difference(const float *a, const float *b, size_t count)
+{
+	double diff = 0.0;
+	for (size_t p = 0; p < count; p++)
+		diff = fmax(diff, fabs((double)a[p] - b[p]));
+	return diff;
+}
+
+static void bench(int n)
+{
+	float *reference = random_weights(n);
+	if (!reference) {
+		printf("%6d  out of memory\n", n);
+		return;
+	}
+
+	double scalar;
+	int estimated = n > SCALAR_FULL_MAX;
+	double start = now();
+	if (estimated) {
+		scalar_pivots(reference, n, SCALAR_PIVOTS);
+		scalar = (now() - start) * n / SCALAR_PIVOTS;
+		free(reference);
+		reference = NULL;
+	} else {
+		floyd_warshall_scalar(reference, n);
+		scalar = now() - start;
+	}
+	printf("%6d  scalar       %9.3f s%s\n", n, scalar,
+	       estimated ? " (est.)" : "");
+
+	simd_isa best = cpu_simd_isa();
+	for (simd_isa isa = SIMD_SCALAR; isa <= best; isa++) {
+		if (isa == SIMD_SSE2)
+			continue;	// no SSE kernel: same as scalar
+		simd_isa_limit(isa);
+		float *dist = random_weights(n);
+		if (!dist)
+			break;
+		start = now();
+		int ok = floyd_warshall_blocked(dist, n);
+		double blocked = now() - start;
+		if (!ok) {
+			printf("%6d  blocked      out of memory\n", n);
+		} else {
+			printf("%6d  blocked/%-6s%9.3f s  %6.1fx",
+			       n, floyd_warshall_blocked_kernel(), blocked,
+			       scalar / blocked);
+			if (reference)
+				printf("  max |diff| %g",
+				       max_difference(reference, dist,
+						      (size_t)n * n));
+			printf("\n");
+		}
+		free(dist);
+	}
+	simd_isa_limit(SIMD_AVX512);
+	free(reference);
+}
+
+int main(int argc, char **argv)
+{
+	static const int default_sizes[] = { 2048, 8192, 16384 };
+
+	thread_pool_init(0);
+	printf("threads: %d, best kernel: %s\n", thread_pool_size(),
+	       floyd_warshall_blocked_kernel());
+	if (argc > 1) {
+		for (int a = 1; a < argc; a++)
+			bench(atoi(argv[a]));
+	} else {
+		for (size_t s = 0;
+		     s < sizeof(default_sizes) / sizeof(default_sizes[0]); s++)
+			bench(default_sizes[s]);
+	}
+	thread_pool_shutdown();
+	return 0;
+}
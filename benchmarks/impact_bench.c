@@ -0,0 +1,127 @@
+// impact_bench.c: the social impact sum of one agent, the inner loop of
+// every update of the social impact model, per instruction set.
+// Usage: ./impact_bench [n ...]   (default: 1000 3000 10000 30000 100000)
+//
+// Each row holds the weights of one agent: 0 on the diagonal and for a
+// tenth of the pairs (the unreachable ones), 1 / d^2 for random hop
+// counts d elsewhere. "cached" sums the same row over and over, "rows"
+// cycles through ROWS_BYTES of distinct rows as the random agents of
+// the updates do. "ulp" is the largest difference from the scalar sum
+// in ulp(A), against the bound 2 (n + 4) of impact_weights.h.
+#include "cpu_features.h"
+#include "rng.h"
+#include "04-abstract_opinion_space/abstract_opinion_space.h"
+#include "08-opinion_models/impact_weights.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#define SEED 42
+#define ROWS_BYTES (64u << 20)
+#define ELEMENTS_PER_RUN 200000000.0
+#define ULP_TRIALS 256
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// sum_j w_j (|p_j - s_j| + |oi o_j (p_j + s_j)|)
+static double error_scale(const float *w, const float *p, const float *s,
+			  const float *o, float oi, size_t n)
+{
+	double a = 0.0;
+	for (size_t j = 0; j < n; j++)
+		a += w[j] * (fabs((double)p[j] - s[j])
+			     + fabs((double)oi * o[j] * ((double)p[j] + s[j])));
+	return a;
+}
+
+static void bench(size_t n, rng_state *rng)
+{
+	size_t stride = (n + FLOAT_ARRAY_PAD - 1) / FLOAT_ARRAY_PAD
+	    * FLOAT_ARRAY_PAD;
+	size_t rows = ROWS_BYTES / (stride * sizeof(float));
+	if (rows < 2)
+		rows = 2;
+	float *w = alloc_float_array(rows * stride);
+	float *p = alloc_float_array(n);
+	float *s = alloc_float_array(n);
+	float *o = alloc_float_array(n);
+	if (!w || !p || !s || !o) {
+		fprintf(stderr, "n = %zu: out of memory\n", n);
+		goto out;
+	}
+	for (size_t j = 0; j < n; j++) {
+		p[j] = 2.0f * rng_uniform_float(rng) - 1.0f;
+		s[j] = 2.0f * rng_uniform_float(rng) - 1.0f;
+		o[j] = 2.0f * rng_uniform_float(rng) - 1.0f;
+	}
+	for (size_t r = 0; r < rows; r++) {
+		float *row = w + r * stride;
+		for (size_t j = 0; j < n; j++) {
+			float d = 1.0f + (float)rng_below(rng, 8);
+			row[j] = rng_below(rng, 10) == 0 ? 0.0f : 1.0f / (d * d);
+		}
+		row[r % n] = 0.0f;
+	}
+
+	simd_isa best = cpu_simd_isa();
+	size_t calls = (size_t)(ELEMENTS_PER_RUN / n) + 1;
+	for (simd_isa isa = SIMD_SCALAR; isa <= best; isa++) {
+		simd_isa_limit(isa);
+		double sum = 0.0, start = now();
+		for (size_t c = 0; c < calls; c++)
+			sum += impact_sum(w, p, s, o, o[c % n], n);
+		double cached = (now() - start) / calls;
+		start = now();
+		for (size_t c = 0; c < calls; c++)
+			sum += impact_sum(w + (c % rows) * stride, p, s, o,
+					  o[c % n], n);
+		double cycled = (now() - start) / calls;
+
+		double worst = 0.0;
+		for (size_t t = 0; t < ULP_TRIALS; t++) {
+			const float *row = w + (t % rows) * stride;
+			float oi = o[t % n];
+			float ref = impact_sum_scalar(row, p, s, o, oi, n);
+			float got = impact_sum(row, p, s, o, oi, n);
+			double a = error_scale(row, p, s, o, oi, n);
+			double ulp = a > 0.0 ? ldexp(1.0, ilogb(a) - 23) : 1.0;
+			if (fabs((double)got - ref) / ulp > worst)
+				worst = fabs((double)got - ref) / ulp;
+		}
+		printf("%7zu  %-7s %9.2f us %7.2f GB/s %9.2f us %7.2f GB/s"
+		       " %6.1f / %zu ulp  (%.3g)\n", n, simd_isa_name(isa),
+		       cached * 1e6, n * sizeof(float) / cached * 1e-9,
+		       cycled * 1e6, n * sizeof(float) / cycled * 1e-9,
+		       worst, 2 * (n + 4), sum);
+	}
+	simd_isa_limit(best);
+
+out:
+	free(w);
+	free(p);
+	free(s);
+	free(o);
+}
+
+int main(int argc, char **argv)
+{
+	static const size_t sizes[] = { 1000, 3000, 10000, 30000, 100000 };
+	rng_state rng;
+	rng_seed(&rng, SEED);
+	printf("best kernel: %s\n", impact_sum_kernel());
+	printf("%7s  %-7s %23s %23s %22s\n", "n", "kernel", "cached",
+	       "rows", "max diff / bound");
+	if (argc > 1)
+		for (int a = 1; a < argc; a++)
+			bench(strtoull(argv[a], NULL, 10), &rng);
+	else
+		for (size_t k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++)
+			bench(sizes[k], &rng);
+	return 0;
+}
@@ -0,0 +1,207 @@
+// reorder_bench.c: social impact model throughput per node ordering.
+// Usage: ./reorder_bench [n]   (default: 1000000)
+//
+// The ids of every graph are shuffled first, as the ids of an imported
+// file carry no locality. For each ordering a fresh model on the
+// shuffled graph is reordered with reorder_model and timed on two
+// kernels: n asynchronous updates over the distance balls, and full
+// sweeps of sum_v w(u, v) * opinion(v) over the rows of the graph.
+// "span" is the mean |u - v| over the arcs after reordering.
+#include "graph_reorder.h"
+#include "distance_ball.h"
+#include "thread_pool.h"
+#include "rng.h"
+#include "02-graph_topologies/graph_generators.h"
+#include "08-opinion_models/social_impact_model.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#define SEED 42
+#define ROW_SWEEPS 20
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+typedef struct {
+	const char *name;
+	int hops;		// radius of the distance balls
+	graph *(*build)(int n, rng_state * rng);
+} bench_graph;
+
+static graph *geometric(int n, rng_state *rng)
+{
+	float radius = sqrtf(12.0f / (3.14159265f * n));	// ~12 neighbors
+	return generate_random_geometric(n, radius, NULL, GRAPH_CSR, rng);
+}
+
+static graph *small_world(int n, rng_state *rng)
+{
+	return generate_watts_strogatz_with_rng(n, 10, 0.05f, 0, GRAPH_CSR,
+						rng);
+}
+
+static graph *blocks(int n, rng_state *rng)
+{
+	enum { BLOCK = 1000 };
+	int num_blocks = n / BLOCK > 0 ? n / BLOCK : 1;
+	int *sizes = malloc(num_blocks * sizeof(int));
+	float *probs = malloc((size_t)num_blocks * num_blocks * sizeof(float));
+	graph *g = NULL;
+	if (sizes && probs) {
+		for (int a = 0; a < num_blocks; a++) {
+			sizes[a] = a == num_blocks - 1
+			    ? n - (num_blocks - 1) * BLOCK : BLOCK;
+			for (int b = 0; b < num_blocks; b++)
+				probs[a * num_blocks + b] = a == b
+				    ? 10.0f / BLOCK : 2.0f / n;
+		}
+		g = generate_stochastic_block_model(num_blocks, sizes, probs,
+						     0, GRAPH_CSR, rng);
+	}
+	free(sizes);
+	free(probs);
+	return g;
+}
+
+static graph *scale_free(int n, rng_state *rng)
+{
+	return generate_barabasi_albert_with_rng(n, 4, 0, GRAPH_CSR, rng);
+}
+
+static int shuffle_ids(graph *g, rng_state *rng)
+{
+	int n = g->num_nodes;
+	int *perm = malloc((n > 0 ? (size_t)n : 1) * sizeof(int));
+	if (!perm)
+		return 0;
+	for (int u = 0; u < n; u++)
+		perm[u] = u;
+	for (int u = n - 1; u > 0; u--) {
+		int k = (int)rng_below(rng, (uint64_t)u + 1);
+		int t = perm[u];
+		perm[u] = perm[k];
+		perm[k] = t;
+	}
+	int ok = graph_permute(g, perm);
+	free(perm);
+	return ok;
+}
+
+static double mean_span(graph *g)
+{
+	double sum = 0.0;
+	size_t arcs = 0;
+	for (int u = 0; u < g->num_nodes; u++)
+		for (neighbor_iter it = graph_neighbors(g, u);
+		     neighbor_next(&it); arcs++)
+			sum += abs(u - it.v);
+	return arcs ? sum / arcs : 0.0;
+}
+
+// ns per arc of one weighted neighbor sum over every row
+static double row_sweep(graph *g, const float *opinions, float *out)
+{
+	size_t arcs = graph_num_arcs(g);
+	double start = now();
+	for (int rep = 0; rep < ROW_SWEEPS; rep++)
+		for (int u = 0; u < g->num_nodes; u++) {
+			float sum = 0.0f;
+			for (neighbor_iter it = graph_neighbors(g, u);
+			     neighbor_next(&it);)
+				sum += it.weight * opinions[it.v];
+			out[u] = sum;
+		}
+	return (now() - start) * 1e9 / ((double)ROW_SWEEPS * (arcs ? arcs : 1));
+}
+
+static void bench(const bench_graph *bg, int n)
+{
+	rng_state rng;
+	rng_seed(&rng, SEED);
+	graph *g = bg->build(n, &rng);
+	if (!g || !shuffle_ids(g, &rng)) {
+		printf("%-12s out of memory\n", bg->name);
+		free_graph(g);
+		return;
+	}
+	printf("%s: %d nodes, %zu arcs, %d-hop balls\n", bg->name,
+	       g->num_nodes, graph_num_arcs(g), bg->hops);
+
+	float *out = malloc((size_t)g->num_nodes * sizeof(float));
+	double base_update = 0.0, base_sweep = 0.0;
+	for (node_order order = NODE_ORDER_IDENTITY;
+	     order <= NODE_ORDER_COMMUNITY; order++) {
+		// Same initial state and update sequence for every ordering
+		rng_seed(&rng, SEED);
+		opinion_model *model = out
+		    ? create_si_async_mult_model_with_ball
+		    (g, distance_ball_hops(g, bg->hops), 2.0f, 1.0f, &rng) : NULL;
+		if (!model) {
+			printf("  %-10s out of memory\n",
+			       node_order_name(order));
+			break;
+		}
+
+		double start = now();
+		int ok = reorder_model(model, order);
+		double reorder = now() - start;
+		if (!ok) {
+			printf("  %-10s out of memory\n",
+			       node_order_name(order));
+		} else {
+			start = now();
+			for (int step = 0; step < g->num_nodes; step++)
+				model->update(model);
+			double update = (now() - start) * 1e9 / g->num_nodes;
+			double sweep = row_sweep(g, (float *)
+						 model->opinion_space->opinions,
+						 out);
+			if (order == NODE_ORDER_IDENTITY) {
+				base_update = update;
+				base_sweep = sweep;
+			}
+			printf("  %-10s reorder %7.3f s  span %9.1f  "
+			       "update %7.1f ns (%4.2fx)  "
+			       "row sweep %5.2f ns/arc (%4.2fx)\n",
+			       node_order_name(order), reorder, mean_span(g),
+			       update, base_update / update, sweep,
+			       base_sweep / sweep);
+		}
+
+		// Every ordering starts from the same shuffled ids
+		if (model->original_id
+		    && !graph_permute(g, model->original_id)) {
+			printf("  cannot restore the shuffled ids\n");
+			order = NODE_ORDER_COMMUNITY;
+		}
+		free_opinion_space(model->opinion_space);
+		free_params(model);
+		free_model(model);
+	}
+	free(out);
+	free_graph(g);
+}
+
+int main(int argc, char **argv)
+{
+	static const bench_graph graphs[] = {
+		{"geometric", 2, geometric},
+		{"small-world", 1, small_world},
+		{"blocks", 1, blocks},
+		{"scale-free", 1, scale_free},
+	};
+	int n = argc > 1 ? atoi(argv[1]) : 1000000;
+
+	thread_pool_init(0);
+	printf("threads: %d\n", thread_pool_size());
+	for (size_t k = 0; k < sizeof(graphs) / sizeof(graphs[0]); k++)
+		bench(&graphs[k], n);
+	thread_pool_shutdown();
+	return 0;
+}
@@ -0,0 +1,117 @@
+// rng_bench.c: cost per random number of the single and bulk generators.
+// Usage: ./rng_bench [count]   (default: 100000000)
+//
+// get_urandom is the rand() based helper the generators used before,
+// rng_uniform_float one xoshiro256** call per number, rng_buffer_float
+// the buffered draw of rng_batch.h and the rng_fill_* rows the bulk
+// fills, per instruction set. Every value is summed so that none is
+// optimized away; the single draws into four sums to keep the adds off
+// the critical path, the fills outside the timed calls.
+#include "rng.h"
+#include "rng_batch.h"
+#include "cpu_features.h"
+#include "get_urandom.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define SEED 42
+#define FILL_BLOCK 4096
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void report(const char *name, double seconds, size_t count,
+		   double sum)
+{
+	printf("%-28s %6.2f ns/value  (mean %.4f)\n", name,
+	       seconds * 1e9 / count, sum / count);
+}
+
+// Time of the fill calls only, count values in blocks of FILL_BLOCK
+static void bench_fill(const char *name, rng_lanes *lanes, int kind,
+		       size_t count)
+{
+	static float floats[FILL_BLOCK];
+	static uint32_t ints[FILL_BLOCK];
+	double sum = 0.0, seconds = 0.0;
+	for (size_t done = 0; done < count; done += FILL_BLOCK) {
+		double start = now();
+		if (kind == 0)
+			rng_fill_uniform_float(lanes, floats, FILL_BLOCK);
+		else if (kind == 1)
+			rng_fill_below(lanes, ints, FILL_BLOCK, 1000);
+		else
+			rng_fill_normal(lanes, floats, FILL_BLOCK, 0.0f, 1.0f);
+		seconds += now() - start;
+		for (int k = 0; k < FILL_BLOCK; k++)
+			sum += kind == 1 ? ints[k] : floats[k];
+	}
+	report(name, seconds, count, sum);
+}
+
+static void bench_fills(size_t count)
+{
+	static const char *kinds[] = { "fill_uniform_float", "fill_below(1000)",
+		"fill_normal"
+	};
+	simd_isa best = cpu_simd_isa();
+	rng_lanes lanes;
+	char name[64];
+
+	rng_lanes_seed(&lanes, SEED, 0);
+	for (int kind = 0; kind < 3; kind++)
+		for (simd_isa isa = SIMD_SCALAR; isa <= best; isa++) {
+			if (isa == SIMD_SSE2)
+				continue;	// no SSE2 kernel, same as scalar
+			simd_isa_limit(isa);
+			snprintf(name, sizeof(name), "%s %s", kinds[kind],
+				 simd_isa_name(isa));
+			bench_fill(name, &lanes, kind, count);
+		}
+	simd_isa_limit(best);
+}
+
+int main(int argc, char **argv)
+{
+	size_t count = argc > 1 ? strtoull(argv[1], NULL, 10) : 100000000;
+	count = (count + FILL_BLOCK - 1) / FILL_BLOCK * FILL_BLOCK;
+	printf("%zu values, best kernel: %s\n", count,
+	       simd_isa_name(cpu_simd_isa()));
+
+	srand(SEED);
+	double sum[4] = { 0 };
+	double start = now();
+	for (size_t k = 0; k < count; k += 4)
+		for (int s = 0; s < 4; s++)
+			sum[s] += get_urandom(0, 1);
+	report("get_urandom", now() - start, count,
+	       sum[0] + sum[1] + sum[2] + sum[3]);
+
+	rng_state rng;
+	rng_seed(&rng, SEED);
+	sum[0] = sum[1] = sum[2] = sum[3] = 0.0;
+	start = now();
+	for (size_t k = 0; k < count; k += 4)
+		for (int s = 0; s < 4; s++)
+			sum[s] += rng_uniform_float(&rng);
+	report("rng_uniform_float", now() - start, count,
+	       sum[0] + sum[1] + sum[2] + sum[3]);
+
+	rng_buffer buffer;
+	rng_buffer_seed(&buffer, SEED, 0);
+	sum[0] = sum[1] = sum[2] = sum[3] = 0.0;
+	start = now();
+	for (size_t k = 0; k < count; k += 4)
+		for (int s = 0; s < 4; s++)
+			sum[s] += rng_buffer_float(&buffer);
+	report("rng_buffer_float", now() - start, count,
+	       sum[0] + sum[1] + sum[2] + sum[3]);
+
+	bench_fills(count);
+	return 0;
+}
@@ -94,6 +94,11 @@ void consensus_time_vs_nodes(int runs)
 	ensure_dir_exists("./simls_raw_data");
 	ensure_dir_exists(base_dir);
 
+	// Every graph and model below derives its stream from this seed, so
+	// the whole sweep can be repeated from it.
+	uint64_t master_seed = (uint64_t)now;
+	printf("master seed: %llu\n", (unsigned long long)master_seed);
+
 	float **points = malloc(3 * sizeof(float *));
 	float **errors = malloc(3 * sizeof(float *));
 	for (int i = 0; i < 3; i++) {
@@ -112,10 +117,15 @@ void consensus_time_vs_nodes(int runs)
 		int counted_runs_ws = 0;
 		int counted_runs_ba = 0;
 		for (int run = 0; run < runs; run++) {
-			srand(time(NULL) + run + idx * 1000);
+			// One stream per model and run, all from master_seed
+			rng_state rng;
+			uint64_t run_id = (uint64_t)idx * runs + run;
 
 			// ER graph
-			graph *er = generate_erdos_renyi(nnodes, 0.3f, 0);
+			rng_seed_run(&rng, master_seed, 0, run_id, 0);
+			graph *er = generate_erdos_renyi_with_rng(nnodes, 0.3f, 0,
+								  GRAPH_CSR,
+								  &rng);
 			char outdir_er[512];
 			sprintf(outdir_er,
 				"%s/er=0.3,%d,0_sim=er,2,1_run%d",
@@ -123,7 +133,7 @@ void consensus_time_vs_nodes(int runs)
 			ensure_dir_exists(outdir_er);
 
 			opinion_model *sim_er =
-			    create_si_async_temporal(er, 2, 1);
+			    create_si_async_temporal(er, 2, 1, &rng);
 			int er_time =
 			    run_simulation(sim_er, 2000, 0.001, outdir_er,
 					   0);
@@ -143,8 +153,10 @@ void consensus_time_vs_nodes(int runs)
 			free_model(sim_er);
 
 			// WS graph
+			rng_seed_run(&rng, master_seed, 1, run_id, 0);
 			graph *ws =
-			    generate_watts_strogatz(nnodes, 4, 0.1f, 0);
+			    generate_watts_strogatz_with_rng(nnodes, 4, 0.1f, 0,
+							     GRAPH_CSR, &rng);
 			char outdir_ws[512];
 			sprintf(outdir_ws,
 				"%s/ws=0.1,%d,0_sim=ws,2,1_run%d",
@@ -152,7 +164,7 @@ void consensus_time_vs_nodes(int runs)
 			ensure_dir_exists(outdir_ws);
 
 			opinion_model *sim_ws =
-			    create_si_async_temporal(ws, 2, 1);
+			    create_si_async_temporal(ws, 2, 1, &rng);
 			int ws_time =
 			    run_simulation(sim_ws, 2000, 0.001, outdir_ws,
 					   0);
@@ -170,14 +182,17 @@ void consensus_time_vs_nodes(int runs)
 			free_model(sim_ws);
 
 			// BA graph
-			graph *ba = generate_barabasi_albert(nnodes, 2, 0);
+			rng_seed_run(&rng, master_seed, 2, run_id, 0);
+			graph *ba =
+			    generate_barabasi_albert_with_rng(nnodes, 2, 0,
+							      GRAPH_CSR, &rng);
 			char outdir_ba[512];
 			sprintf(outdir_ba, "%s/ba=2,%d,0_sim=ba,2,1_run%d",
 				base_dir, nnodes, run);
 			ensure_dir_exists(outdir_ba);
 
 			opinion_model *sim_ba =
-			    create_si_async_temporal(ba, 2, 1);
+			    create_si_async_temporal(ba, 2, 1, &rng);
 			int ba_time =
 			    run_simulation(sim_ba, 2000, 0.001, outdir_ba,
 					   0);
@@ -253,8 +268,8 @@ int main(void)
 {
 	srand(time(NULL));
 	//consensus_time_vs_nodes(10);
-	graph *g2 = generate_erdos_renyi(30, 0.3, 0);
-	opinion_model *sim = create_si_async_temporal(g2, 2, 1);
+	graph *g2 = generate_erdos_renyi(30, 0.3, 0, GRAPH_CSR);
+	opinion_model *sim = create_si_async_temporal(g2, 2, 1, NULL);
 	if (sim == NULL) {
 		printf("Failed to create model\n");
 		return 1;
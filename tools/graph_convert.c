@@ -0,0 +1,57 @@
+// graph_convert.c: converts between the text and binary graph formats.
+// Usage: graph_convert [--snap|--snap-directed|--mtx] --binary|--text
+//			<input> <output>
+// Without an import option the input format is detected from the file
+// itself; --snap reads a SNAP edge list, --mtx a Matrix Market file.
+#include "graph.h"
+#include <stdio.h>
+#include <string.h>
+
+int main(int argc, char **argv)
+{
+	const char *import = NULL;
+	if (argc == 5) {
+		import = argv[1];
+		argv++;
+		argc--;
+	}
+	if (argc != 4 || (strcmp(argv[1], "--binary")
+			  && strcmp(argv[1], "--text"))
+	    || (import && strcmp(import, "--snap")
+		&& strcmp(import, "--snap-directed")
+		&& strcmp(import, "--mtx"))) {
+		fprintf(stderr,
+			"usage: %s [--snap|--snap-directed|--mtx] "
+			"--binary|--text <input> <output>\n", argv[0]);
+		return 2;
+	}
+
+	graph *g;
+	if (!import)
+		g = load_graph(argv[2], GRAPH_CSR);
+	else if (strcmp(import, "--mtx") == 0)
+		g = import_matrix_market(argv[2]);
+	else
+		g = import_edge_list(argv[2],
+				     strcmp(import, "--snap-directed") == 0,
+				     NULL);
+	if (!g) {
+		fprintf(stderr, "%s: cannot read %s\n", argv[0], argv[2]);
+		return 1;
+	}
+
+	int ok;
+	if (strcmp(argv[1], "--binary") == 0)
+		ok = save_graph_binary(g, argv[3]);
+	else
+		ok = save_graph(g, argv[3]);
+	if (ok)
+		printf("%d nodes, %zu arcs\n", g->num_nodes,
+		       graph_num_arcs(g));
+	free_graph(g);
+	if (!ok) {
+		fprintf(stderr, "%s: cannot write %s\n", argv[0], argv[3]);
+		return 1;
+	}
+	return 0;
+}